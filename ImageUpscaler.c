@@ -1,6 +1,10 @@
 //to Run:  
-//   gcc ImageUpscaler.c -o ImageUpscaler -fopenmp -lm
-//   ./ImageUpscaler
+//   gcc ImageUpscaler.c -o ImageUpscaler -fopenmp -lm -lpthread
+//   ./ImageUpscaler            (fresh run)
+//   ./ImageUpscaler --resume   (continue from vizns/upscaler.ckpt)
+//   ./ImageUpscaler --size 65536 --out huge.png   (final render size / file; .png, .pgm or raw, streamed in strips)
+//   ./ImageUpscaler --video - | ffplay -           (also stream the visualization frames as Y4M video, to a file or stdout)
+//   ./ImageUpscaler --heatmap  (frames show the weights as heatmaps instead of a diagram; automatic for wide nets)
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -9,25 +13,80 @@
 #include <stdint.h>
 #include <stddef.h>
 #include <string.h>
+#include <signal.h>
 #include <omp.h>
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
-#define STB_IMAGE_WRITE_IMPLEMENTATION
-#include "stb_image_write.h"
-
 #define NN_IMPLEMENTATION
 #include "nn.h"
 
+#define NN_IO_IMPLEMENTATION
+#include "nn_io.h"
+
+#define NN_SNAP_IMPLEMENTATION
+#include "nn_snap.h"
+
+#define NN_CKPT_IMPLEMENTATION
+#include "nn_ckpt.h"
+
+#define NN_FRAMES_IMPLEMENTATION
+#include "nn_frames.h"
+
+#define NN_GRID_IMPLEMENTATION
+#include "nn_grid.h"
+
+#define NN_IMAGE_IMPLEMENTATION
+#include "nn_image.h"
+
+#define NN_GIF_IMPLEMENTATION
+#include "nn_gif.h"
+
+#define NN_Y4M_IMPLEMENTATION
+#include "nn_y4m.h"
+
 #define OLIVEC_IMPLEMENTATION
 #include "olive.c"
 
+#define NN_DIAGRAM_IMPLEMENTATION
+#include "nn_diagram.h"
+
+#define NN_HEATMAP_IMPLEMENTATION
+#include "nn_heatmap.h"
+
 #define IMG_X 1024
 #define IMG_Y 768
 static uint32_t img_pixels_canvas[IMG_X * IMG_Y];
 
 #define pix(x, y) ((y) * img_width + (x))
 
+// Checkpoint written every CKPT_EVERY epochs (in the background) and on Ctrl+C.
+#define CKPT_FILE "./vizns/upscaler.ckpt"
+#define CKPT_EVERY 1000
+
+// Training animation, appended to frame by frame (0.10 s per frame, so 100 frames play in 10 seconds)
+#define GIF_FILE "./vizns/training.gif"
+#define GIF_DELAY 10
+
+// Optional Y4M stream of the same frames (--video FILE, or - for stdout). It is opened before anything is printed,
+// since with - the program's own output has to be moved off stdout first.
+static const char *video_path = NULL;
+static nn_y4m video;
+static int video_ok = 0;
+
+// Frames show weight heatmaps instead of the connection diagram (--heatmap). Nets with more connections than
+// HEATMAP_EDGES always do: past that the lines are an unreadable mesh and cost more to draw than the training step.
+#define HEATMAP_EDGES 4096
+static int heatmap_view = 0;
+
+static volatile sig_atomic_t stop_requested = 0;
+
+static void on_sigint(int sig)
+{
+    (void)sig;
+    stop_requested = 1;
+}
+
 // Helper: pack color with alpha in top byte (consistent with earlier code)
 // Format used in original project: 0xAARRGGBB where R is bits16..23, G bits8..15, B bits0..7
 static inline uint32_t ARGB(uint8_t a, uint8_t r, uint8_t g, uint8_t b) {
@@ -57,11 +116,15 @@ static inline uint32_t t_to_rgcolor(float t)
 
 // Draw legend (top-right), using only olive.c functions.
 // Legend shows gradient bar and text labels using olivec_text.
+#define LEGEND_W 220
+#define LEGEND_H 140
+#define LEGEND_MARGIN 12
+
 static void draw_legend(Olivec_Canvas img)
 {
-    const int legend_w = 220;
-    const int legend_h = 140;
-    const int margin = 12;
+    const int legend_w = LEGEND_W;
+    const int legend_h = LEGEND_H;
+    const int margin = LEGEND_MARGIN;
     const int lx = img.width - legend_w - margin;
     const int ly = margin;
 
@@ -123,50 +186,48 @@ static void draw_legend(Olivec_Canvas img)
     olivec_text(img, "Low value (red)", sw_x + sw + 8, r5y - 1, olivec_default_font, 1, ARGB(0xFF, 255, 255, 255));
 }
 
+// Layout and rasterized connections, built on the first frame. Like render_batch (the neurons and the preview of one
+// frame) only touched by the frame thread.
+static nn_diagram diagram = {0};
+static Olivec_Batch render_batch = {0};
+
 // Render network visualization and preview
 int nn_render(Olivec_Canvas img, nn net, int *arch, int arch_count,
               uint32_t *preview_sprite, int pw, int ph)
 {
-    // Fill background
-    olivec_fill(img, ARGB(0xFF, 26, 26, 26)); // dark gray
-
-    // Layout
-    int layer_bvpad = 50;
-    int layer_bhpad = 50;
-    int net_width = img.width - layer_bhpad * 2;
-    int net_height = img.height - 2 * layer_bvpad;
-    int layer_hpad = net_width / arch_count;
-    int net_x = img.width / 2 - net_width / 2;
-    int net_y = img.height / 2 - net_height / 2;
+    if (diagram.width != img.width || diagram.height != img.height) {
+        nn_diagram_free(&diagram);
+        nn_diagram_init(&diagram, img.width, img.height, arch, arch_count, ARGB(0xFF, 26, 26, 26)); // dark gray
+    }
     int neuron_radius = 18;
 
-    for (int l = 0; l < arch_count; ++l) {
-        int layer_vpad = net_height / arch[l];
+    // Connections: only the ones whose color changed since the last frame are repainted
+    for (int l = 0; l + 1 < arch_count; ++l) {
         for (int i = 0; i < arch[l]; ++i) {
-            int cx = net_x + l * layer_hpad + layer_hpad / 2;
-            int cy = net_y + i * layer_vpad + layer_vpad / 2;
-            // draw lines to next layer
-            if (l + 1 < arch_count) {
-                int next_vpad = net_height / arch[l + 1];
-                for (int j = 0; j < arch[l + 1]; ++j) {
-                    int cx2 = net_x + (l + 1) * layer_hpad + layer_hpad / 2;
-                    int cy2 = net_y + j * next_vpad + next_vpad / 2;
-                    float w = MAT_AT(net.w[l], j, i);
-                    uint32_t col = weight_to_rgcolor(w);
-                    olivec_line(img, cx, cy, cx2, cy2, col);
-                }
+            for (int j = 0; j < arch[l + 1]; ++j) {
+                float w = MAT_AT(net.w[l], i, j);
+                diagram.edge_colors[nn_diagram_edge(&diagram, l, i, j)] = weight_to_rgcolor(w);
             }
+        }
+    }
+    nn_diagram_draw(&diagram, img);
+
+    // The rest is drawn over the connections every frame; neurons and the legend blend, so they get clean connections first
+    nn_diagram_restore_neurons(&diagram, img, neuron_radius);
+    nn_diagram_restore(&diagram, img, img.width - LEGEND_W - LEGEND_MARGIN - 4, LEGEND_MARGIN - 4, LEGEND_W + 8, LEGEND_H + 8);
+
+    for (int l = 0; l < arch_count; ++l) {
+        for (int i = 0; i < arch[l]; ++i) {
+            int n = diagram.layer_start[l] + i;
             // draw neuron circle (bias represented as grayscale)
+            uint32_t col = ARGB(0xFF, 128, 128, 128); // input layer
             if (l > 0) {
                 float b = MAT_AT(net.b[l - 1], 0, i);
                 // map bias via logistic to 0..255
                 uint8_t v = (uint8_t)(255.0f / (1.0f + expf(-b)));
-                uint32_t col = ARGB(0xFF, v, v, v);
-                olivec_circle(img, cx, cy, neuron_radius, col);
-            } else {
-                // input layer
-                olivec_circle(img, cx, cy, neuron_radius, ARGB(0xFF, 128, 128, 128));
+                col = ARGB(0xFF, v, v, v);
             }
+            olivec_batch_circle(&render_batch, diagram.neuron_x[n], diagram.neuron_y[n], neuron_radius, col);
         }
     }
 
@@ -177,10 +238,11 @@ int nn_render(Olivec_Canvas img, nn net, int *arch, int arch_count,
         int margin = 24;
         int px = img.width - pw - margin;
         int py = img.height - ph - margin;
-        olivec_sprite_copy(img, px, py, pw, ph, sprite);
+        olivec_batch_sprite_copy(&render_batch, px, py, pw, ph, sprite);
         // frame around preview
-        olivec_frame(img, px, py, pw, ph, 2, ARGB(0xFF, 255, 255, 255));
+        olivec_batch_frame(&render_batch, px, py, pw, ph, 2, ARGB(0xFF, 255, 255, 255));
     }
+    olivec_batch_draw(img, &render_batch);
 
     // Draw legend (top-right)
     draw_legend(img);
@@ -190,14 +252,82 @@ int nn_render(Olivec_Canvas img, nn net, int *arch, int arch_count,
     return 0;
 }
 
+// Heatmap frame: weight tiles, bias strips and activation histograms on the left, preview at the bottom right
+int nn_render_heatmap(Olivec_Canvas img, nn net, nn_heatmap *hm, mat samples,
+                      uint32_t *preview_sprite, int pw, int ph)
+{
+    int margin = 24;
+    int hw = preview_sprite ? (int)img.width - pw - 2 * margin : (int)img.width;
+    nn_heatmap_sample(hm, net, samples);
+    nn_heatmap_draw(hm, olivec_subcanvas(img, 0, 0, hw, img.height), net);
+    olivec_fill(olivec_subcanvas(img, hw, 0, img.width - hw, img.height), hm->background);
+
+    if (preview_sprite && pw > 0 && ph > 0) {
+        Olivec_Canvas sprite = olivec_canvas(preview_sprite, pw, ph, pw);
+        int px = img.width - pw - margin;
+        int py = img.height - ph - margin;
+        olivec_sprite_copy(img, px, py, pw, ph, sprite);
+        olivec_frame(img, px, py, pw, ph, 2, ARGB(0xFF, 255, 255, 255));
+    }
+    olivec_frame(img, 0, 0, img.width - 1, img.height - 1, 8, ARGB(0xFF, 255, 255, 255));
+    return 0;
+}
+
+// Buffers for the visualization frames, allocated once and only touched by the frame thread.
+#define PREVIEW_W 128
+#define PREVIEW_H 128
+#define HIST_GRID 32 // the heatmap histograms are taken over HIST_GRID x HIST_GRID pixel coordinates
+
+typedef struct {
+    int *arch;
+    int arch_count;
+    nn_gif gif;
+    float values[PREVIEW_W * PREVIEW_H];
+    uint32_t sprite[PREVIEW_W * PREVIEW_H];
+    nn_heatmap heatmap; // heatmap_view only
+    float hist_in[HIST_GRID * HIST_GRID * 2];
+} viz_frame_ctx;
+
+// Runs on the frame thread: preview of the snapshot, network diagram, GIF frame.
+static void render_frame(nn snap, int frame, void *user)
+{
+    viz_frame_ctx *ctx = user;
+    nn_grid_eval(snap, ctx->values, PREVIEW_W, PREVIEW_H, PREVIEW_W);
+    for (int i = 0; i < PREVIEW_W * PREVIEW_H; ++i)
+        ctx->sprite[i] = t_to_rgcolor(ctx->values[i]);
+
+    Olivec_Canvas canvas = olivec_canvas(img_pixels_canvas, IMG_X, IMG_Y, IMG_X);
+    if (heatmap_view) {
+        mat samples = {.rows = HIST_GRID * HIST_GRID, .cols = 2, .stride = 2, .data = ctx->hist_in};
+        nn_render_heatmap(canvas, snap, &ctx->heatmap, samples, ctx->sprite, PREVIEW_W, PREVIEW_H);
+    } else {
+        nn_render(canvas, snap, ctx->arch, ctx->arch_count, ctx->sprite, PREVIEW_W, PREVIEW_H);
+    }
+
+    if (!nn_gif_add_frame(&ctx->gif, (const uint8_t *)canvas.pixels, canvas.stride * sizeof(uint32_t))) {
+        fprintf(stderr, "Failed to add frame %d to %s\n", frame, GIF_FILE);
+    } else {
+        printf("Added visualization frame %d to %s\n", frame, GIF_FILE);
+    }
+    if (video_ok && !nn_y4m_write(&video, (const uint8_t *)canvas.pixels, canvas.stride * sizeof(uint32_t))) {
+        fprintf(stderr, "Video output %s closed, no more video frames\n", video_path);
+        video_ok = 0;
+    }
+}
+
 // Training function: multithreaded gradient accumulation (from upscaler_fast), with visualization frames.
 // frame_count : number of frames to save during training (we will produce exactly that many frames)
+// st          : run state; training starts at st->epoch and st is kept up to date for checkpoints
+// Returns 1 if training was interrupted (a checkpoint has been written), 0 when all epochs ran.
 float rate = 1.0f;
-void train_nn_mt_vis(nn net, nn g, int epochs, mat tin, mat tout,
-                     int arch[], int arch_count, int frame_count)
+int train_nn_mt_vis(nn net, nn g, int epochs, nn_coords set,
+                    int arch[], int arch_count, int frame_count, nn_ckpt_state *st)
 {
     int num_threads = omp_get_max_threads();
     printf("Using %d threads\n", num_threads);
+    if (st->epoch > 0 && st->threads != (uint32_t)num_threads)
+        printf("Note: checkpoint was written with %u threads; the resumed run will not be bit-identical\n", st->threads);
+    st->threads = num_threads;
 
     // prepare output dir
     system("mkdir -p vizns");
@@ -207,55 +337,61 @@ void train_nn_mt_vis(nn net, nn g, int epochs, mat tin, mat tout,
     int save_every = epochs / frame_count;
     if (save_every <= 0) save_every = 1;
 
-    int frame_index = 0;
-    for (int epoch = 0; epoch < epochs; ++epoch) {
-        // zero global gradient accumulator
-        nn_init(g, 0.0f);
+    // Per-thread network copies and gradient buffers, allocated once for the whole run.
+    // Each thread's gradients are reduced in thread order afterwards, so the result does not depend on scheduling
+    // and a run resumed from a checkpoint continues bit-exactly.
+    nn *local_net = malloc(sizeof(nn) * num_threads);
+    nn *local_g = malloc(sizeof(nn) * num_threads);
+    int *sub_rows = malloc(sizeof(int) * num_threads);
+    for (int t = 0; t < num_threads; ++t) {
+        local_net[t] = nn_alloc(arch, arch_count);
+        local_g[t] = nn_alloc(arch, arch_count);
+    }
 
-#pragma omp parallel
+    nn_ckpt_writer ckpt;
+    int ckpt_ok = nn_ckpt_writer_start(&ckpt, CKPT_FILE, net);
+    if (!ckpt_ok) fprintf(stderr, "Could not start checkpoint writer, continuing without checkpoints\n");
+
+    // Frames are rendered and encoded on their own thread from a parameter snapshot; under load they are dropped, not waited for
+    static viz_frame_ctx viz;
+    viz.arch = arch;
+    viz.arch_count = arch_count;
+    if (heatmap_view && !viz.heatmap.hist) {
+        nn_heatmap_init(&viz.heatmap, net, weight_to_rgcolor, ARGB(0xFF, 26, 26, 26), ARGB(0xFF, 255, 255, 255));
+        for (int i = 0; i < HIST_GRID * HIST_GRID; ++i) {
+            viz.hist_in[2 * i + 0] = (float)(i % HIST_GRID) / (HIST_GRID - 1);
+            viz.hist_in[2 * i + 1] = (float)(i / HIST_GRID) / (HIST_GRID - 1);
+        }
+    }
+    // A resumed run continues the animation of the interrupted one
+    nn_frames frames;
+    int frames_ok = nn_gif_open(&viz.gif, GIF_FILE, IMG_X, IMG_Y, GIF_DELAY, st->epoch > 0)
+                    && nn_frames_start(&frames, net, render_frame, &viz);
+    if (!frames_ok) fprintf(stderr, "Could not start frame thread, continuing without visualization\n");
+
+    int start_epoch = (int)st->epoch;
+    int frame_index = (start_epoch + save_every - 1) / save_every; // frames already written before the resume point
+    int interrupted = 0;
+    for (int epoch = start_epoch; epoch < epochs; ++epoch) {
+#pragma omp parallel num_threads(num_threads)
         {
             int tid = omp_get_thread_num();
-            int rows = tin.rows;
+            int rows = set.w * set.h;
             int start = (tid * rows) / num_threads;
             int end = ((tid + 1) * rows) / num_threads;
-            int sub_rows = end - start;
-
-            nn local_g = nn_alloc(arch, arch_count);
-            nn_init(local_g, 0.0f);
+            sub_rows[tid] = end - start;
 
-            nn local_net = nn_alloc(arch, arch_count);
-            for (int l = 0; l < net.count; ++l) {
-                mat_cpy(local_net.w[l], net.w[l]);
-                mat_cpy(local_net.b[l], net.b[l]);
-            }
-
-            mat sub_tin = {.rows = sub_rows, .cols = tin.cols, .stride = tin.stride, .data = &MAT_AT(tin, start, 0)};
-            mat sub_tout = {.rows = sub_rows, .cols = tout.cols, .stride = tout.stride, .data = &MAT_AT(tout, start, 0)};
-
-            nn_backprop(local_net, local_g, sub_tin, sub_tout);
-
-#pragma omp critical
-            {
-                for (int l = 0; l < g.count; ++l) {
-                    for (int r = 0; r < g.w[l].rows; ++r)
-                        for (int c = 0; c < g.w[l].cols; ++c)
-                            MAT_AT(g.w[l], r, c) += MAT_AT(local_g.w[l], r, c) * (float)sub_rows;
-                    for (int r = 0; r < g.b[l].rows; ++r)
-                        for (int c = 0; c < g.b[l].cols; ++c)
-                            MAT_AT(g.b[l], r, c) += MAT_AT(local_g.b[l], r, c) * (float)sub_rows;
-                }
-            }
-            // local_g/local_net intentionally not freed (nn.h hasn't provided free)
+            memcpy(local_net[tid].params, net.params, sizeof(float) * net.param_count);
+            nn_backprop_coords(local_net[tid], local_g[tid], set, start, sub_rows[tid]);
         } // end parallel
 
-        // average gradients
-        for (int l = 0; l < g.count; ++l) {
-            for (int r = 0; r < g.w[l].rows; ++r)
-                for (int c = 0; c < g.w[l].cols; ++c)
-                    MAT_AT(g.w[l], r, c) /= (float)tin.rows;
-            for (int r = 0; r < g.b[l].rows; ++r)
-                for (int c = 0; c < g.b[l].cols; ++c)
-                    MAT_AT(g.b[l], r, c) /= (float)tin.rows;
+        // local_g holds per-chunk averages: weight them by chunk size and average over all rows, summing threads in order
+#pragma omp parallel for schedule(static) num_threads(num_threads)
+        for (size_t i = 0; i < g.param_count; ++i) {
+            float sum = 0.0f;
+            for (int t = 0; t < num_threads; ++t)
+                sum += local_g[t].params[i] * (float)sub_rows[t];
+            g.params[i] = sum / (float)(set.w * set.h);
         }
 
         // apply learning
@@ -263,61 +399,128 @@ void train_nn_mt_vis(nn net, nn g, int epochs, mat tin, mat tout,
 
         // periodic logging (10 steps)
         if (epochs > 0 && (epoch % ( (epochs/10)>0 ? (epochs/10) : 1) == 0)) {
-            printf("[epoch %d/%d] cost = %f\n", epoch, epochs, nn_cost(net, tin, tout));
+            printf("[epoch %d/%d] cost = %f\n", epoch, epochs, nn_cost_coords(net, set));
         }
 
-        // Save a visualization frame if scheduled. We want evenly spaced frames; save at epoch=0 too.
+        // Queue a visualization frame if scheduled. We want evenly spaced frames; save at epoch=0 too.
         if ( (epoch % save_every == 0) && frame_index < frame_count ) {
-            // build preview sprite (pw x ph) as ARGB pixels
-            const int pw = 128, ph = 128;
-            uint32_t *sprite_pixels = malloc(sizeof(uint32_t) * pw * ph);
-            if (!sprite_pixels) {
-                fprintf(stderr, "Preview sprite malloc failed\n");
-            } else {
-                for (int y = 0; y < ph; ++y) {
-                    for (int x = 0; x < pw; ++x) {
-                        MAT_AT(NN_INPUT_MAT(net), 0, 0) = (float)x / (pw - 1);
-                        MAT_AT(NN_INPUT_MAT(net), 0, 1) = (float)y / (ph - 1);
-                        nn_forward(net);
-                        float v = MAT_AT(NN_OUTPUT_MAT(net), 0, 0);
-                        if (v < 0.0f) v = 0.0f;
-                        if (v > 1.0f) v = 1.0f;
-                        sprite_pixels[y * pw + x] = t_to_rgcolor(v);
-                    }
-                }
-
-                Olivec_Canvas canvas = olivec_canvas(img_pixels_canvas, IMG_X, IMG_Y, IMG_X);
-                nn_render(canvas, net, arch, arch_count, sprite_pixels, pw, ph);
-
-                char fname[256];
-                snprintf(fname, sizeof(fname), "./vizns/upscaler-%04d.png", frame_index);
-                if (!stbi_write_png(fname, IMG_X, IMG_Y, 4, canvas.pixels, canvas.stride * sizeof(uint32_t))) {
-                    fprintf(stderr, "Failed to write %s\n", fname);
-                } else {
-                    printf("Saved visualization frame: %s\n", fname);
-                }
-                free(sprite_pixels);
-                frame_index++;
-            }
+            if (frames_ok && !nn_frames_submit(&frames, net, frame_index))
+                printf("Visualization busy, frame %d replaced an unrendered one\n", frame_index);
+            frame_index++;
+        }
+
+        st->epoch = epoch + 1;
+        if (stop_requested) {
+            interrupted = 1;
+            break;
         }
+        if (ckpt_ok && st->epoch % CKPT_EVERY == 0)
+            nn_ckpt_submit(&ckpt, net, *st);
     } // end epochs
 
-    printf("Final cost = %f\n", nn_cost(net, tin, tout));
+    if (frames_ok) {
+        nn_frames_stop(&frames);
+        if (frames.dropped > 0) printf("Skipped %d of %d visualization frames\n", frames.dropped, frames.submitted);
+    }
+    nn_gif_close(&viz.gif);
+    if (ckpt_ok) nn_ckpt_writer_stop(&ckpt);
+    for (int t = 0; t < num_threads; ++t) {
+        nn_free(local_net[t]);
+        nn_free(local_g[t]);
+    }
+    free(local_net);
+    free(local_g);
+    free(sub_rows);
+
+    if (interrupted) {
+        if (nn_ckpt_save(CKPT_FILE, net, *st))
+            printf("Interrupted at epoch %llu; checkpoint saved to %s (continue with --resume)\n", (unsigned long long)st->epoch, CKPT_FILE);
+        else
+            fprintf(stderr, "Interrupted, and the checkpoint %s could not be written\n", CKPT_FILE);
+        return 1;
+    }
+
+    printf("Final cost = %f\n", nn_cost_coords(net, set));
+
+    // The animation was written as the frames came in, so it is complete already
+    printf("Training animation: %s\n", GIF_FILE);
+    return 0;
+}
+
+// Rows rendered and written per strip of the final image; memory use is out_w * RENDER_STRIP no matter how tall the output is.
+#define RENDER_STRIP (8 * NN_GRID_TILE_H)
+
+// Renders the net at out_w x out_h straight into the file, one strip at a time.
+static int render_streamed(nn net, const char *path, int out_w, int out_h)
+{
+    nn_image_writer img;
+    if (!nn_image_open(&img, path, out_w, out_h, 1, NN_IMAGE_LEVEL_DEFAULT)) return 0;
+    // Sizes in size_t: --size allows widths up to INT32_MAX, where out_w * RENDER_STRIP no longer fits an int
+    size_t strip_len = (size_t)out_w * RENDER_STRIP;
+    float *values = malloc(sizeof(float) * strip_len);
+    uint8_t *pixels = malloc(strip_len);
+    if (!values || !pixels) {
+        fprintf(stderr, "Failed to allocate render strip\n");
+        free(values);
+        free(pixels);
+        nn_image_close(&img);
+        return 0;
+    }
 
-    // If fewer frames saved than requested (due to rounding), ensure we output exactly frame_count images:
-    // (this is unlikely with the scheduling above, but ensure consistency)
-    // Note: frame files are named 0000.. so we already produced sequential frames.
+    double t0 = omp_get_wtime();
+    for (int y = 0; y < out_h; y += RENDER_STRIP) {
+        int rows = out_h - y < RENDER_STRIP ? out_h - y : RENDER_STRIP;
+        nn_grid_eval_rows(net, values, out_w, out_h, out_w, NN_VIEW_FULL, y, rows);
+        for (size_t i = 0; i < (size_t)out_w * rows; ++i) {
+            float v = values[i];
+            if (v < 0.0f) v = 0.0f;
+            if (v > 1.0f) v = 1.0f;
+            pixels[i] = (uint8_t)(v * 255.0f);
+        }
+        if (!nn_image_write_rows(&img, pixels, rows, out_w)) break;
+        if (y == 0) printf("First strip of %dx%d written after %.3f sec\n", out_w, out_h, omp_get_wtime() - t0);
+    }
+    free(values);
+    free(pixels);
+    return nn_image_close(&img);
+}
 
-    // Build GIF using ImageMagick convert (10 seconds total => 10 fps if 100 frames)
-    // Delay for convert in 1/100ths of a second: for 10 fps use delay 10 (i.e., 100ths of a second)
-    printf("Generating GIF vizns/training.gif (requires ImageMagick 'convert')...\n");
-    // Use -delay 10 (10 hundredths = 0.10s per frame = 10fps) and loop 0
-    system("convert -delay 10 -loop 0 vizns/upscaler-*.png vizns/training.gif");
+// Parses a --size argument, either N (square) or WxH. Anything else, including trailing junk or a
+// non-positive dimension, is rejected so a typo cannot quietly render at the default size.
+static int parse_size(const char *s, int *w, int *h)
+{
+    char *end;
+    long pw = strtol(s, &end, 10), ph = pw;
+    if (end != s && *end == 'x') {
+        const char *hs = end + 1;
+        ph = strtol(hs, &end, 10);
+        if (end == hs) return 0;
+    }
+    if (end == s || *end != '\0' || pw < 1 || ph < 1 || pw > INT32_MAX || ph > INT32_MAX) return 0;
+    *w = (int)pw;
+    *h = (int)ph;
+    return 1;
 }
 
 // --- Main program ---
-int main(void)
+int main(int argc, char **argv)
 {
+    int resume = 0;
+    int out_w = 2048, out_h = 2048;
+    const char *out_path = "./upscaled.png";
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--resume") == 0) resume = 1;
+        else if (strcmp(argv[i], "--out") == 0 && i + 1 < argc) out_path = argv[++i];
+        else if (strcmp(argv[i], "--video") == 0 && i + 1 < argc) video_path = argv[++i];
+        else if (strcmp(argv[i], "--heatmap") == 0) heatmap_view = 1;
+        else if (strcmp(argv[i], "--size") == 0 && i + 1 < argc && parse_size(argv[i + 1], &out_w, &out_h)) ++i;
+        else {
+            fprintf(stderr, "Usage: %s [--resume] [--out FILE] [--size N | WxH] [--video FILE | -] [--heatmap]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (video_path && !(video_ok = nn_y4m_open(&video, video_path, IMG_X, IMG_Y, 100 / GIF_DELAY)))
+        return 1;
     double t_start = omp_get_wtime();
 
     char *img_path = "./Mosquitoes/Downscaled/aegypti1b.png";
@@ -333,60 +536,51 @@ int main(void)
     }
     printf("Loaded image: %s (%d x %d)\n", img_path, img_width, img_height);
 
-    // Build training data matrix: [x_norm, y_norm, brightness]
-    mat trd = mat_alloc(img_width * img_height, 3);
-    for (int y = 0; y < img_height; ++y) {
-        for (int x = 0; x < img_width; ++x) {
-            int i = pix(x, y);
-            MAT_AT(trd, i, 0) = (float)x / (img_width - 1);
-            MAT_AT(trd, i, 1) = (float)y / (img_height - 1);
-            MAT_AT(trd, i, 2) = img_pixels_in[pix(x, y)] / 255.0f;
-        }
-    }
-
-    mat tin = {.rows = trd.rows, .cols = 2, .stride = trd.stride, .data = &MAT_AT(trd, 0, 0)};
-    mat tout = {.rows = trd.rows, .cols = 1, .stride = trd.stride, .data = &MAT_AT(trd, 0, tin.cols)};
+    // Training data: the pixel coordinates are implied by the sample index, so only the image itself is kept
+    nn_coords set = {.w = img_width, .h = img_height, .target = img_pixels_in};
 
-    srand((unsigned)time(NULL));
     int arch[] = {2, 28, 14, 7, 1};
     int arch_count = ARRAY_LEN(arch);
     nn net = nn_alloc(arch, arch_count);
     nn g = nn_alloc(arch, arch_count);
-    nn_rand(net, -1, 1);
+    int edges = 0;
+    for (int l = 0; l + 1 < arch_count; ++l) edges += arch[l] * arch[l + 1];
+    if (edges > HEATMAP_EDGES) heatmap_view = 1;
+
+    nn_ckpt_state st = {.seed = (uint64_t)time(NULL), .rate = rate};
+    if (resume) {
+        if (!nn_ckpt_load(CKPT_FILE, net, &st)) {
+            fprintf(stderr, "Cannot resume: no usable checkpoint at %s\n", CKPT_FILE);
+            return 1;
+        }
+        rate = st.rate;
+        printf("Resuming from %s at epoch %llu\n", CKPT_FILE, (unsigned long long)st.epoch);
+    } else {
+        srand((unsigned)st.seed);
+        nn_rand(net, -1, 1);
+    }
+    signal(SIGINT, on_sigint);
+#ifdef SIGPIPE
+    // A video viewer that is closed early should only end the video, not the training run
+    if (video_path) signal(SIGPIPE, SIG_IGN);
+#endif
 
-    printf("Initial cost = %f\n", nn_cost(net, tin, tout));
+    printf("Initial cost = %f\n", nn_cost_coords(net, set));
 
     // Train: 20000 epochs, save 100 frames
     const int epochs = 100000;
     const int frames = 100;
-    train_nn_mt_vis(net, g, epochs, tin, tout, arch, arch_count, frames);
-
-    // Produce final upscaled image (512x512 grayscale)
-    const int out_w = 2048, out_h = 2048;
-    uint8_t *out_pixels = malloc(out_w * out_h);
-    if (!out_pixels) {
-        fprintf(stderr, "Failed to allocate output image\n");
-        return 1;
-    }
-
-    for (int y = 0; y < out_h; ++y) {
-        for (int x = 0; x < out_w; ++x) {
-            MAT_AT(NN_INPUT_MAT(net), 0, 0) = (float)x / (out_w - 1);
-            MAT_AT(NN_INPUT_MAT(net), 0, 1) = (float)y / (out_h - 1);
-            nn_forward(net);
-            float v = MAT_AT(NN_OUTPUT_MAT(net), 0, 0);
-            if (v < 0.0f) v = 0.0f;
-            if (v > 1.0f) v = 1.0f;
-            out_pixels[y * out_w + x] = (uint8_t)(v * 255.0f);
-        }
-    }
-
-    if (!stbi_write_png("./upscaled.png", out_w, out_h, 1, out_pixels, out_w)) {
-        fprintf(stderr, "Could not save upscaled.png\n");
+    int interrupted = train_nn_mt_vis(net, g, epochs, set, arch, arch_count, frames, &st);
+    if (video_path) nn_y4m_close(&video);
+    if (interrupted)
+        return 0;
+
+    // Produce final upscaled image (2048x2048 grayscale by default), streamed to disk strip by strip
+    if (!render_streamed(net, out_path, out_w, out_h)) {
+        fprintf(stderr, "Could not save %s\n", out_path);
     } else {
-        printf("Saved upscaled.png\n");
+        printf("Saved %s\n", out_path);
     }
-    free(out_pixels);
 
     double elapsed = omp_get_wtime() - t_start;
     int hours = (int)(elapsed / 3600);
@@ -0,0 +1,62 @@
+// Packs per-image model files into one bundle that inference can mmap.
+//
+// to Run:
+//   gcc bundle_models.c -o bundle_models
+//   ./bundle_models models.nnb aegypti1b.dat aegypti2b.dat ...
+//
+// Each model is stored under its file name without directory and extension.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#define NN_IMPLEMENTATION
+#include "nn.h"
+
+#define NN_IO_IMPLEMENTATION
+#include "../nn_io.h"
+
+#define NN_BUNDLE_IMPLEMENTATION
+#include "../nn_bundle.h"
+
+int main(int argc, char **argv)
+{
+    if (argc < 3) {
+        fprintf(stderr, "Usage: %s <bundle.nnb> <model.dat>...\n", argv[0]);
+        return 1;
+    }
+
+    int count = argc - 2;
+    nn *nets = malloc(sizeof(nn) * count);
+    char **names = malloc(sizeof(char *) * count);
+    if (!nets || !names) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+
+    for (int i = 0; i < count; i++) {
+        const char *path = argv[i + 2];
+        if (!nn_load(path, &nets[i]))
+            return 1;
+
+        const char *base = path;
+        for (const char *p = path; *p; p++)
+            if (*p == '/' || *p == '\\') base = p + 1;
+        size_t len = strcspn(base, ".");
+        if (len >= NN_BUNDLE_NAME_MAX) {
+            fprintf(stderr, "Model name too long: %s\n", base);
+            return 1;
+        }
+        names[i] = malloc(len + 1);
+        memcpy(names[i], base, len);
+        names[i][len] = '\0';
+    }
+
+    if (!nn_bundle_write(argv[1], (const char **)names, nets, count)) {
+        fprintf(stderr, "Could not write bundle %s\n", argv[1]);
+        return 1;
+    }
+    printf("Bundled %d models into %s\n", count, argv[1]);
+    return 0;
+}
@@ -2,38 +2,171 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
+#include <math.h>
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 
-#define STB_IMAGE_WRITE_IMPLEMENTATION
-#include "stb_image_write.h"
+#define NN_IMAGE_IMPLEMENTATION
+#include "../nn_image.h"
 
 #define NN_IMPLEMENTATION
 #include "nn.h"
 
+#define NN_IO_IMPLEMENTATION
+#include "../nn_io.h"
+
+#define NN_BUNDLE_IMPLEMENTATION
+#include "../nn_bundle.h"
+
+#define NN_GRID_IMPLEMENTATION
+#include "../nn_grid.h"
+
+#define NN_BAKE_IMPLEMENTATION
+#include "../nn_bake.h"
+
+#define OLIVEC_IMPLEMENTATION
+#include "../olive.c"
+
+#define NN_HEATMAP_IMPLEMENTATION
+#include "../nn_heatmap.h"
+
 #define MODEL_FILE "D:/DevEnv/NN-in-C/Mosquitoes/model.dat"
 #define INPUT_FILE "D:/DevEnv/NN-in-C/Mosquitoes/Downscaled/aegypti1b.png"
 #define OUTPUT_FILE "D:/DevEnv/NN-in-C/Mosquitoes/inference_upscaled.png"
+#define ZOOM_FILE "D:/DevEnv/NN-in-C/Mosquitoes/inference_zoom.png"
+#define HEATMAP_FILE "D:/DevEnv/NN-in-C/Mosquitoes/inference_heatmap.png"
+#define BAKE_FILE MODEL_FILE ".bake"
+
+// Base level of the baked pyramid: (2^11 + 1)^2 samples, enough for every output size we serve.
+#define BAKE_LOG2_W 11
+#define BAKE_LOG2_H 11
 
 #define OUT_W 512
 #define OUT_H 385
 
-int main(void) {
-    int arch[] = {2, 64, 32, 16, 1};
-    nn net = nn_alloc(arch, ARRAY_LEN(arch));
+// Renders a close-up straight from the net: only the pixels inside the window are evaluated.
+static int render_zoom(nn net, float cx, float cy, float zoom, int size)
+{
+    float *outf = malloc(sizeof(float) * size * size);
+    uint8_t *out = malloc(size * size);
+    if (!outf || !out) {
+        fprintf(stderr, "Failed to allocate %dx%d zoom buffer\n", size, size);
+        return 1;
+    }
+    nn_grid_eval_view(net, outf, size, size, size, nn_view_zoom(cx, cy, zoom));
+    for (int i = 0; i < size * size; i++) {
+        float v = outf[i];
+        if (v < 0.0f) v = 0.0f;
+        if (v > 1.0f) v = 1.0f;
+        out[i] = (uint8_t)(v * 255);
+    }
+    int ok = nn_png_write(ZOOM_FILE, size, size, 1, out, size);
+    free(outf);
+    free(out);
+    if (!ok) {
+        fprintf(stderr, "Could not save %s\n", ZOOM_FILE);
+        return 1;
+    }
+    printf("Saved %dx%d view at %.1fx around (%.3f, %.3f) to %s\n", size, size, zoom, cx, cy, ZOOM_FILE);
+    return 0;
+}
+
+// Same red -> green scheme as the visualizers' weight_to_rgcolor, in the byte order nn_png_write expects
+static uint32_t weight_to_rgcolor(float w)
+{
+    float t = (tanhf(w) + 1.0f) * 0.5f;
+    if (t < 0.0f) t = 0.0f;
+    if (t > 1.0f) t = 1.0f;
+    return OLIVEC_RGBA((uint8_t)((1.0f - t) * 255.0f), (uint8_t)(t * 255.0f), 0, 0xFF);
+}
+
+// Weights, biases and activation histograms of the model as one picture; the activations are taken over a grid of
+// 64 x 64 output coordinates.
+static int render_heatmap(nn net, int w, int h)
+{
+    enum { GRID = 64 };
+    uint32_t *pixels = malloc(sizeof(uint32_t) * w * h);
+    float *samples = malloc(sizeof(float) * GRID * GRID * 2);
+    if (!pixels || !samples) {
+        fprintf(stderr, "Failed to allocate %dx%d heatmap\n", w, h);
+        return 1;
+    }
+    for (int i = 0; i < GRID * GRID; i++) {
+        samples[2 * i + 0] = (float)(i % GRID) / (GRID - 1);
+        samples[2 * i + 1] = (float)(i / GRID) / (GRID - 1);
+    }
+    nn_heatmap hm;
+    nn_heatmap_init(&hm, net, weight_to_rgcolor, OLIVEC_RGBA(26, 26, 26, 255), OLIVEC_RGBA(255, 255, 255, 255));
+    nn_heatmap_sample(&hm, net, (mat){.rows = GRID * GRID, .cols = 2, .stride = 2, .data = samples});
+    nn_heatmap_draw(&hm, olivec_canvas(pixels, w, h, w), net);
+    nn_heatmap_free(&hm);
 
-    // Load weights and biases
-    FILE *fp = fopen(MODEL_FILE, "rb");
-    if (!fp) {
-        fprintf(stderr, "Cannot open model file.\n");
+    int ok = nn_png_write(HEATMAP_FILE, w, h, 4, pixels, w * sizeof(uint32_t));
+    free(samples);
+    free(pixels);
+    if (!ok) {
+        fprintf(stderr, "Could not save %s\n", HEATMAP_FILE);
         return 1;
     }
-    for (int i = 0; i < net.count; i++) {
-        fread(net.w[i].data, sizeof(float), net.w[i].rows * net.w[i].cols, fp);
-        fread(net.b[i].data, sizeof(float), net.b[i].rows * net.b[i].cols, fp);
+    printf("Saved %dx%d weight heatmap to %s\n", w, h, HEATMAP_FILE);
+    return 0;
+}
+
+// Usage: inference [--bundle file.nnb name] [zoom cx cy factor [size] | heatmap [WxH]]
+//   no mode                 -> full OUT_W x OUT_H upscale
+//   zoom cx cy factor [size] -> size x size close-up (default 1024) centered on normalized (cx, cy)
+//   heatmap [WxH]           -> picture of the weights, biases and activations (default 1280x960)
+//   --bundle                -> take the model from a bundle (see bundle_models.c) instead of MODEL_FILE
+int main(int argc, char **argv) {
+    nn net;
+    nn_bundle bundle = {0};
+    char bake_path[512];
+    snprintf(bake_path, sizeof(bake_path), "%s", BAKE_FILE);
+
+    if (argc >= 4 && strcmp(argv[1], "--bundle") == 0) {
+        // Zero-copy: the net's weights point into the mapped bundle
+        if (!nn_bundle_open(argv[2], &bundle))
+            return 1;
+        int i = nn_bundle_find(bundle, argv[3]);
+        if (i < 0) {
+            fprintf(stderr, "No model named %s in %s\n", argv[3], argv[2]);
+            return 1;
+        }
+        if (!nn_bundle_get(bundle, i, &net))
+            return 1;
+        snprintf(bake_path, sizeof(bake_path), "%s.%s.bake", argv[2], argv[3]);
+        argc -= 3;
+        argv += 3;
+    } else if (nn_file_has_magic(MODEL_FILE)) {
+        // The model file carries its own architecture.
+        if (!nn_load(MODEL_FILE, &net))
+            return 1;
+    } else {
+        // Headerless dumps from before the versioned format are still accepted, but only if their size matches
+        // the architecture train_upscaler.c used for them.
+        int legacy_arch[] = {2, 128, 64, 32, 1};
+        if (!nn_load_raw(MODEL_FILE, legacy_arch, ARRAY_LEN(legacy_arch), &net)) {
+            fprintf(stderr, "Cannot load model %s\n", MODEL_FILE);
+            return 1;
+        }
+        printf("Loaded legacy raw model %s\n", MODEL_FILE);
+    }
+
+    if (argc >= 5 && strcmp(argv[1], "zoom") == 0) {
+        int size = argc >= 6 ? atoi(argv[5]) : 1024;
+        if (size < 1) size = 1024;
+        return render_zoom(net, (float)atof(argv[2]), (float)atof(argv[3]), (float)atof(argv[4]), size);
+    }
+    if (argc >= 2 && strcmp(argv[1], "heatmap") == 0) {
+        int w = 1280, h = 960;
+        if (argc >= 3 && sscanf(argv[2], "%dx%d", &w, &h) != 2) w = h = 0;
+        if (w < 1 || h < 1) {
+            fprintf(stderr, "Invalid heatmap size %s\n", argv[2]);
+            return 1;
+        }
+        return render_heatmap(net, w, h);
     }
-    fclose(fp);
 
     // Read input image
     int iw, ih, ic;
@@ -43,23 +176,49 @@ int main(void) {
         return 1;
     }
 
-    uint8_t *out = malloc(OUT_W * OUT_H);
+    // Reuse the baked pyramid saved next to the model; bake it once if it is missing or stale.
+    nn_bake bake;
+    if (nn_bake_load(bake_path, &bake, nn_bake_key(net))) {
+        printf("Loaded bake %s\n", bake_path);
+    } else {
+        bake = nn_bake_build(net, BAKE_LOG2_W, BAKE_LOG2_H);
+        printf("Baked %dx%d pyramid (%d levels, max error %.6f)\n", bake.w[0], bake.h[0], bake.levels, bake.err[0]);
+        if (!nn_bake_save(bake_path, bake))
+            fprintf(stderr, "Could not save bake to %s\n", bake_path);
+    }
 
     // Generate upscaled pixels
-    for (int y = 0; y < OUT_H; y++) {
-        for (int x = 0; x < OUT_W; x++) {
-            MAT_AT(NN_INPUT_MAT(net), 0, 0) = (float)x / (OUT_W - 1);
-            MAT_AT(NN_INPUT_MAT(net), 0, 1) = (float)y / (OUT_H - 1);
-            nn_forward(net);
-            float v = MAT_AT(NN_OUTPUT_MAT(net), 0, 0);
-            out[y * OUT_W + x] = (uint8_t)(v * 255);
-        }
+    float *outf = malloc(sizeof(float) * OUT_W * OUT_H);
+    uint8_t *out = malloc(OUT_W * OUT_H);
+    if (!outf || !out) {
+        fprintf(stderr, "Failed to allocate %dx%d output\n", OUT_W, OUT_H);
+        return 1;
+    }
+    float err = nn_bake_render(bake, outf, OUT_W, OUT_H, OUT_W);
+    printf("Rendered %dx%d from bake (max error %.6f)\n", OUT_W, OUT_H, err);
+    for (int i = 0; i < OUT_W * OUT_H; i++) {
+        float v = outf[i];
+        if (v < 0.0f) v = 0.0f;
+        if (v > 1.0f) v = 1.0f;
+        out[i] = (uint8_t)(v * 255);
     }
+    free(outf);
 
-    stbi_write_png(OUTPUT_FILE, OUT_W, OUT_H, 1, out, OUT_W);
+    int ok = nn_png_write(OUTPUT_FILE, OUT_W, OUT_H, 1, out, OUT_W);
+    free(out);
+    if (!ok) {
+        fprintf(stderr, "Could not save %s\n", OUTPUT_FILE);
+        return 1;
+    }
     printf("Saved upscaled image to %s\n", OUTPUT_FILE);
 
-    free(out);
+    nn_bake_free(&bake);
     stbi_image_free(img);
+    if (bundle.hdr) {
+        nn_bundle_release(net);
+        nn_bundle_close(&bundle);
+    } else {
+        nn_free(net);
+    }
     return 0;
 }
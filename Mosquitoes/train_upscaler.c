@@ -1,15 +1,35 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
-#include <dirent.h>
 #include <string.h>
+#include <signal.h>
 #include <time.h>
+#include <dirent.h>
+
+#define NN_IMPLEMENTATION
+#include "nn.h"
+
+// stbi's decode buffers come from the loader threads' arenas
+#define NN_LOADER_IMPLEMENTATION
+#include "../nn_loader.h"
+#define STBI_MALLOC(sz) nn_arena_stbi_malloc(sz)
+#define STBI_REALLOC_SIZED(p, oldsz, newsz) nn_arena_stbi_realloc(p, oldsz, newsz)
+#define STBI_FREE(p) nn_arena_stbi_free(p)
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 
-#define NN_IMPLEMENTATION
-#include "nn.h"
+#define NN_IO_IMPLEMENTATION
+#include "../nn_io.h"
+
+#define NN_SNAP_IMPLEMENTATION
+#include "../nn_snap.h"
+
+#define NN_CKPT_IMPLEMENTATION
+#include "../nn_ckpt.h"
+
+#define NN_CACHE_IMPLEMENTATION
+#include "../nn_cache.h"
 
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #include "stb_image_write.h"
@@ -17,6 +37,8 @@
 #define INPUT_DIR  "./Downscaled"
 #define TARGET_DIR "./Upscaled"
 #define MODEL_FILE "./model.dat"
+#define CKPT_FILE  "./train.ckpt"
+#define CACHE_FILE "./images.nnc"  // decoded INPUT_DIR + TARGET_DIR, refreshed on start when files change
 
 #define INPUT_W  56
 #define INPUT_H  42
@@ -26,58 +48,68 @@
 #define TRAIN_STEPS  50090
 #define LEARN_RATE   0.5f
 #define TARGET_COST  0.0015f   // stop training when cost < 0.003
+#define CKPT_EVERY   5000      // background checkpoint interval in steps (also written after every image and on Ctrl+C)
+#define LOAD_THREADS 2         // image pairs are prepared by these threads while the current one trains
+#define LOAD_AHEAD   4         // how many prepared pairs may be waiting
 
 // Utility: get pixel from grayscale image
 #define PIX(img, x, y, w) ((img)[(y)*(w)+(x)])
 
-// Train the model on all images
-int main(void) {
-    srand(time(NULL));
+static volatile sig_atomic_t stop_requested = 0;
 
-    // Network architecture
-    int arch[] = {2, 128, 64, 32, 1};
-    nn net = nn_alloc(arch, ARRAY_LEN(arch));
-    nn g   = nn_alloc(arch, ARRAY_LEN(arch));
-    nn_rand(net, -1, 1);
-
-    DIR *dir;
-    struct dirent *ent;
-    if ((dir = opendir(INPUT_DIR)) == NULL) {
-        fprintf(stderr, "Could not open %s\n", INPUT_DIR);
-        return 1;
-    }
-
-    int img_count = 0;
-    float total_cost = 0;
+static void on_sigint(int sig) {
+    (void)sig;
+    stop_requested = 1;
+}
 
-    // Go through each image pair
-    while ((ent = readdir(dir)) != NULL) {
-        if (strstr(ent->d_name, ".png") == NULL) continue;
+// Image pairs to train on, in order. Without a cache the PNGs are decoded by the loader threads.
+typedef struct {
+    char **names;
+    int count;
+    int first; // loader index 0 is names[first]
+    nn_cache *cache;
+} pair_list;
 
-        // Build full paths
-        char input_path[512], target_path[512];
-        snprintf(input_path, sizeof(input_path), "%s/%s", INPUT_DIR, ent->d_name);
-        snprintf(target_path, sizeof(target_path), "%s/%s", TARGET_DIR, ent->d_name);
+static int cmp_names(const void *a, const void *b) {
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
 
-        int iw, ih, ic, tw, th, tc;
-        uint8_t *in_img = stbi_load(input_path, &iw, &ih, &ic, 1);
-        uint8_t *tg_img = stbi_load(target_path, &tw, &th, &tc, 1);
-        if (!in_img || !tg_img) {
-            fprintf(stderr, "Skipping %s (load error)\n", ent->d_name);
-            continue;
-        }
+static void add_name(pair_list *pl, const char *name) {
+    pl->names = realloc(pl->names, sizeof(char *) * (pl->count + 1));
+    pl->names[pl->count] = malloc(strlen(name) + 1);
+    strcpy(pl->names[pl->count++], name);
+}
 
-        if (iw != INPUT_W || ih != INPUT_H || tw != TARGET_W || th != TARGET_H) {
-            fprintf(stderr, "Skipping %s (wrong size)\n", ent->d_name);
-            stbi_image_free(in_img);
-            stbi_image_free(tg_img);
-            continue;
-        }
+// Loader callback: validates one pair and converts it to training rows. Runs on a loader thread.
+static int load_pair(void *user, int index, mat tin, mat tout, nn_arena *arena) {
+    (void)arena; // used implicitly: stbi allocates from it
+    pair_list *pl = user;
+    const char *name = pl->names[pl->first + index];
+    char input_path[512], target_path[512];
+    snprintf(input_path, sizeof(input_path), "%s/%s", INPUT_DIR, name);
+    snprintf(target_path, sizeof(target_path), "%s/%s", TARGET_DIR, name);
 
-        int samples = INPUT_W * INPUT_H;
-        mat tin  = mat_alloc(samples, 2);
-        mat tout = mat_alloc(samples, 1);
+    int iw = 0, ih = 0, tw = 0, th = 0, ic, tc;
+    const uint8_t *in_img, *tg_img;
+    uint8_t *decoded_in = NULL, *decoded_tg = NULL;
+    if (pl->cache) {
+        int e = nn_cache_find(*pl->cache, input_path);
+        int t = nn_cache_find(*pl->cache, target_path);
+        in_img = e >= 0 ? nn_cache_pixels(*pl->cache, e) : NULL;
+        tg_img = t >= 0 ? nn_cache_pixels(*pl->cache, t) : NULL;
+        if (in_img) { iw = (int)pl->cache->entries[e].w; ih = (int)pl->cache->entries[e].h; }
+        if (tg_img) { tw = (int)pl->cache->entries[t].w; th = (int)pl->cache->entries[t].h; }
+    } else {
+        in_img = decoded_in = stbi_load(input_path, &iw, &ih, &ic, 1);
+        tg_img = decoded_tg = stbi_load(target_path, &tw, &th, &tc, 1);
+    }
 
+    int rows = 0;
+    if (!in_img || !tg_img) {
+        fprintf(stderr, "Skipping %s (load error)\n", name);
+    } else if (iw != INPUT_W || ih != INPUT_H || tw != TARGET_W || th != TARGET_H) {
+        fprintf(stderr, "Skipping %s (wrong size)\n", name);
+    } else {
         for (int y = 0; y < ih; y++) {
             for (int x = 0; x < iw; x++) {
                 int i = y * iw + x;
@@ -86,15 +118,123 @@ int main(void) {
                 MAT_AT(tout, i, 0) = PIX(in_img, x, y, iw) / 255.0f;
             }
         }
+        rows = INPUT_W * INPUT_H;
+    }
+    stbi_image_free(decoded_in);
+    stbi_image_free(decoded_tg);
+    return rows;
+}
+
+// Train the model on all images
+// Run with --resume to continue from CKPT_FILE: images finished before the checkpoint are skipped
+// and the interrupted one picks up at the step after the last checkpoint.
+// Run with --no-cache to decode the PNGs on every run instead of using CACHE_FILE.
+int main(int argc, char **argv) {
+    int resume = 0, use_cache = 1;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--resume") == 0) resume = 1;
+        else if (strcmp(argv[i], "--no-cache") == 0) use_cache = 0;
+    }
+
+    // Network architecture
+    int arch[] = {2, 128, 64, 32, 1};
+    nn net = nn_alloc(arch, ARRAY_LEN(arch));
+    nn g   = nn_alloc(arch, ARRAY_LEN(arch));
+
+    // st.tag is the image being trained, st.epoch the next step on it, st.cursor/aux[0] the images and cost finished so far
+    nn_ckpt_state st = {.seed = (uint64_t)time(NULL), .rate = LEARN_RATE, .threads = 1};
+    if (resume) {
+        if (!nn_ckpt_load(CKPT_FILE, net, &st)) {
+            fprintf(stderr, "Cannot resume: no usable checkpoint at %s\n", CKPT_FILE);
+            return 1;
+        }
+        printf("Resuming from %s: %s, step %llu\n", CKPT_FILE, st.tag, (unsigned long long)st.epoch);
+    } else {
+        srand((unsigned)st.seed);
+        nn_rand(net, -1, 1);
+    }
+    signal(SIGINT, on_sigint);
 
-        printf("\nTraining on %s...\n", ent->d_name);
+    nn_ckpt_writer ckpt;
+    int ckpt_ok = nn_ckpt_writer_start(&ckpt, CKPT_FILE, net);
+    if (!ckpt_ok) fprintf(stderr, "Could not start checkpoint writer, continuing without checkpoints\n");
+
+    // Decode the image folders once; later runs only stat the files and map the cache
+    pair_list pl = {0};
+    nn_cache cache;
+    if (use_cache) {
+        const char *dirs[] = {INPUT_DIR, TARGET_DIR};
+        if (!nn_cache_build(CACHE_FILE, dirs, ARRAY_LEN(dirs)) || !nn_cache_open(CACHE_FILE, &cache)) {
+            fprintf(stderr, "Could not prepare image cache %s\n", CACHE_FILE);
+            return 1;
+        }
+        pl.cache = &cache;
+        // Entries are sorted; duplicate inputs are trained once
+        const char *input_prefix = INPUT_DIR "/";
+        size_t prefix_len = strlen(input_prefix);
+        for (int e = 0; e < cache.count; e++) {
+            if (strncmp(cache.entries[e].path, input_prefix, prefix_len) != 0) continue;
+            if (cache.entries[e].flags & NN_CACHE_DUP) continue;
+            add_name(&pl, cache.entries[e].path + prefix_len);
+        }
+    } else {
+        DIR *dir;
+        struct dirent *ent;
+        if ((dir = opendir(INPUT_DIR)) == NULL) {
+            fprintf(stderr, "Could not open %s\n", INPUT_DIR);
+            return 1;
+        }
+        while ((ent = readdir(dir)) != NULL)
+            if (strstr(ent->d_name, ".png") != NULL) add_name(&pl, ent->d_name);
+        closedir(dir);
+        if (pl.count > 1) qsort(pl.names, pl.count, sizeof(char *), cmp_names);
+    }
+
+    int img_count = (int)st.cursor;
+    float total_cost = (float)st.aux[0];
+    int resume_step = 1;
+    if (resume) {
+        while (pl.first < pl.count && strcmp(pl.names[pl.first], st.tag) != 0) pl.first++;
+        if (pl.first == pl.count) {
+            fprintf(stderr, "Checkpointed image %s is no longer in %s\n", st.tag, INPUT_DIR);
+            return 1;
+        }
+        if (st.epoch > TRAIN_STEPS) pl.first++; // checkpoint was taken after this image finished
+        else resume_step = (int)st.epoch;
+    }
+    int interrupted = 0;
+
+    nn_loader loader;
+    if (!nn_loader_start(&loader, pl.count - pl.first, LOAD_AHEAD, LOAD_THREADS, INPUT_W * INPUT_H, 2, 1, load_pair, &pl)) {
+        fprintf(stderr, "Could not start loader threads\n");
+        return 1;
+    }
+
+    // Go through each image pair; the loader has the next ones ready by the time they are needed
+    nn_loader_item *item;
+    while (!interrupted && (item = nn_loader_next(&loader)) != NULL) {
+        const char *name = pl.names[pl.first + item->index];
+        int first_step = item->index == 0 ? resume_step : 1;
+        mat tin = item->tin;
+        mat tout = item->tout;
+
+        printf("\nTraining on %s...\n", name);
         float cost = 0.0f;
         cost = nn_cost(net, tin, tout);
         // Train until either TRAIN_STEPS reached or cost < TARGET_COST
-        for (int step = 1; step <= TRAIN_STEPS; step++) {
+        snprintf(st.tag, sizeof(st.tag), "%.*s", (int)sizeof(st.tag) - 1, name);
+        for (int step = first_step; step <= TRAIN_STEPS; step++) {
             nn_backprop(net, g, tin, tout);
             nn_learn(net, g, LEARN_RATE);
 
+            st.epoch = step + 1;
+            if (stop_requested) {
+                interrupted = 1;
+                break;
+            }
+            if (ckpt_ok && step % CKPT_EVERY == 0)
+                nn_ckpt_submit(&ckpt, net, st);
+
             // Check cost occasionally
             if (step % 500 == 0 || step == TRAIN_STEPS) {
                 cost = nn_cost(net, tin, tout);
@@ -106,30 +246,38 @@ int main(void) {
             //     break;
             // }
         }
+        if (interrupted) break;
+
         total_cost += cost;
         img_count++;
-        printf("Finished %s | Final cost = %.6f\n", ent->d_name, cost);
+        printf("Finished %s | Final cost = %.6f\n", name, cost);
 
-        stbi_image_free(in_img);
-        stbi_image_free(tg_img);
-        free(tin.data);
-        free(tout.data);
+        st.cursor = img_count;
+        st.aux[0] = total_cost;
+        if (ckpt_ok) nn_ckpt_submit(&ckpt, net, st);
     }
 
-    closedir(dir);
+    nn_loader_stop(&loader);
+    if (use_cache) nn_cache_close(&cache);
+    for (int i = 0; i < pl.count; i++) free(pl.names[i]);
+    free(pl.names);
+    if (ckpt_ok) nn_ckpt_writer_stop(&ckpt);
+    if (interrupted) {
+        if (!nn_ckpt_save(CKPT_FILE, net, st)) {
+            fprintf(stderr, "Interrupted, and the checkpoint %s could not be written\n", CKPT_FILE);
+            return 1;
+        }
+        printf("\nInterrupted on %s at step %llu; checkpoint saved to %s (continue with --resume)\n",
+               st.tag, (unsigned long long)st.epoch, CKPT_FILE);
+        return 0;
+    }
     printf("\nTrained on %d images, avg cost=%.6f\n", img_count, total_cost/img_count);
 
     // Save model parameters
-    FILE *fp = fopen(MODEL_FILE, "wb");
-    if (!fp) {
+    if (!nn_save(MODEL_FILE, net)) {
         fprintf(stderr, "Could not save model!\n");
         return 1;
     }
-    for (int i = 0; i < net.count; i++) {
-        fwrite(net.w[i].data, sizeof(float), net.w[i].rows * net.w[i].cols, fp);
-        fwrite(net.b[i].data, sizeof(float), net.b[i].rows * net.b[i].cols, fp);
-    }
-    fclose(fp);
     printf("Model saved to %s\n", MODEL_FILE);
 
     return 0;
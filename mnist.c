@@ -0,0 +1,89 @@
+// Trains a digit classifier with stratified mini-batches, from MNIST/train/<digit>/*.png or from the IDX files.
+//
+//to Run:
+//   gcc mnist.c -o mnist -fopenmp -lm
+//   ./mnist                                                   (PNG class folders in ./MNIST/train)
+//   ./mnist path/to/class/folders
+//   ./mnist train-images-idx3-ubyte train-labels-idx1-ubyte     (IDX files, memory-mapped)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+#include <omp.h>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+#define NN_IMPLEMENTATION
+#include "nn.h"
+
+#define NN_IO_IMPLEMENTATION
+#include "nn_io.h"
+
+#define NN_DATASET_IMPLEMENTATION
+#include "nn_dataset.h"
+
+#define DATA_DIR "./MNIST/train"
+#define BATCH 50
+#define EPOCHS 30
+#define RATE 1.0f
+
+// Fraction of the batch whose largest output is the labelled class.
+static float batch_accuracy(nn net, mat in, mat out, float *scratch, mat res)
+{
+    res.rows = in.rows;
+    nn_forward_batch(net, in, res, scratch);
+    int correct = 0;
+    for (int r = 0; r < in.rows; r++) {
+        int best = 0;
+        for (int j = 1; j < res.cols; j++)
+            if (MAT_AT(res, r, j) > MAT_AT(res, r, best)) best = j;
+        correct += MAT_AT(out, r, best) == 1.0f;
+    }
+    return (float)correct / in.rows;
+}
+
+int main(int argc, char **argv)
+{
+    double t_start = omp_get_wtime();
+    nn_dataset ds;
+    int loaded = argc > 2 ? nn_dataset_load_idx(argv[1], argv[2], &ds)
+                          : nn_dataset_load_dirs(argc > 1 ? argv[1] : DATA_DIR, &ds);
+    if (!loaded) return 1;
+    printf("Loaded %d images (%dx%d, %d classes) in %.3f sec\n", ds.count, ds.w, ds.h, ds.classes, omp_get_wtime() - t_start);
+
+    srand((unsigned)time(NULL));
+    int arch[] = {ds.w * ds.h, 32, ds.classes};
+    nn net = nn_alloc(arch, ARRAY_LEN(arch));
+    nn g = nn_alloc(arch, ARRAY_LEN(arch));
+    nn_rand(net, -1, 1);
+    for (size_t i = 0; i < net.param_count; i++) net.params[i] *= 0.1f;
+
+    float *scratch = malloc(sizeof(float) * nn_batch_scratch_size(net));
+    mat res = mat_alloc(BATCH, ds.classes);
+
+    nn_batcher batcher;
+    nn_batcher_init(&batcher, &ds, BATCH, (uint64_t)time(NULL));
+    mat in, out;
+    for (int epoch = 0; epoch < EPOCHS; epoch++) {
+        float acc = 0.0f;
+        int batches = 0;
+        while (nn_batcher_next(&batcher, &in, &out) > 0) {
+            nn_backprop(net, g, in, out);
+            nn_learn(net, g, RATE);
+            acc += batch_accuracy(net, in, out, scratch, res);
+            batches++;
+        }
+        printf("[epoch %d/%d] train accuracy = %.3f\n", epoch + 1, EPOCHS, acc / batches);
+    }
+
+    nn_batcher_free(&batcher);
+    free(scratch);
+    free(res.data);
+    nn_free(net);
+    nn_free(g);
+    nn_dataset_free(&ds);
+    printf("Total runtime: %.3f sec\n", omp_get_wtime() - t_start);
+    return 0;
+}
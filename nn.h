@@ -5,6 +5,7 @@
 #include <time.h>
 #include <math.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <stdlib.h>
 
 #ifndef NN_MALLOC
@@ -17,6 +18,14 @@
 #define NN_ASSERT assert
 #endif
 
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define NN_SSE2 1
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define NN_NEON 1
+#endif
+
 typedef struct
 {
     int rows;
@@ -25,6 +34,24 @@ typedef struct
     float *data;
 } mat;
 
+// Read-only 8-bit matrix with the same shape fields as mat, e.g. a view of images inside a memory-mapped dataset file.
+typedef struct
+{
+    int rows;
+    int cols;
+    int stride;
+    const unsigned char *data;
+} mat_u8;
+
+// Training set of a coordinate network (arch {2, ..., 1}) fitted to one w*h image.
+// Sample i is pixel (i % w, i / w): its input (x/(w-1), y/(h-1)) is computed from the index when needed and only the target
+// pixel is stored, as a byte. The target can point straight at decoded image data.
+typedef struct
+{
+    int w, h;
+    const unsigned char *target; // w*h grayscale pixels, row-major
+} nn_coords;
+
 typedef struct
 {
 
@@ -32,9 +59,12 @@ typedef struct
     mat *w; // weights
     mat *b; // biases
     mat *a; // activations
+    float *params; // arena holding every weight and bias: w[0], b[0], w[1], b[1], ...
+    size_t param_count;
 } nn;
 
 #define MAT_AT(m, i, j) (m).data[(i) * (m).stride + (j)]
+#define MAT_U8_AT(m, i, j) (m).data[(size_t)(i) * (m).stride + (j)]
 #define MAT_PRINT(m) mat_print(m, #m)
 
 #define ARRAY_LEN(a) sizeof((a)) / sizeof((a)[0])
@@ -42,6 +72,15 @@ typedef struct
 #define NN_INPUT_MAT(nn) (nn).a[0]
 #define NN_OUTPUT_MAT(nn) (nn).a[(nn).count]
 
+// Number of samples pushed through the network at once by nn_forward_batch (a multiple of 16).
+// A block of NN_BATCH_ROWS activations of the widest layer should stay in L1/L2.
+#ifndef NN_BATCH_ROWS
+#define NN_BATCH_ROWS 64
+#endif
+#if NN_BATCH_ROWS % 16 != 0
+#error "NN_BATCH_ROWS must be a multiple of 16"
+#endif
+
 float rand_float(void);
 float sigmoidf(float x);
 
@@ -54,18 +93,31 @@ void mat_print(mat m, const char *name);
 void mat_sigmoidf(mat m);
 mat mat_getRow(mat m, int row);
 void mat_cpy(mat dest, mat src);
+void mat_from_u8(mat dest, mat_u8 src, float scale);
 
 nn nn_alloc(int *arch, int arch_count);
+nn nn_wrap(int *arch, int arch_count, float *params);
+void nn_unwrap(nn net);
+void nn_free(nn net);
 void nn_init(nn net, float n);
 nn nn_print(nn net, const char *name);
 void nn_rand(nn net, int lo, int hi);
 void nn_forward(nn net);
+int nn_max_width(nn net);
+size_t nn_batch_scratch_size(nn net);
+void nn_forward_batch(nn net, mat in, mat out, float *scratch);
 float nn_cost(nn net, mat tin, mat tout);
 void nn_finite_diff(nn net, nn gradients, float eps, mat tin, mat tout);
 void nn_learn(nn net, nn gradients, float rate);
 
 void nn_backprop(nn net, nn gradients, mat tin, mat tout);
 
+void nn_backprop_u8(nn net, nn gradients, mat tin, mat_u8 tout);
+float nn_cost_u8(nn net, mat tin, mat_u8 tout);
+
+float nn_cost_coords(nn net, nn_coords set);
+void nn_backprop_coords(nn net, nn gradients, nn_coords set, int first, int count);
+
 #endif // NN_H
 
 #ifdef NN_IMPLEMENTATION
@@ -75,12 +127,103 @@ void nn_backprop(nn net, nn gradients, mat tin, mat tout);
     return (float)rand() / (float)RAND_MAX;
 }
 
+// Range reduction and polynomial of the exp used by the sigmoid (Cephes expf, within 2 ulp of expf over the clamped range).
+// exp(x) = 2^n * exp(r) with n = x*log2(e) rounded to nearest and r = x - n*ln(2), ln(2) split in two so r stays exact.
+// Adding NN_EXP_ROUND rounds to an integer and leaves n in the low mantissa bits, from which 2^n is built.
+#define NN_EXP_HI 88.7228394f
+#define NN_EXP_LO -87.3365478515625f
+#define NN_EXP_ROUND 12582912.0f
+#define NN_LOG2E 1.44269504088896341f
+#define NN_LN2_HI 0.693359375f
+#define NN_LN2_LO -2.12194440e-4f
+#define NN_EXP_P0 1.9875691500e-4f
+#define NN_EXP_P1 1.3981999507e-3f
+#define NN_EXP_P2 8.3334519073e-3f
+#define NN_EXP_P3 4.1665795894e-2f
+#define NN_EXP_P4 1.6666665459e-1f
+#define NN_EXP_P5 5.0000001201e-1f
+
+// 1 / (1 + exp(-x)). The exp is computed by hand instead of with expf so that the SIMD version (nn_sigmoid4) can do the
+// very same operations per lane: both give identical results, and neither pays for a libm call per activation. The clamps
+// are written like _mm_min_ps/_mm_max_ps; past them exp(-x) becomes inf or the sigmoid rounds to 1 anyway.
 float sigmoidf(float x)
 {
-    float s = 1.0f / (1.0f + expf(-x));
-    return s;
+    x = -x;
+    x = x < NN_EXP_HI ? x : NN_EXP_HI;
+    x = x > NN_EXP_LO ? x : NN_EXP_LO;
+    union { float f; uint32_t u; } j = {x * NN_LOG2E + NN_EXP_ROUND}, scale;
+    float fn = j.f - NN_EXP_ROUND;
+    x = x - fn * NN_LN2_HI;
+    x = x - fn * NN_LN2_LO;
+    float z = x * x;
+    float y = NN_EXP_P0;
+    y = y * x + NN_EXP_P1;
+    y = y * x + NN_EXP_P2;
+    y = y * x + NN_EXP_P3;
+    y = y * x + NN_EXP_P4;
+    y = y * x + NN_EXP_P5;
+    y = y * z + x + 1.0f;
+    scale.u = (j.u + 127) << 23;
+    return 1.0f / (1.0f + y * scale.f);
 }
 
+#if defined(NN_SSE2)
+// sigmoidf on four lanes, operation for operation, so each lane gives exactly what sigmoidf gives.
+static __m128 nn_sigmoid4(__m128 x)
+{
+    x = _mm_xor_ps(x, _mm_set1_ps(-0.0f));
+    x = _mm_min_ps(x, _mm_set1_ps(NN_EXP_HI));
+    x = _mm_max_ps(x, _mm_set1_ps(NN_EXP_LO));
+    __m128 j = _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(NN_LOG2E)), _mm_set1_ps(NN_EXP_ROUND));
+    __m128 fn = _mm_sub_ps(j, _mm_set1_ps(NN_EXP_ROUND));
+    x = _mm_sub_ps(x, _mm_mul_ps(fn, _mm_set1_ps(NN_LN2_HI)));
+    x = _mm_sub_ps(x, _mm_mul_ps(fn, _mm_set1_ps(NN_LN2_LO)));
+    __m128 z = _mm_mul_ps(x, x);
+    __m128 y = _mm_set1_ps(NN_EXP_P0);
+    y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(NN_EXP_P1));
+    y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(NN_EXP_P2));
+    y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(NN_EXP_P3));
+    y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(NN_EXP_P4));
+    y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(NN_EXP_P5));
+    y = _mm_add_ps(_mm_add_ps(_mm_mul_ps(y, z), x), _mm_set1_ps(1.0f));
+    __m128 scale = _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(_mm_castps_si128(j), _mm_set1_epi32(127)), 23));
+    __m128 one = _mm_set1_ps(1.0f);
+    return _mm_div_ps(one, _mm_add_ps(one, _mm_mul_ps(y, scale)));
+}
+#elif defined(NN_NEON)
+// sigmoidf on four lanes, operation for operation, so each lane gives exactly what sigmoidf gives.
+static float32x4_t nn_sigmoid4(float32x4_t x)
+{
+    x = vnegq_f32(x);
+    x = vminq_f32(x, vdupq_n_f32(NN_EXP_HI));
+    x = vmaxq_f32(x, vdupq_n_f32(NN_EXP_LO));
+    float32x4_t j = vaddq_f32(vmulq_f32(x, vdupq_n_f32(NN_LOG2E)), vdupq_n_f32(NN_EXP_ROUND));
+    float32x4_t fn = vsubq_f32(j, vdupq_n_f32(NN_EXP_ROUND));
+    x = vsubq_f32(x, vmulq_f32(fn, vdupq_n_f32(NN_LN2_HI)));
+    x = vsubq_f32(x, vmulq_f32(fn, vdupq_n_f32(NN_LN2_LO)));
+    float32x4_t z = vmulq_f32(x, x);
+    float32x4_t y = vdupq_n_f32(NN_EXP_P0);
+    y = vaddq_f32(vmulq_f32(y, x), vdupq_n_f32(NN_EXP_P1));
+    y = vaddq_f32(vmulq_f32(y, x), vdupq_n_f32(NN_EXP_P2));
+    y = vaddq_f32(vmulq_f32(y, x), vdupq_n_f32(NN_EXP_P3));
+    y = vaddq_f32(vmulq_f32(y, x), vdupq_n_f32(NN_EXP_P4));
+    y = vaddq_f32(vmulq_f32(y, x), vdupq_n_f32(NN_EXP_P5));
+    y = vaddq_f32(vaddq_f32(vmulq_f32(y, z), x), vdupq_n_f32(1.0f));
+    float32x4_t scale = vreinterpretq_f32_u32(vshlq_n_u32(vaddq_u32(vreinterpretq_u32_f32(j), vdupq_n_u32(127)), 23));
+    float32x4_t den = vaddq_f32(vdupq_n_f32(1.0f), vmulq_f32(y, scale));
+#if defined(__aarch64__)
+    return vdivq_f32(vdupq_n_f32(1.0f), den);
+#else
+    // 32-bit NEON has no vector divide, and the reciprocal estimate would not match sigmoidf
+    float v[4];
+    vst1q_f32(v, den);
+    for (int i = 0; i < 4; i++)
+        v[i] = 1.0f / v[i];
+    return vld1q_f32(v);
+#endif
+}
+#endif
+
 mat mat_alloc(int rows, int cols)
 {
     mat m;
@@ -144,11 +287,22 @@ void mat_print(mat m, const char *name)
     printf("    ]\n\n");
 }
 
+// Four columns at a time through nn_sigmoid4 where SIMD is available, the rest through sigmoidf; the results are the same.
 void mat_sigmoidf(mat m)
 {
     for (int i = 0; i < m.rows; i++)
-        for (int j = 0; j < m.cols; j++)
+    {
+        int j = 0;
+#if defined(NN_SSE2)
+        for (; j + 4 <= m.cols; j += 4)
+            _mm_storeu_ps(&MAT_AT(m, i, j), nn_sigmoid4(_mm_loadu_ps(&MAT_AT(m, i, j))));
+#elif defined(NN_NEON)
+        for (; j + 4 <= m.cols; j += 4)
+            vst1q_f32(&MAT_AT(m, i, j), nn_sigmoid4(vld1q_f32(&MAT_AT(m, i, j))));
+#endif
+        for (; j < m.cols; j++)
             MAT_AT(m, i, j) = sigmoidf(MAT_AT(m, i, j));
+    }
 }
 
 mat mat_getRow(mat m, int row)
@@ -172,7 +326,41 @@ void mat_cpy(mat dest, mat src)
             MAT_AT(dest, i, j) = MAT_AT(src, i, j);
 }
 
+// dest = src * scale, e.g. scale 1/255 to normalize pixels. Converts only what is needed, so large u8 data can stay compact.
+void mat_from_u8(mat dest, mat_u8 src, float scale)
+{
+    NN_ASSERT(dest.rows == src.rows);
+    NN_ASSERT(dest.cols == src.cols);
+    for (int i = 0; i < src.rows; i++)
+    {
+        const unsigned char *s = &MAT_U8_AT(src, i, 0);
+        float *d = &MAT_AT(dest, i, 0);
+        for (int j = 0; j < src.cols; j++)
+            d[j] = s[j] * scale;
+    }
+}
+
+static size_t nn_param_count(int *arch, int arch_count)
+{
+    size_t n = 0;
+    for (int i = 1; i < arch_count; i++)
+        n += (size_t)arch[i - 1] * arch[i] + arch[i];
+    return n;
+}
+
 nn nn_alloc(int *arch, int arch_count)
+{
+    NN_ASSERT(arch_count > 0);
+    // All weights and biases live in one contiguous block (in w[0], b[0], w[1], b[1], ... order)
+    // so the whole parameter set can be copied, saved or loaded with a single memcpy/fwrite/fread.
+    float *params = NN_MALLOC(sizeof(*params) * nn_param_count(arch, arch_count));
+    NN_ASSERT(params != NULL);
+    return nn_wrap(arch, arch_count, params);
+}
+
+// Builds a net whose weights and biases point into an existing parameter arena (e.g. a memory-mapped model file).
+// The arena is not owned: release such a net with nn_unwrap, not nn_free. Activations are still allocated per net.
+nn nn_wrap(int *arch, int arch_count, float *params)
 {
     NN_ASSERT(arch_count > 0);
     nn net;
@@ -184,18 +372,40 @@ nn nn_alloc(int *arch, int arch_count)
     NN_ASSERT(net.b != NULL);
     net.a = malloc(sizeof(*net.a) * arch_count);
     NN_ASSERT(net.a != NULL);
+    net.params = params;
+    net.param_count = nn_param_count(arch, arch_count);
 
+    float *p = net.params;
     net.a[0] = mat_alloc(1, arch[0]);
     for (int i = 1; i < arch_count; i++)
     {
-        net.w[i - 1] = mat_alloc(net.a[i - 1].cols, arch[i]);
-        net.b[i - 1] = mat_alloc(1, arch[i]);
+        net.w[i - 1] = (mat){.rows = arch[i - 1], .cols = arch[i], .stride = arch[i], .data = p};
+        p += arch[i - 1] * arch[i];
+        net.b[i - 1] = (mat){.rows = 1, .cols = arch[i], .stride = arch[i], .data = p};
+        p += arch[i];
         net.a[i] = mat_alloc(1, arch[i]);
     }
 
     return net;
 }
 
+// Frees everything nn_wrap allocated, leaving the parameter arena alone.
+void nn_unwrap(nn net)
+{
+    for (int i = 0; i <= net.count; i++)
+        free(net.a[i].data);
+    free(net.w);
+    free(net.b);
+    free(net.a);
+}
+
+void nn_free(nn net)
+{
+    float *params = net.params;
+    nn_unwrap(net);
+    free(params);
+}
+
 void nn_init(nn net, float n)
 {
     for(int i = 0; i<net.count; i++)
@@ -252,6 +462,112 @@ void nn_forward(nn net)
     }
 }
 
+int nn_max_width(nn net)
+{
+    int w = NN_INPUT_MAT(net).cols;
+    for (int i = 1; i <= net.count; i++)
+        if (net.a[i].cols > w)
+            w = net.a[i].cols;
+    return w;
+}
+
+// Number of floats nn_forward_batch needs as scratch: two ping-pong blocks of NN_BATCH_ROWS rows of the widest layer.
+size_t nn_batch_scratch_size(nn net)
+{
+    return 2 * (size_t)NN_BATCH_ROWS * nn_max_width(net);
+}
+
+// One neuron for 16 samples of a block: d[i] = sigmoidf(sum over k of a[k][i] * w[k], plus b), with a[k] NN_BATCH_ROWS
+// floats apart and w[k] wstride floats apart. Like mat_mult + mat_add in nn_forward, the sum starts from 0, is taken in
+// k order with one multiply and one add per term, and the bias is added last, so every lane rounds exactly like nn_forward
+// (as long as the compiler does not contract the scalar loops into FMAs, which -ffp-contract=off prevents on FMA targets).
+// The sigmoid is applied while the sums are still in registers.
+static void nn_batch_neuron16(float *d, const float *a, const float *w, int wstride, int k_count, float b)
+{
+#if defined(NN_SSE2)
+    __m128 acc0 = _mm_setzero_ps(), acc1 = acc0, acc2 = acc0, acc3 = acc0;
+    for (int k = 0; k < k_count; k++, a += NN_BATCH_ROWS)
+    {
+        __m128 wk = _mm_set1_ps(w[(size_t)k * wstride]);
+        acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(a + 0), wk));
+        acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(a + 4), wk));
+        acc2 = _mm_add_ps(acc2, _mm_mul_ps(_mm_loadu_ps(a + 8), wk));
+        acc3 = _mm_add_ps(acc3, _mm_mul_ps(_mm_loadu_ps(a + 12), wk));
+    }
+    __m128 bias = _mm_set1_ps(b);
+    _mm_storeu_ps(d + 0, nn_sigmoid4(_mm_add_ps(acc0, bias)));
+    _mm_storeu_ps(d + 4, nn_sigmoid4(_mm_add_ps(acc1, bias)));
+    _mm_storeu_ps(d + 8, nn_sigmoid4(_mm_add_ps(acc2, bias)));
+    _mm_storeu_ps(d + 12, nn_sigmoid4(_mm_add_ps(acc3, bias)));
+#elif defined(NN_NEON)
+    float32x4_t acc0 = vdupq_n_f32(0.0f), acc1 = acc0, acc2 = acc0, acc3 = acc0;
+    for (int k = 0; k < k_count; k++, a += NN_BATCH_ROWS)
+    {
+        float32x4_t wk = vdupq_n_f32(w[(size_t)k * wstride]);
+        // vmulq + vaddq rather than vmlaq/vfmaq, which would round differently from the scalar code
+        acc0 = vaddq_f32(acc0, vmulq_f32(vld1q_f32(a + 0), wk));
+        acc1 = vaddq_f32(acc1, vmulq_f32(vld1q_f32(a + 4), wk));
+        acc2 = vaddq_f32(acc2, vmulq_f32(vld1q_f32(a + 8), wk));
+        acc3 = vaddq_f32(acc3, vmulq_f32(vld1q_f32(a + 12), wk));
+    }
+    float32x4_t bias = vdupq_n_f32(b);
+    vst1q_f32(d + 0, nn_sigmoid4(vaddq_f32(acc0, bias)));
+    vst1q_f32(d + 4, nn_sigmoid4(vaddq_f32(acc1, bias)));
+    vst1q_f32(d + 8, nn_sigmoid4(vaddq_f32(acc2, bias)));
+    vst1q_f32(d + 12, nn_sigmoid4(vaddq_f32(acc3, bias)));
+#else
+    for (int i = 0; i < 16; i++)
+        d[i] = 0.0f;
+    for (int k = 0; k < k_count; k++, a += NN_BATCH_ROWS)
+        for (int i = 0; i < 16; i++)
+            d[i] += a[i] * w[(size_t)k * wstride];
+    for (int i = 0; i < 16; i++)
+        d[i] = sigmoidf(d[i] + b);
+#endif
+}
+
+// Forward pass over many samples at once. Row r of `in` is one input, row r of `out` receives its output.
+// Unlike nn_forward this only reads the weights and biases, so several threads can share one net as long as each brings its own scratch (nn_batch_scratch_size floats).
+// Samples go through NN_BATCH_ROWS at a time. Inside a block the activations are stored neuron-major (the values of one neuron
+// for all samples of the block are contiguous), so the vector lanes run over samples: narrow layers like the 7- and 1-wide
+// ends of the coordinate nets use full vectors, and each output is accumulated in registers across the whole k loop.
+// Each output is summed in the same order as in nn_forward and goes through the same sigmoid arithmetic, so the results are
+// the same to the bit. A partial last block is padded with zero inputs whose outputs are never copied out.
+void nn_forward_batch(nn net, mat in, mat out, float *scratch)
+{
+    NN_ASSERT(in.cols == NN_INPUT_MAT(net).cols);
+    NN_ASSERT(out.cols == NN_OUTPUT_MAT(net).cols);
+    NN_ASSERT(in.rows == out.rows);
+    int width = nn_max_width(net);
+    float *buf[2] = {scratch, scratch + (size_t)NN_BATCH_ROWS * width};
+
+    for (int r0 = 0; r0 < in.rows; r0 += NN_BATCH_ROWS)
+    {
+        int n = in.rows - r0 < NN_BATCH_ROWS ? in.rows - r0 : NN_BATCH_ROWS;
+        float *cur = buf[0];
+        for (int k = 0; k < in.cols; k++)
+            for (int r = 0; r < NN_BATCH_ROWS; r++)
+                cur[k * NN_BATCH_ROWS + r] = r < n ? MAT_AT(in, r0 + r, k) : 0.0f;
+
+        for (int l = 0; l < net.count; l++)
+        {
+            float *nxt = buf[(l + 1) & 1];
+            mat w = net.w[l];
+            for (int j = 0; j < w.cols; j++)
+            {
+                float *d = nxt + (size_t)j * NN_BATCH_ROWS;
+                for (int r = 0; r < NN_BATCH_ROWS; r += 16)
+                    nn_batch_neuron16(d + r, cur + r, &MAT_AT(w, 0, j), w.stride, w.rows, MAT_AT(net.b[l], 0, j));
+            }
+            cur = nxt;
+        }
+
+        for (int r = 0; r < n; r++)
+            for (int j = 0; j < out.cols; j++)
+                MAT_AT(out, r0 + r, j) = cur[j * NN_BATCH_ROWS + r];
+    }
+}
+
 float nn_cost(nn net, mat tin, mat tout)
 {
     NN_ASSERT(tin.rows == tout.rows);
@@ -305,6 +621,91 @@ void nn_finite_diff(nn net, nn gradients, float eps, mat tin, mat tout)
     }
 }
 
+// Byte targets are normalized as t / 255.0f, the same division the float-matrix code uses, so keeping targets as uint8
+// gives bit-identical results. The conversion is fused into the error computation: bytes are widened to float in
+// registers (8 or 4 lanes at a time) and never stored as floats.
+
+// d[j] = out[j] - t[j]/255 for j < n.
+static void nn_u8_error(float *d, const float *out, const unsigned char *t, int n)
+{
+    int j = 0;
+#if defined(NN_SSE2)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128 k255 = _mm_set1_ps(255.0f);
+    for (; j + 8 <= n; j += 8)
+    {
+        __m128i b = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(t + j)), zero);
+        __m128 lo = _mm_div_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(b, zero)), k255);
+        __m128 hi = _mm_div_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(b, zero)), k255);
+        _mm_storeu_ps(d + j, _mm_sub_ps(_mm_loadu_ps(out + j), lo));
+        _mm_storeu_ps(d + j + 4, _mm_sub_ps(_mm_loadu_ps(out + j + 4), hi));
+    }
+#elif defined(NN_NEON)
+    const float32x4_t k255 = vdupq_n_f32(255.0f);
+    for (; j + 8 <= n; j += 8)
+    {
+        uint16x8_t b = vmovl_u8(vld1_u8(t + j));
+        float32x4_t lo = vdivq_f32(vcvtq_f32_u32(vmovl_u16(vget_low_u16(b))), k255);
+        float32x4_t hi = vdivq_f32(vcvtq_f32_u32(vmovl_u16(vget_high_u16(b))), k255);
+        vst1q_f32(d + j, vsubq_f32(vld1q_f32(out + j), lo));
+        vst1q_f32(d + j + 4, vsubq_f32(vld1q_f32(out + j + 4), hi));
+    }
+#endif
+    for (; j < n; j++)
+        d[j] = out[j] - t[j] / 255.0f;
+}
+
+// c plus the sum over j < n of (out[j] - t[j]/255)^2, added one term at a time in index order onto the running sum
+// like nn_cost does (summing a block first and adding that would round differently).
+static float nn_u8_sq_error(float c, const float *out, const unsigned char *t, int n)
+{
+    float d[NN_BATCH_ROWS];
+    for (int j0 = 0; j0 < n; j0 += NN_BATCH_ROWS)
+    {
+        int m = n - j0 < NN_BATCH_ROWS ? n - j0 : NN_BATCH_ROWS;
+        nn_u8_error(d, out + j0, t + j0, m);
+        for (int j = 0; j < m; j++)
+            c += d[j] * d[j];
+    }
+    return c;
+}
+
+// Accumulates one sample's gradients. Expects nn_forward to have run on the sample and the output error
+// (output - expected) to be in the output activations of `gradients`.
+static void nn_backprop_sample(nn net, nn gradients)
+{
+    for(int l = net.count-1; l>=0; l--) //iterating through the layers. A little dicey to understand because of count(activations) == count(weight)+1, but that's how the indexing system of the architecture inherently works.
+    {
+        for(int j = 0; j<net.a[l+1].cols; j++) //iterating through each neuron of the layer.
+        {
+            float a = MAT_AT(net.a[l+1], 0, j);
+            float da = MAT_AT(gradients.a[l+1], 0, j);
+            float di = 2*da*a*(1-a);
+            MAT_AT(gradients.b[l], 0, j) += di;
+            for(int k = 0; k<net.a[l].cols; k++) // iterating/accessing the parameters of each neuron from the last layer
+            {
+                MAT_AT(gradients.w[l], k, j) += (di * MAT_AT(net.a[l], 0, k));
+                MAT_AT(gradients.a[l], 0, k) += (di * MAT_AT(net.w[l], k, j));
+            }
+        }
+    }
+}
+
+//calculating average gradients. Excuse the confusion, I wanted to use as few nested loops as possible
+static void nn_backprop_average(nn gradients, int n)
+{
+    for(int i = 0; i<gradients.count; i++)
+    {
+        NN_ASSERT(gradients.w[i].cols == gradients.b[i].cols);
+        for(int j=0; j<gradients.w[i].cols; j++)
+        {
+            MAT_AT(gradients.b[i], 0, j) /= n; //calculated here since bias matrix only ever has 1 row
+            for(int k = 0; k<gradients.w[i].rows; k++)
+                MAT_AT(gradients.w[i], k, j) /= n;
+        }
+    }
+}
+
 void nn_backprop(nn net, nn gradients, mat tin, mat tout)
 {
     NN_ASSERT(tin.rows == tout.rows);
@@ -320,40 +721,117 @@ void nn_backprop(nn net, nn gradients, mat tin, mat tout)
         for(int j = 0; j<gradients.count; j++) //resetting the gradient activations to 0 to avoid unnecessary accumulation 
             mat_init(gradients.a[j], 0.0f);
         
-        for(int j = 0; j<tin.cols; j++)
+        for(int j = 0; j<tout.cols; j++)
         {   //The activation layer of the gradient NN can be used as an intermediate storage since it is unused (and wasted) in the finite difference implementation.
             //Here we initialize the backprop by setting the last layer's actual vs expected difference. The rest will be calculated further inside the loops.
             MAT_AT(NN_OUTPUT_MAT(gradients), 0, j) = MAT_AT(NN_OUTPUT_MAT(net), 0, j) - MAT_AT(tout, i, j);
         }
 
-        for(int l = net.count-1; l>=0; l--) //iterating through the layers. A little dicey to understand because of count(activations) == count(weight)+1, but that's how the indexing system of the architecture inherently works.
-        {
-            for(int j = 0; j<net.a[l+1].cols; j++) //iterating through each neuron of the layer.
-            {
-                float a = MAT_AT(net.a[l+1], 0, j);
-                float da = MAT_AT(gradients.a[l+1], 0, j);
-                float di = 2*da*a*(1-a);
-                MAT_AT(gradients.b[l], 0, j) += di;
-                for(int k = 0; k<net.a[l].cols; k++) // iterating/accessing the parameters of each neuron from the last layer
-                {
-                    MAT_AT(gradients.w[l], k, j) += (di * MAT_AT(net.a[l], 0, k));
-                    MAT_AT(gradients.a[l], 0, k) += (di * MAT_AT(net.w[l], k, j));
-                }
-            }
-        }
+        nn_backprop_sample(net, gradients);
     }
 
-    //calculating average gradients. Excuse the confusion, I wanted to use as few nested loops as possible
-    for(int i = 0; i<gradients.count; i++)
+    nn_backprop_average(gradients, n);
+}
+
+// nn_backprop with byte targets (tout = pixel values 0..255, normalized on the fly).
+void nn_backprop_u8(nn net, nn gradients, mat tin, mat_u8 tout)
+{
+    NN_ASSERT(tin.rows == tout.rows);
+    NN_ASSERT(NN_OUTPUT_MAT(net).cols == tout.cols);
+    nn_init(gradients, 0.0f);
+
+    for (int i = 0; i < tin.rows; i++)
     {
-        NN_ASSERT(gradients.w[i].cols == gradients.b[i].cols);
-        for(int j=0; j<gradients.w[i].cols; j++)
+        mat_cpy(NN_INPUT_MAT(net), mat_getRow(tin, i));
+        nn_forward(net);
+
+        for (int j = 0; j < gradients.count; j++)
+            mat_init(gradients.a[j], 0.0f);
+        nn_u8_error(NN_OUTPUT_MAT(gradients).data, NN_OUTPUT_MAT(net).data, &MAT_U8_AT(tout, i, 0), tout.cols);
+
+        nn_backprop_sample(net, gradients);
+    }
+
+    nn_backprop_average(gradients, tin.rows);
+}
+
+// nn_cost with byte targets. The forward pass runs NN_BATCH_ROWS samples at a time through nn_forward_batch and the
+// error of each block is taken directly against the bytes.
+float nn_cost_u8(nn net, mat tin, mat_u8 tout)
+{
+    NN_ASSERT(tin.rows == tout.rows);
+    NN_ASSERT(tout.cols == NN_OUTPUT_MAT(net).cols);
+    float *scratch = NN_MALLOC(sizeof(float) * (nn_batch_scratch_size(net) + (size_t)NN_BATCH_ROWS * tout.cols));
+    NN_ASSERT(scratch != NULL);
+    mat out = {.cols = tout.cols, .stride = tout.cols, .data = scratch + nn_batch_scratch_size(net)};
+    float c = 0.0f;
+    for (int i0 = 0; i0 < tin.rows; i0 += NN_BATCH_ROWS)
+    {
+        int rows = tin.rows - i0 < NN_BATCH_ROWS ? tin.rows - i0 : NN_BATCH_ROWS;
+        mat in = {.rows = rows, .cols = tin.cols, .stride = tin.stride, .data = &MAT_AT(tin, i0, 0)};
+        out.rows = rows;
+        nn_forward_batch(net, in, out, scratch);
+        if (tout.stride == tout.cols)
+            c = nn_u8_sq_error(c, out.data, &MAT_U8_AT(tout, i0, 0), rows * tout.cols);
+        else
+            for (int r = 0; r < rows; r++)
+                c = nn_u8_sq_error(c, &MAT_AT(out, r, 0), &MAT_U8_AT(tout, i0 + r, 0), tout.cols);
+    }
+    free(scratch);
+    return c / tin.rows;
+}
+
+// Mean squared error over a coordinate set. Inputs are generated NN_BATCH_ROWS samples at a time and pushed through
+// nn_forward_batch, so no input matrix is ever built and the net's activations are left alone.
+float nn_cost_coords(nn net, nn_coords set)
+{
+    NN_ASSERT(NN_INPUT_MAT(net).cols == 2);
+    NN_ASSERT(NN_OUTPUT_MAT(net).cols == 1);
+    float *scratch = NN_MALLOC(sizeof(float) * nn_batch_scratch_size(net));
+    NN_ASSERT(scratch != NULL);
+    float in_data[NN_BATCH_ROWS * 2], out_data[NN_BATCH_ROWS];
+    int n = set.w * set.h;
+    float c = 0.0f;
+    for (int i0 = 0; i0 < n; i0 += NN_BATCH_ROWS)
+    {
+        int rows = n - i0 < NN_BATCH_ROWS ? n - i0 : NN_BATCH_ROWS;
+        mat in = {.rows = rows, .cols = 2, .stride = 2, .data = in_data};
+        mat out = {.rows = rows, .cols = 1, .stride = 1, .data = out_data};
+        for (int r = 0; r < rows; r++)
         {
-            MAT_AT(gradients.b[i], 0, j) /= n; //calculated here since bias matrix only ever has 1 row
-            for(int k = 0; k<gradients.w[i].rows; k++)
-                MAT_AT(gradients.w[i], k, j) /= n;
+            MAT_AT(in, r, 0) = (float)((i0 + r) % set.w) / (set.w - 1);
+            MAT_AT(in, r, 1) = (float)((i0 + r) / set.w) / (set.h - 1);
         }
+        nn_forward_batch(net, in, out, scratch);
+        c = nn_u8_sq_error(c, out_data, set.target + i0, rows);
+    }
+    free(scratch);
+    return c / n;
+}
+
+// nn_backprop over samples first..first+count-1 of a coordinate set (a contiguous range, so threads can split the image).
+// Same result as nn_backprop on the equivalent explicit tin/tout rows.
+void nn_backprop_coords(nn net, nn gradients, nn_coords set, int first, int count)
+{
+    NN_ASSERT(NN_INPUT_MAT(net).cols == 2);
+    NN_ASSERT(NN_OUTPUT_MAT(net).cols == 1);
+    NN_ASSERT(first >= 0 && count > 0 && first + count <= set.w * set.h);
+    nn_init(gradients, 0.0f);
+
+    for (int i = first; i < first + count; i++)
+    {
+        MAT_AT(NN_INPUT_MAT(net), 0, 0) = (float)(i % set.w) / (set.w - 1);
+        MAT_AT(NN_INPUT_MAT(net), 0, 1) = (float)(i / set.w) / (set.h - 1);
+        nn_forward(net);
+
+        for (int j = 0; j < gradients.count; j++)
+            mat_init(gradients.a[j], 0.0f);
+        nn_u8_error(NN_OUTPUT_MAT(gradients).data, NN_OUTPUT_MAT(net).data, set.target + i, 1);
+
+        nn_backprop_sample(net, gradients);
     }
+
+    nn_backprop_average(gradients, count);
 }
 
 void nn_learn(nn net, nn gradients, float rate)
@@ -0,0 +1,331 @@
+#ifndef NN_BAKE_H
+#define NN_BAKE_H
+
+// Bakes a trained coordinate network into a float grayscale mip pyramid so that renders at any size become bilinear lookups instead of forward passes.
+//
+// Level 0 is a (2^lw + 1) x (2^lh + 1) grid evaluated once with nn_grid_eval. Grid point i of level l+1 sits exactly on grid point 2i of level l,
+// so the coarser levels are plain decimations of level 0 and the net is never evaluated again.
+// For every level the worst bilinear error against the real net is measured at cell centers (the furthest point from any sample) and stored in err[].
+//
+// Bakes can be saved next to the model file; nn_bake_load only accepts a bake whose key matches the current parameters.
+//
+//   #define NN_IMPLEMENTATION
+//   #include "nn.h"
+//   #define NN_GRID_IMPLEMENTATION
+//   #include "nn_grid.h"
+//   #define NN_BAKE_IMPLEMENTATION
+//   #include "nn_bake.h"
+
+#include <stdint.h>
+
+#ifndef NN_BAKE_MAX_LEVELS
+#define NN_BAKE_MAX_LEVELS 16
+#endif
+
+// Number of cell centers per axis the error measurement samples on each level.
+#ifndef NN_BAKE_ERR_SAMPLES
+#define NN_BAKE_ERR_SAMPLES 256
+#endif
+
+typedef struct
+{
+    int levels;
+    int w[NN_BAKE_MAX_LEVELS];
+    int h[NN_BAKE_MAX_LEVELS];
+    float err[NN_BAKE_MAX_LEVELS]; // max |net - bilinear| measured on each level
+    float *data[NN_BAKE_MAX_LEVELS]; // level planes, all inside one allocation owned by data[0]
+    uint64_t key; // nn_bake_key of the net this was baked from
+} nn_bake;
+
+uint64_t nn_bake_key(nn net);
+nn_bake nn_bake_build(nn net, int log2_w, int log2_h);
+void nn_bake_free(nn_bake *bk);
+int nn_bake_save(const char *path, nn_bake bk);
+int nn_bake_load(const char *path, nn_bake *bk, uint64_t key);
+int nn_bake_level_for(nn_bake bk, int out_w, int out_h);
+float nn_bake_render(nn_bake bk, float *out, int out_w, int out_h, int stride);
+
+#endif // NN_BAKE_H
+
+#ifdef NN_BAKE_IMPLEMENTATION
+
+#include <string.h>
+
+#define NN_BAKE_MAGIC 0x4B424E4Eu // "NNBK"
+#define NN_BAKE_VERSION 1u
+
+static uint64_t nn_bake__fnv1a(uint64_t h, const void *data, size_t n)
+{
+    const uint8_t *p = data;
+    for (size_t i = 0; i < n; i++)
+    {
+        h ^= p[i];
+        h *= 0x100000001B3ull;
+    }
+    return h;
+}
+
+// Fingerprint of the architecture and every weight and bias. A bake is only valid for the net with the same key.
+uint64_t nn_bake_key(nn net)
+{
+    uint64_t h = 0xCBF29CE484222325ull;
+    h = nn_bake__fnv1a(h, &net.count, sizeof(net.count));
+    for (int l = 0; l < net.count; l++)
+    {
+        h = nn_bake__fnv1a(h, &net.w[l].rows, sizeof(int));
+        h = nn_bake__fnv1a(h, &net.w[l].cols, sizeof(int));
+        for (int r = 0; r < net.w[l].rows; r++)
+            h = nn_bake__fnv1a(h, &MAT_AT(net.w[l], r, 0), sizeof(float) * net.w[l].cols);
+        h = nn_bake__fnv1a(h, net.b[l].data, sizeof(float) * net.b[l].cols);
+    }
+    return h;
+}
+
+static float nn_bake__bilinear(const float *plane, int w, int h, float u, float v)
+{
+    float fx = u * (w - 1), fy = v * (h - 1);
+    int x0 = (int)fx, y0 = (int)fy;
+    if (x0 > w - 2) x0 = w - 2;
+    if (y0 > h - 2) y0 = h - 2;
+    float tx = fx - x0, ty = fy - y0;
+    const float *r0 = plane + (size_t)y0 * w;
+    const float *r1 = r0 + w;
+    float top = r0[x0] + (r0[x0 + 1] - r0[x0]) * tx;
+    float bot = r1[x0] + (r1[x0 + 1] - r1[x0]) * tx;
+    return top + (bot - top) * ty;
+}
+
+// Worst bilinear error of one level, checked against the net at (a subset of) its cell centers.
+static float nn_bake__measure(nn net, const float *plane, int w, int h)
+{
+    int nx = w - 1 < NN_BAKE_ERR_SAMPLES ? w - 1 : NN_BAKE_ERR_SAMPLES;
+    int ny = h - 1 < NN_BAKE_ERR_SAMPLES ? h - 1 : NN_BAKE_ERR_SAMPLES;
+    float max_err = 0.0f;
+
+#pragma omp parallel
+    {
+        float *scratch = NN_MALLOC(sizeof(float) * nn_batch_scratch_size(net));
+        mat in = mat_alloc(nx, 2);
+        mat res = mat_alloc(nx, 1);
+        NN_ASSERT(scratch != NULL);
+        float local_err = 0.0f;
+
+#pragma omp for schedule(dynamic)
+        for (int j = 0; j < ny; j++)
+        {
+            int cy = (int)((long long)j * (h - 1) / ny);
+            for (int i = 0; i < nx; i++)
+            {
+                int cx = (int)((long long)i * (w - 1) / nx);
+                MAT_AT(in, i, 0) = (cx + 0.5f) / (w - 1);
+                MAT_AT(in, i, 1) = (cy + 0.5f) / (h - 1);
+            }
+            nn_forward_batch(net, in, res, scratch);
+            for (int i = 0; i < nx; i++)
+            {
+                float d = fabsf(MAT_AT(res, i, 0) - nn_bake__bilinear(plane, w, h, MAT_AT(in, i, 0), MAT_AT(in, i, 1)));
+                if (d > local_err) local_err = d;
+            }
+        }
+
+#pragma omp critical
+        if (local_err > max_err) max_err = local_err;
+
+        free(scratch);
+        free(in.data);
+        free(res.data);
+    }
+    return max_err;
+}
+
+static void nn_bake__layout(nn_bake *bk, int log2_w, int log2_h)
+{
+    int lmin = log2_w < log2_h ? log2_w : log2_h;
+    bk->levels = lmin + 1 < NN_BAKE_MAX_LEVELS ? lmin + 1 : NN_BAKE_MAX_LEVELS;
+    for (int l = 0; l < bk->levels; l++)
+    {
+        bk->w[l] = (1 << (log2_w - l)) + 1;
+        bk->h[l] = (1 << (log2_h - l)) + 1;
+    }
+}
+
+static size_t nn_bake__total(nn_bake bk)
+{
+    size_t total = 0;
+    for (int l = 0; l < bk.levels; l++)
+        total += (size_t)bk.w[l] * bk.h[l];
+    return total;
+}
+
+static void nn_bake__alloc(nn_bake *bk)
+{
+    float *block = NN_MALLOC(sizeof(float) * nn_bake__total(*bk));
+    NN_ASSERT(block != NULL);
+    for (int l = 0; l < bk->levels; l++)
+    {
+        bk->data[l] = block;
+        block += (size_t)bk->w[l] * bk->h[l];
+    }
+}
+
+// Evaluates the net once on a (2^log2_w + 1) x (2^log2_h + 1) grid and derives the rest of the pyramid from it.
+nn_bake nn_bake_build(nn net, int log2_w, int log2_h)
+{
+    NN_ASSERT(log2_w >= 1 && log2_w < 15);
+    NN_ASSERT(log2_h >= 1 && log2_h < 15);
+    nn_bake bk = {0};
+    nn_bake__layout(&bk, log2_w, log2_h);
+    nn_bake__alloc(&bk);
+    bk.key = nn_bake_key(net);
+
+    nn_grid_eval(net, bk.data[0], bk.w[0], bk.h[0], bk.w[0]);
+    for (int l = 1; l < bk.levels; l++)
+    {
+        const float *src = bk.data[l - 1];
+        float *dst = bk.data[l];
+        for (int y = 0; y < bk.h[l]; y++)
+            for (int x = 0; x < bk.w[l]; x++)
+                dst[(size_t)y * bk.w[l] + x] = src[(size_t)(2 * y) * bk.w[l - 1] + 2 * x];
+    }
+
+    for (int l = 0; l < bk.levels; l++)
+        bk.err[l] = nn_bake__measure(net, bk.data[l], bk.w[l], bk.h[l]);
+    return bk;
+}
+
+void nn_bake_free(nn_bake *bk)
+{
+    free(bk->data[0]);
+    memset(bk, 0, sizeof(*bk));
+}
+
+typedef struct
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t key;
+    int32_t levels;
+    int32_t log2_w;
+    int32_t log2_h;
+    float err[NN_BAKE_MAX_LEVELS];
+} nn_bake__header;
+
+static int nn_bake__log2(int n)
+{
+    int l = 0;
+    while ((1 << (l + 1)) + 1 <= n) l++;
+    return l;
+}
+
+int nn_bake_save(const char *path, nn_bake bk)
+{
+    nn_bake__header hdr = {
+        .magic = NN_BAKE_MAGIC,
+        .version = NN_BAKE_VERSION,
+        .key = bk.key,
+        .levels = bk.levels,
+        .log2_w = nn_bake__log2(bk.w[0]),
+        .log2_h = nn_bake__log2(bk.h[0]),
+    };
+    memcpy(hdr.err, bk.err, sizeof(hdr.err));
+
+    FILE *fp = fopen(path, "wb");
+    if (!fp) return 0;
+    size_t total = nn_bake__total(bk);
+    int ok = fwrite(&hdr, sizeof(hdr), 1, fp) == 1 && fwrite(bk.data[0], sizeof(float), total, fp) == total;
+    if (fclose(fp) != 0) ok = 0;
+    if (!ok) remove(path);
+    return ok;
+}
+
+// Loads a bake saved by nn_bake_save. Fails (returns 0) if the file is missing, damaged, or was baked from a different net than `key`.
+int nn_bake_load(const char *path, nn_bake *bk, uint64_t key)
+{
+    FILE *fp = fopen(path, "rb");
+    if (!fp) return 0;
+    nn_bake__header hdr;
+    if (fread(&hdr, sizeof(hdr), 1, fp) != 1 || hdr.magic != NN_BAKE_MAGIC || hdr.version != NN_BAKE_VERSION || hdr.key != key
+        || hdr.log2_w < 1 || hdr.log2_w >= 15 || hdr.log2_h < 1 || hdr.log2_h >= 15)
+    {
+        fclose(fp);
+        return 0;
+    }
+
+    nn_bake tmp = {0};
+    nn_bake__layout(&tmp, hdr.log2_w, hdr.log2_h);
+    if (tmp.levels != hdr.levels)
+    {
+        fclose(fp);
+        return 0;
+    }
+    nn_bake__alloc(&tmp);
+    tmp.key = hdr.key;
+    memcpy(tmp.err, hdr.err, sizeof(tmp.err));
+    size_t total = nn_bake__total(tmp);
+    int ok = fread(tmp.data[0], sizeof(float), total, fp) == total;
+    fclose(fp);
+    if (!ok)
+    {
+        nn_bake_free(&tmp);
+        return 0;
+    }
+    *bk = tmp;
+    return 1;
+}
+
+// Coarsest level that still has at least as many samples as the output on both axes (level 0 when magnifying).
+int nn_bake_level_for(nn_bake bk, int out_w, int out_h)
+{
+    int l = 0;
+    while (l + 1 < bk.levels && bk.w[l + 1] >= out_w && bk.h[l + 1] >= out_h)
+        l++;
+    return l;
+}
+
+// Renders an out_w x out_h image from the pyramid with the same pixel -> coordinate mapping as nn_grid_eval.
+// Returns the measured error bound of the level that was sampled.
+float nn_bake_render(nn_bake bk, float *out, int out_w, int out_h, int stride)
+{
+    int l = nn_bake_level_for(bk, out_w, out_h);
+    int w = bk.w[l], h = bk.h[l];
+    const float *plane = bk.data[l];
+
+    // Column taps are the same for every row, so they are computed once and the row loop is a branch-free gather + lerp.
+    int *x0 = NN_MALLOC(sizeof(int) * out_w);
+    float *tx = NN_MALLOC(sizeof(float) * out_w);
+    NN_ASSERT(x0 != NULL && tx != NULL);
+    for (int x = 0; x < out_w; x++)
+    {
+        float fx = out_w > 1 ? (float)x * (w - 1) / (out_w - 1) : 0.0f;
+        int ix = (int)fx;
+        if (ix > w - 2) ix = w - 2;
+        x0[x] = ix;
+        tx[x] = fx - ix;
+    }
+
+#pragma omp parallel for schedule(static)
+    for (int y = 0; y < out_h; y++)
+    {
+        float fy = out_h > 1 ? (float)y * (h - 1) / (out_h - 1) : 0.0f;
+        int iy = (int)fy;
+        if (iy > h - 2) iy = h - 2;
+        float ty = fy - iy;
+        const float *r0 = plane + (size_t)iy * w;
+        const float *r1 = r0 + w;
+        float *dst = out + (size_t)y * stride;
+#pragma omp simd
+        for (int x = 0; x < out_w; x++)
+        {
+            int i = x0[x];
+            float top = r0[i] + (r0[i + 1] - r0[i]) * tx[x];
+            float bot = r1[i] + (r1[i + 1] - r1[i]) * tx[x];
+            dst[x] = top + (bot - top) * ty;
+        }
+    }
+
+    free(x0);
+    free(tx);
+    return bk.err[l];
+}
+
+#endif // NN_BAKE_IMPLEMENTATION
@@ -0,0 +1,461 @@
+// Microbenchmarks for the nn.h kernels: mat_mult, nn_forward, nn_forward_batch, nn_backprop and nn_learn, on the layer
+// shapes of every network in the repo, across batch sizes and thread counts.
+//
+// Each line reports ns per operation (mean +- stddev over the repetitions, and the coefficient of variation), GFLOP/s and
+// GB/s. An operation is one kernel call over `batch` samples; with several threads the samples are split between them the
+// way the trainers and nn_grid split them, each thread working on its own copy of the net. FLOPs count the multiplies and
+// adds of the math (sigmoid counts as none), bytes the compulsory traffic: parameters and samples read once, results
+// written once. Small shapes live in L1, so their GB/s is a measure of how well the kernel streams, not of DRAM.
+//
+//to Run:
+//   gcc nn_bench.c -o nn_bench -O2 -fopenmp -lm
+//   ./nn_bench                                 (everything, table on stdout)
+//   ./nn_bench --json bench.json               (also write the results as JSON, "-" for stdout)
+//   ./nn_bench --kernel forward_batch --arch 2-28-14-7-1 --threads 4 --reps 20
+//   ./nn_bench --quick                         (fewer and shorter repetitions)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <omp.h>
+
+#define NN_IMPLEMENTATION
+#include "nn.h"
+
+#define NN_BENCH_IMPLEMENTATION
+#include "nn_bench.h"
+
+#define MAX_ARCH 8
+
+typedef struct
+{
+    int arch[MAX_ARCH];
+    int count;
+} bench_arch;
+
+static const bench_arch archs[] = {
+    {{2, 2, 1}, 3}, // nn_main, nn_viz
+    {{6, 7, 4}, 3}, // adder (NBITS 3)
+    {{2, 14, 7, 1}, 4}, // upscaler, upscaler_fast
+    {{2, 28, 14, 7, 1}, 5}, // ImageUpscaler, upscaler_test, upscaler_final
+    {{2, 128, 64, 32, 1}, 5}, // Mosquitoes
+    {{784, 32, 10}, 3}, // mnist
+};
+
+// Extra mat_mult shapes besides the layers, to see where the naive loop falls off.
+static const int square_sizes[] = {64, 128, 256};
+
+static const int batches[] = {1, 64, 1024, 8192};
+
+typedef struct
+{
+    const int *arch;
+    int arch_count;
+    int batch;
+    int threads;
+    int k, n; // mat_mult: (batch x k) * (k x n)
+    mat a, w, res;
+    mat tin, tout;
+    nn *nets, *grads; // one per thread
+    float **scratch;
+} bench_ctx;
+
+// Rows [first, first + count) of thread tid's share of `rows`.
+static void thread_rows(int rows, int tid, int threads, int *first, int *count)
+{
+    *first = (int)((long)tid * rows / threads);
+    *count = (int)((long)(tid + 1) * rows / threads) - *first;
+}
+
+static mat rows_of(mat m, int first, int count)
+{
+    mat v = m;
+    v.rows = count;
+    v.data = &MAT_AT(m, first, 0);
+    return v;
+}
+
+static void run_mat_mult(void *arg, long iters)
+{
+    bench_ctx *c = arg;
+    #pragma omp parallel num_threads(c->threads)
+    {
+        int first, count;
+        thread_rows(c->batch, omp_get_thread_num(), c->threads, &first, &count);
+        mat a = rows_of(c->a, first, count);
+        mat res = rows_of(c->res, first, count);
+        for (long it = 0; it < iters; it++)
+            mat_mult(res, a, c->w);
+    }
+}
+
+static void run_forward(void *arg, long iters)
+{
+    bench_ctx *c = arg;
+    #pragma omp parallel num_threads(c->threads)
+    {
+        int tid = omp_get_thread_num();
+        int first, count;
+        thread_rows(c->batch, tid, c->threads, &first, &count);
+        nn net = c->nets[tid];
+        for (long it = 0; it < iters; it++)
+            for (int i = first; i < first + count; i++)
+            {
+                mat_cpy(NN_INPUT_MAT(net), mat_getRow(c->tin, i));
+                nn_forward(net);
+            }
+    }
+}
+
+static void run_forward_batch(void *arg, long iters)
+{
+    bench_ctx *c = arg;
+    #pragma omp parallel num_threads(c->threads)
+    {
+        int tid = omp_get_thread_num();
+        int first, count;
+        thread_rows(c->batch, tid, c->threads, &first, &count);
+        mat in = rows_of(c->tin, first, count);
+        mat out = rows_of(c->tout, first, count);
+        for (long it = 0; it < iters; it++)
+            nn_forward_batch(c->nets[0], in, out, c->scratch[tid]);
+    }
+}
+
+static void run_backprop(void *arg, long iters)
+{
+    bench_ctx *c = arg;
+    #pragma omp parallel num_threads(c->threads)
+    {
+        int tid = omp_get_thread_num();
+        int first, count;
+        thread_rows(c->batch, tid, c->threads, &first, &count);
+        mat in = rows_of(c->tin, first, count);
+        mat out = rows_of(c->tout, first, count);
+        for (long it = 0; it < iters; it++)
+            nn_backprop(c->nets[tid], c->grads[tid], in, out);
+    }
+}
+
+static void run_learn(void *arg, long iters)
+{
+    bench_ctx *c = arg;
+    // A tiny rate keeps the parameters from drifting over millions of iterations.
+    for (long it = 0; it < iters; it++)
+        nn_learn(c->nets[0], c->grads[0], 1e-12f);
+}
+
+typedef struct
+{
+    const char *name;
+    nn_bench_fn fn;
+    int batched; // swept over batch sizes and thread counts
+} bench_kernel;
+
+static const bench_kernel kernels[] = {
+    {"mat_mult", run_mat_mult, 1},
+    {"forward", run_forward, 1},
+    {"forward_batch", run_forward_batch, 1},
+    {"backprop", run_backprop, 1},
+    {"learn", run_learn, 0},
+};
+
+// Multiply-adds per sample over all layers (sum of in*out) and neurons per sample (sum of out).
+static void arch_sizes(const int *arch, int count, double *macs, double *neurons)
+{
+    *macs = 0.0;
+    *neurons = 0.0;
+    for (int i = 1; i < count; i++)
+    {
+        *macs += (double)arch[i - 1] * arch[i];
+        *neurons += arch[i];
+    }
+}
+
+// FLOPs and compulsory bytes of one operation of kernel `name`.
+static void kernel_cost(const char *name, bench_ctx *c, double *flops, double *bytes)
+{
+    if (strcmp(name, "mat_mult") == 0)
+    {
+        *flops = 2.0 * c->batch * c->k * c->n;
+        *bytes = 4.0 * ((double)c->batch * c->k + (double)c->k * c->n + (double)c->batch * c->n);
+        return;
+    }
+    double macs, neurons;
+    arch_sizes(c->arch, c->arch_count, &macs, &neurons);
+    double params = macs + neurons;
+    double io = (double)c->batch * (c->arch[0] + c->arch[c->arch_count - 1]);
+    if (strcmp(name, "learn") == 0)
+    {
+        *flops = 2.0 * params; // w -= rate * g
+        *bytes = 4.0 * 3.0 * params; // read w and g, write w
+    }
+    else if (strcmp(name, "backprop") == 0)
+    {
+        // Forward (2 per weight, 1 bias add per neuron), then per weight two multiply-adds (gradient and the error
+        // passed back), per neuron the delta (4) and its bias gradient (1), and the final averaging (1 per parameter).
+        *flops = c->batch * (6.0 * macs + 6.0 * neurons) + params;
+        *bytes = 4.0 * (params + 2.0 * params + io); // read the net, read and write the gradients, the samples
+    }
+    else
+    {
+        *flops = c->batch * (2.0 * macs + neurons);
+        *bytes = 4.0 * (params + io);
+    }
+}
+
+static void arch_name(char *buf, size_t size, const int *arch, int count)
+{
+    size_t n = 0;
+    buf[0] = '\0';
+    for (int i = 0; i < count && n < size; i++)
+        n += snprintf(buf + n, size - n, i ? "-%d" : "%d", arch[i]);
+}
+
+static void fill_random(mat m)
+{
+    for (int i = 0; i < m.rows; i++)
+        for (int j = 0; j < m.cols; j++)
+            MAT_AT(m, i, j) = rand_float();
+}
+
+static nn_bench_result *results;
+static int result_count, result_cap;
+static FILE *table; // stderr when the JSON goes to stdout
+
+static void add_result(nn_bench_result r)
+{
+    if (result_count == result_cap)
+    {
+        result_cap = result_cap ? result_cap * 2 : 128;
+        results = realloc(results, sizeof(*results) * result_cap);
+        NN_ASSERT(results != NULL);
+    }
+    results[result_count++] = r;
+}
+
+static void print_result(const nn_bench_result *r)
+{
+    double sec = r->ns.mean * 1e-9;
+    fprintf(table, "%-14s %-16s %6d %3d %14.1f +- %-10.1f %6.2f%% %9.3f %9.3f\n",
+           r->name, r->shape, r->batch, r->threads, r->ns.mean, r->ns.stddev,
+           r->ns.mean > 0.0 ? 100.0 * r->ns.stddev / r->ns.mean : 0.0,
+           r->flops / sec * 1e-9, r->bytes / sec * 1e-9);
+    fflush(table);
+}
+
+typedef struct
+{
+    int reps;
+    double min_time;
+} bench_opts;
+
+static void bench(const bench_kernel *k, bench_ctx *c, const char *shape, bench_opts o)
+{
+    nn_bench_result r;
+    memset(&r, 0, sizeof(r));
+    snprintf(r.name, sizeof(r.name), "%s", k->name);
+    snprintf(r.shape, sizeof(r.shape), "%s", shape);
+    r.batch = k->batched ? c->batch : 0;
+    r.threads = c->threads;
+    kernel_cost(k->name, c, &r.flops, &r.bytes);
+    r.ns = nn_bench_run(k->fn, c, o.reps, o.min_time);
+    add_result(r);
+    print_result(&r);
+}
+
+// Runs a kernel on one arch for every batch size and thread count.
+static void bench_arch_kernel(const bench_kernel *k, const int *arch, int arch_count, const int *threads, int thread_count,
+                              bench_opts o)
+{
+    char shape[64];
+    arch_name(shape, sizeof(shape), arch, arch_count);
+    int max_threads = threads[thread_count - 1];
+    int batch_count = k->batched ? ARRAY_LEN(batches) : 1;
+    int max_batch = k->batched ? batches[batch_count - 1] : 1;
+
+    bench_ctx c;
+    memset(&c, 0, sizeof(c));
+    c.arch = arch;
+    c.arch_count = arch_count;
+    c.tin = mat_alloc(max_batch, arch[0]);
+    c.tout = mat_alloc(max_batch, arch[arch_count - 1]);
+    fill_random(c.tin);
+    fill_random(c.tout);
+    c.nets = malloc(sizeof(*c.nets) * max_threads);
+    c.grads = malloc(sizeof(*c.grads) * max_threads);
+    c.scratch = malloc(sizeof(*c.scratch) * max_threads);
+    NN_ASSERT(c.nets && c.grads && c.scratch);
+    for (int t = 0; t < max_threads; t++)
+    {
+        c.nets[t] = nn_alloc((int *)arch, arch_count);
+        c.grads[t] = nn_alloc((int *)arch, arch_count);
+        if (t == 0)
+        {
+            srand(0);
+            nn_rand(c.nets[0], -1, 1);
+            nn_rand(c.grads[0], -1, 1);
+        }
+        else
+            memcpy(c.nets[t].params, c.nets[0].params, sizeof(float) * c.nets[0].param_count);
+        c.scratch[t] = malloc(sizeof(float) * nn_batch_scratch_size(c.nets[t]));
+        NN_ASSERT(c.scratch[t] != NULL);
+    }
+
+    for (int b = 0; b < batch_count; b++)
+        for (int t = 0; t < (k->batched ? thread_count : 1); t++)
+        {
+            c.batch = k->batched ? batches[b] : 1;
+            c.threads = threads[t];
+            if (c.batch < c.threads) continue;
+            bench(k, &c, shape, o);
+        }
+
+    for (int t = 0; t < max_threads; t++)
+    {
+        nn_free(c.nets[t]);
+        nn_free(c.grads[t]);
+        free(c.scratch[t]);
+    }
+    free(c.nets);
+    free(c.grads);
+    free(c.scratch);
+    free(c.tin.data);
+    free(c.tout.data);
+}
+
+// mat_mult on (batch x k) * (k x n) for every batch size and thread count. With `limit`, products over 1e8 multiply-adds
+// are skipped: the naive loop takes seconds on them and they say nothing the smaller ones do not.
+static void bench_mat_mult(int k, int n, int limit, const int *threads, int thread_count, bench_opts o)
+{
+    char shape[64];
+    snprintf(shape, sizeof(shape), "%dx%d", k, n);
+    int batch_count = ARRAY_LEN(batches);
+    int max_batch = batches[batch_count - 1];
+
+    bench_ctx c;
+    memset(&c, 0, sizeof(c));
+    c.k = k;
+    c.n = n;
+    c.a = mat_alloc(max_batch, k);
+    c.w = mat_alloc(k, n);
+    c.res = mat_alloc(max_batch, n);
+    srand(0);
+    fill_random(c.a);
+    fill_random(c.w);
+
+    for (int b = 0; b < batch_count; b++)
+        for (int t = 0; t < thread_count; t++)
+        {
+            c.batch = batches[b];
+            c.threads = threads[t];
+            if (c.batch < c.threads) continue;
+            if (limit && (double)c.batch * k * n > 1e8) continue;
+            bench(&kernels[0], &c, shape, o);
+        }
+
+    free(c.a.data);
+    free(c.w.data);
+    free(c.res.data);
+}
+
+static int matches(const char *filter, const char *name)
+{
+    return filter == NULL || strcmp(filter, name) == 0;
+}
+
+int main(int argc, char **argv)
+{
+    const char *json_path = NULL;
+    const char *kernel_filter = NULL;
+    const char *arch_filter = NULL;
+    int only_threads = 0;
+    bench_opts o = {.reps = 10, .min_time = 0.05};
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--json") == 0 && i + 1 < argc) json_path = argv[++i];
+        else if (strcmp(argv[i], "--kernel") == 0 && i + 1 < argc) kernel_filter = argv[++i];
+        else if (strcmp(argv[i], "--arch") == 0 && i + 1 < argc) arch_filter = argv[++i];
+        else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) only_threads = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--reps") == 0 && i + 1 < argc) o.reps = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--quick") == 0) { o.reps = 3; o.min_time = 0.01; }
+        else
+        {
+            fprintf(stderr, "Usage: %s [--json FILE | -] [--kernel NAME] [--arch 2-28-14-7-1] [--threads N] [--reps N] [--quick]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (o.reps < 2) o.reps = 2;
+
+    // 1, 2, 4, ... up to the core count, and the core count itself.
+    int threads[32];
+    int thread_count = 0;
+    int max_threads = omp_get_max_threads();
+    if (only_threads > 0)
+        threads[thread_count++] = only_threads;
+    else
+    {
+        for (int t = 1; t < max_threads && thread_count < 31; t *= 2)
+            threads[thread_count++] = t;
+        threads[thread_count++] = max_threads;
+    }
+
+    table = json_path && strcmp(json_path, "-") == 0 ? stderr : stdout;
+    fprintf(table, "nn.h kernels, %d threads available, NN_BATCH_ROWS %d, %d repetitions of >= %.0f ms\n\n",
+           max_threads, NN_BATCH_ROWS, o.reps, o.min_time * 1e3);
+    fprintf(table, "%-14s %-16s %6s %3s %30s %7s %9s %9s\n", "kernel", "shape", "batch", "thr", "ns/op (mean +- stddev)", "cv",
+           "GFLOP/s", "GB/s");
+
+    int kernel_count = ARRAY_LEN(kernels), arch_total = ARRAY_LEN(archs), square_count = ARRAY_LEN(square_sizes);
+    for (int k = 0; k < kernel_count; k++)
+    {
+        if (!matches(kernel_filter, kernels[k].name)) continue;
+        if (k == 0)
+        {
+            // Every distinct layer shape, then a few larger squares.
+            int seen[64][2];
+            int seen_count = 0;
+            for (int a = 0; a < arch_total; a++)
+            {
+                char shape[64];
+                arch_name(shape, sizeof(shape), archs[a].arch, archs[a].count);
+                if (!matches(arch_filter, shape)) continue;
+                for (int l = 1; l < archs[a].count; l++)
+                {
+                    int in = archs[a].arch[l - 1], out = archs[a].arch[l];
+                    int dup = 0;
+                    for (int s = 0; s < seen_count; s++)
+                        dup |= seen[s][0] == in && seen[s][1] == out;
+                    if (dup) continue;
+                    seen[seen_count][0] = in;
+                    seen[seen_count][1] = out;
+                    seen_count++;
+                    bench_mat_mult(in, out, 0, threads, thread_count, o);
+                }
+            }
+            if (arch_filter == NULL)
+                for (int s = 0; s < square_count; s++)
+                    bench_mat_mult(square_sizes[s], square_sizes[s], 1, threads, thread_count, o);
+            continue;
+        }
+        for (int a = 0; a < arch_total; a++)
+        {
+            char shape[64];
+            arch_name(shape, sizeof(shape), archs[a].arch, archs[a].count);
+            if (!matches(arch_filter, shape)) continue;
+            bench_arch_kernel(&kernels[k], archs[a].arch, archs[a].count, threads, thread_count, o);
+        }
+    }
+
+    if (json_path)
+    {
+        if (!nn_bench_write_json(json_path, "kernels", results, result_count))
+        {
+            fprintf(stderr, "Could not write %s\n", json_path);
+            return 1;
+        }
+        if (table == stdout) printf("\nResults written to %s\n", json_path);
+    }
+    free(results);
+    return 0;
+}
@@ -0,0 +1,314 @@
+#ifndef NN_BENCH_H
+#define NN_BENCH_H
+
+// Timing, statistics and JSON results for the benchmark programs.
+//
+// nn_bench_run times a function that performs `iters` operations per call. It first calibrates the iteration count so
+// that one repetition takes at least `min_time` seconds (so timer resolution and loop overhead do not matter), then times
+// `reps` repetitions and returns nanoseconds per operation over them: mean, standard deviation, min, median and max.
+// Reporting the spread matters more than the mean: a change is only faster if the difference is well outside it.
+//
+// Results are written as JSON with one result object per line, so the files diff well and can be read back
+// with nn_bench_read_json without a JSON library:
+//
+//   {"suite": "kernels", "simd": "sse2", "batch_rows": 64, "max_threads": 8, "results": [
+//   {"name": "forward_batch", "shape": "2-28-14-7-1", "batch": 1024, "threads": 1, "ns_mean": 51234.5, ...},
+//   ...
+//   ]}
+//
+// nn_bench_compare matches a run against such a file kept as a baseline and flags what got slower beyond the noise.
+//
+//   #define NN_BENCH_IMPLEMENTATION
+//   #include "nn_bench.h"
+//
+// Does not need nn.h.
+
+#include <stdio.h>
+
+typedef struct
+{
+    int n; // repetitions
+    double mean, stddev, min, median, max;
+} nn_bench_stats;
+
+typedef struct
+{
+    char name[32]; // kernel or scenario
+    char shape[64]; // arch ("2-28-14-7-1") or matrix shape ("64x128x32"), or a scenario's parameters
+    int batch; // samples (rows) per operation, 0 if it does not apply
+    int threads;
+    double flops; // floating point operations per operation, 0 if not modelled
+    double bytes; // compulsory memory traffic per operation (every input read and every output written once), 0 if not modelled
+    double value; // a result the operation produced (final cost, epochs to converge, ...), checked for reproducibility
+    nn_bench_stats ns; // nanoseconds per operation
+} nn_bench_result;
+
+// Performs `iters` operations on ctx.
+typedef void (*nn_bench_fn)(void *ctx, long iters);
+
+double nn_bench_now(void);
+nn_bench_stats nn_bench_stats_of(double *samples, int n);
+nn_bench_stats nn_bench_run(nn_bench_fn fn, void *ctx, int reps, double min_time);
+int nn_bench_write_json(const char *path, const char *suite, const nn_bench_result *results, int count);
+int nn_bench_read_json(const char *path, nn_bench_result **results);
+int nn_bench_compare(const nn_bench_result *base, int base_count, const nn_bench_result *cur, int count, double noise, FILE *out);
+
+#endif // NN_BENCH_H
+
+#ifdef NN_BENCH_IMPLEMENTATION
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// Monotonic wall clock in seconds.
+double nn_bench_now(void)
+{
+#ifdef _OPENMP
+    return omp_get_wtime();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+#endif
+}
+
+static int nn_bench__cmp(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// Summarizes n samples. Sorts them in place.
+nn_bench_stats nn_bench_stats_of(double *samples, int n)
+{
+    nn_bench_stats s = {0};
+    if (n <= 0) return s;
+    qsort(samples, n, sizeof(*samples), nn_bench__cmp);
+    double sum = 0.0;
+    for (int i = 0; i < n; i++)
+        sum += samples[i];
+    s.n = n;
+    s.mean = sum / n;
+    double var = 0.0;
+    for (int i = 0; i < n; i++)
+        var += (samples[i] - s.mean) * (samples[i] - s.mean);
+    s.stddev = n > 1 ? sqrt(var / (n - 1)) : 0.0;
+    s.min = samples[0];
+    s.max = samples[n - 1];
+    s.median = n % 2 ? samples[n / 2] : 0.5 * (samples[n / 2 - 1] + samples[n / 2]);
+    return s;
+}
+
+// Nanoseconds per operation of fn over `reps` timed repetitions of at least min_time seconds each.
+nn_bench_stats nn_bench_run(nn_bench_fn fn, void *ctx, int reps, double min_time)
+{
+    // Calibrate: double the iteration count until one call takes long enough. The first calls also warm the caches.
+    long iters = 1;
+    for (;;)
+    {
+        double t = nn_bench_now();
+        fn(ctx, iters);
+        t = nn_bench_now() - t;
+        if (t >= min_time || iters >= (1L << 40)) break;
+        long next = t > 0.0 ? (long)(iters * 1.2 * min_time / t) + 1 : iters * 16;
+        iters = next > iters * 16 ? iters * 16 : next > iters ? next : iters * 2;
+    }
+
+    double *samples = malloc(sizeof(*samples) * (reps > 0 ? reps : 1));
+    if (samples == NULL)
+    {
+        nn_bench_stats none = {0};
+        return none;
+    }
+    for (int r = 0; r < reps; r++)
+    {
+        double t = nn_bench_now();
+        fn(ctx, iters);
+        samples[r] = (nn_bench_now() - t) * 1e9 / iters;
+    }
+    nn_bench_stats s = nn_bench_stats_of(samples, reps);
+    free(samples);
+    return s;
+}
+
+static const char *nn_bench__simd(void)
+{
+#if defined(__AVX2__)
+    return "avx2";
+#elif defined(__SSE2__) || defined(_M_X64)
+    return "sse2";
+#elif defined(__ARM_NEON)
+    return "neon";
+#else
+    return "scalar";
+#endif
+}
+
+// Writes the results to path ("-" for stdout). Returns 0 on failure.
+int nn_bench_write_json(const char *path, const char *suite, const nn_bench_result *results, int count)
+{
+    FILE *f = strcmp(path, "-") == 0 ? stdout : fopen(path, "w");
+    if (f == NULL) return 0;
+
+    int max_threads = 1;
+#ifdef _OPENMP
+    max_threads = omp_get_max_threads();
+#endif
+    fprintf(f, "{\"suite\": \"%s\", \"simd\": \"%s\", ", suite, nn_bench__simd());
+#ifdef NN_BATCH_ROWS
+    fprintf(f, "\"batch_rows\": %d, ", NN_BATCH_ROWS);
+#endif
+#ifdef __VERSION__
+    fprintf(f, "\"compiler\": \"%s\", ", __VERSION__);
+#endif
+    fprintf(f, "\"max_threads\": %d, \"results\": [\n", max_threads);
+    for (int i = 0; i < count; i++)
+    {
+        const nn_bench_result *r = &results[i];
+        double sec = r->ns.mean * 1e-9;
+        fprintf(f, "{\"name\": \"%s\", \"shape\": \"%s\", \"batch\": %d, \"threads\": %d, \"reps\": %d, "
+                   "\"ns_mean\": %.6g, \"ns_stddev\": %.6g, \"ns_min\": %.6g, \"ns_median\": %.6g, \"ns_max\": %.6g, "
+                   "\"cv\": %.4f, \"flops\": %.6g, \"bytes\": %.6g, \"gflops\": %.4f, \"gbytes_per_s\": %.4f, \"value\": %.9g}%s\n",
+                r->name, r->shape, r->batch, r->threads, r->ns.n,
+                r->ns.mean, r->ns.stddev, r->ns.min, r->ns.median, r->ns.max,
+                r->ns.mean > 0.0 ? r->ns.stddev / r->ns.mean : 0.0, r->flops, r->bytes,
+                sec > 0.0 ? r->flops / sec * 1e-9 : 0.0, sec > 0.0 ? r->bytes / sec * 1e-9 : 0.0, r->value,
+                i + 1 < count ? "," : "");
+    }
+    fprintf(f, "]}\n");
+
+    int ok = !ferror(f);
+    if (f != stdout)
+        ok = fclose(f) == 0 && ok;
+    else
+        fflush(f);
+    return ok;
+}
+
+// Finds "key": in line and parses the value after it. Returns 0 if the key is missing.
+static int nn_bench__field(const char *line, const char *key, char *str, size_t str_size, double *num)
+{
+    char pattern[40];
+    snprintf(pattern, sizeof(pattern), "\"%s\":", key);
+    const char *p = strstr(line, pattern);
+    if (p == NULL) return 0;
+    p += strlen(pattern);
+    while (*p == ' ') p++;
+    if (str != NULL)
+    {
+        if (*p != '"') return 0;
+        p++;
+        size_t n = 0;
+        while (p[n] != '"' && p[n] != '\0' && n + 1 < str_size) n++;
+        memcpy(str, p, n);
+        str[n] = '\0';
+        return 1;
+    }
+    *num = strtod(p, NULL);
+    return 1;
+}
+
+// Reads results written by nn_bench_write_json into a malloc'ed array (free with free()). Returns the number of
+// results, or -1 if the file cannot be opened.
+int nn_bench_read_json(const char *path, nn_bench_result **results)
+{
+    *results = NULL;
+    FILE *f = fopen(path, "r");
+    if (f == NULL) return -1;
+
+    int count = 0, cap = 0;
+    char line[1024];
+    while (fgets(line, sizeof(line), f))
+    {
+        nn_bench_result r;
+        memset(&r, 0, sizeof(r));
+        double batch = 0, threads = 0, reps = 0;
+        if (!nn_bench__field(line, "name", r.name, sizeof(r.name), NULL)) continue;
+        nn_bench__field(line, "shape", r.shape, sizeof(r.shape), NULL);
+        nn_bench__field(line, "batch", NULL, 0, &batch);
+        nn_bench__field(line, "threads", NULL, 0, &threads);
+        nn_bench__field(line, "reps", NULL, 0, &reps);
+        nn_bench__field(line, "ns_mean", NULL, 0, &r.ns.mean);
+        nn_bench__field(line, "ns_stddev", NULL, 0, &r.ns.stddev);
+        nn_bench__field(line, "ns_min", NULL, 0, &r.ns.min);
+        nn_bench__field(line, "ns_median", NULL, 0, &r.ns.median);
+        nn_bench__field(line, "ns_max", NULL, 0, &r.ns.max);
+        nn_bench__field(line, "flops", NULL, 0, &r.flops);
+        nn_bench__field(line, "bytes", NULL, 0, &r.bytes);
+        nn_bench__field(line, "value", NULL, 0, &r.value);
+        r.batch = (int)batch;
+        r.threads = (int)threads;
+        r.ns.n = (int)reps;
+
+        if (count == cap)
+        {
+            cap = cap ? cap * 2 : 64;
+            nn_bench_result *grown = realloc(*results, sizeof(**results) * cap);
+            if (grown == NULL) break;
+            *results = grown;
+        }
+        (*results)[count++] = r;
+    }
+    fclose(f);
+    return count;
+}
+
+static int nn_bench__same(const nn_bench_result *a, const nn_bench_result *b)
+{
+    return strcmp(a->name, b->name) == 0 && strcmp(a->shape, b->shape) == 0 && a->batch == b->batch &&
+           a->threads == b->threads;
+}
+
+// Compares each result of a run against the baseline result with the same name, shape, batch and thread count, prints
+// one line per result to `out` and returns the number of regressions.
+//
+// A result is slower (a regression) or faster only if its mean moved by more than the noise threshold, and by more than
+// twice the combined coefficient of variation of both runs: a noisy measurement has to move further to count. A
+// result whose `value` differs from the baseline's (beyond float printing precision) counts as a regression too, since
+// the same seeds and inputs should give the same result.
+int nn_bench_compare(const nn_bench_result *base, int base_count, const nn_bench_result *cur, int count, double noise, FILE *out)
+{
+    int regressions = 0;
+    fprintf(out, "%-16s %-30s %3s %12s %12s %8s %7s  %s\n", "name", "shape", "thr", "base ms", "now ms", "change",
+            "bound", "verdict");
+    for (int i = 0; i < count; i++)
+    {
+        const nn_bench_result *c = &cur[i];
+        const nn_bench_result *b = NULL;
+        for (int j = 0; j < base_count && b == NULL; j++)
+            if (nn_bench__same(&base[j], c)) b = &base[j];
+        if (b == NULL || b->ns.mean <= 0.0)
+        {
+            fprintf(out, "%-16s %-30s %3d %12s %12.3f %8s %7s  new\n", c->name, c->shape, c->threads, "-",
+                    c->ns.mean * 1e-6, "-", "-");
+            continue;
+        }
+
+        double change = (c->ns.mean - b->ns.mean) / b->ns.mean;
+        double cv_b = b->ns.stddev / b->ns.mean;
+        double cv_c = c->ns.mean > 0.0 ? c->ns.stddev / c->ns.mean : 0.0;
+        double bound = 2.0 * sqrt(cv_b * cv_b + cv_c * cv_c);
+        if (bound < noise) bound = noise;
+        int changed = fabs(c->value - b->value) > 1e-6 * fmax(1.0, fabs(b->value));
+
+        const char *verdict = "ok";
+        if (changed) verdict = "RESULT CHANGED";
+        else if (change > bound) verdict = "SLOWER";
+        else if (change < -bound) verdict = "faster";
+        regressions += changed || change > bound;
+
+        fprintf(out, "%-16s %-30s %3d %12.3f %12.3f %+7.1f%% %6.1f%%  %s", c->name, c->shape, c->threads,
+                b->ns.mean * 1e-6, c->ns.mean * 1e-6, 100.0 * change, 100.0 * bound, verdict);
+        if (changed) fprintf(out, " (%.9g, was %.9g)", c->value, b->value);
+        fprintf(out, "\n");
+    }
+    return regressions;
+}
+
+#endif // NN_BENCH_IMPLEMENTATION
@@ -0,0 +1,261 @@
+#ifndef NN_BUNDLE_H
+#define NN_BUNDLE_H
+
+// Many models in one file, opened with a single mmap.
+//
+// Layout:
+//
+//   nn_bundle_header        64 bytes
+//   nn_bundle_entry[count]  index, sorted by name
+//   model records           each one a complete nn_io.h record (header, arch, params) starting on an NN_FILE_ALIGN boundary
+//
+// Opening a bundle maps the file and checks the bundle header and index bounds, nothing else, so it costs the same for
+// ten models or ten thousand. nn_bundle_get builds a net whose w/b point straight into the mapping: no copies, no parsing
+// beyond that one record's header, and every process serving the same bundle shares one page-cache copy of the weights.
+// The mapping is read-only, so these nets can run forward passes but must never be trained in place.
+//
+//   #define NN_IMPLEMENTATION
+//   #include "nn.h"
+//   #define NN_IO_IMPLEMENTATION
+//   #include "nn_io.h"
+//   #define NN_BUNDLE_IMPLEMENTATION
+//   #include "nn_bundle.h"
+
+#define NN_BUNDLE_MAGIC "NNBD"
+#define NN_BUNDLE_VERSION 1u
+#define NN_BUNDLE_NAME_MAX 48
+
+typedef struct
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t endian;
+    uint32_t count;
+    uint64_t index_offset;
+    uint64_t file_size;
+    uint8_t pad[32];
+} nn_bundle_header;
+
+typedef struct
+{
+    char name[NN_BUNDLE_NAME_MAX]; // NUL terminated
+    uint64_t offset; // of the model record, from the start of the file
+    uint64_t size;
+} nn_bundle_entry;
+
+typedef struct
+{
+    nn_mapping map;
+    const nn_bundle_header *hdr;
+    const nn_bundle_entry *index;
+    int count;
+} nn_bundle;
+
+int nn_bundle_write(const char *path, const char **names, nn *nets, int count);
+int nn_bundle_open(const char *path, nn_bundle *b);
+void nn_bundle_close(nn_bundle *b);
+int nn_bundle_find(nn_bundle b, const char *name);
+int nn_bundle_get(nn_bundle b, int i, nn *net);
+int nn_bundle_verify(nn_bundle b, int i);
+void nn_bundle_release(nn net);
+
+#endif // NN_BUNDLE_H
+
+#ifdef NN_BUNDLE_IMPLEMENTATION
+
+#include <string.h>
+
+static const char **nn_bundle__sort_names;
+
+static int nn_bundle__cmp(const void *a, const void *b)
+{
+    return strcmp(nn_bundle__sort_names[*(const int *)a], nn_bundle__sort_names[*(const int *)b]);
+}
+
+static int nn_bundle__pad(FILE *fp, uint64_t *pos)
+{
+    static const uint8_t zeros[NN_FILE_ALIGN];
+    uint64_t pad = (NN_FILE_ALIGN - *pos % NN_FILE_ALIGN) % NN_FILE_ALIGN;
+    *pos += pad;
+    return fwrite(zeros, 1, pad, fp) == pad;
+}
+
+// Writes count nets into one bundle file. Names must be unique and shorter than NN_BUNDLE_NAME_MAX.
+int nn_bundle_write(const char *path, const char **names, nn *nets, int count)
+{
+    int *order = malloc(sizeof(int) * count);
+    nn_bundle_entry *index = calloc(count, sizeof(nn_bundle_entry));
+    if (!order || !index)
+    {
+        free(order);
+        free(index);
+        return 0;
+    }
+    for (int i = 0; i < count; i++)
+    {
+        NN_ASSERT(strlen(names[i]) < NN_BUNDLE_NAME_MAX);
+        order[i] = i;
+    }
+    nn_bundle__sort_names = names;
+    qsort(order, count, sizeof(int), nn_bundle__cmp);
+
+    int ok = 0;
+    FILE *fp = fopen(path, "wb");
+    if (!fp) goto done;
+
+    // Header and index go first but are only complete once the records have been written, so write them as placeholders
+    // and come back. Writing rather than seeking past them keeps every offset out of fseek's long, which is 32 bits on Windows.
+    nn_bundle_header hdr = {
+        .magic = {'N', 'N', 'B', 'D'},
+        .version = NN_BUNDLE_VERSION,
+        .endian = NN_FILE_ENDIAN,
+        .count = (uint32_t)count,
+        .index_offset = sizeof(nn_bundle_header),
+    };
+    uint64_t pos = sizeof(hdr) + sizeof(nn_bundle_entry) * (uint64_t)count;
+    if (fwrite(&hdr, sizeof(hdr), 1, fp) != 1 || fwrite(index, sizeof(nn_bundle_entry), count, fp) != (size_t)count)
+        goto done;
+
+    for (int k = 0; k < count; k++)
+    {
+        int i = order[k];
+        if (k > 0 && strcmp(names[i], names[order[k - 1]]) == 0)
+        {
+            fprintf(stderr, "%s: duplicate model name %s\n", path, names[i]);
+            goto done;
+        }
+        if (!nn_bundle__pad(fp, &pos)) goto done;
+        size_t size = nn_write(fp, nets[i]);
+        if (size == 0) goto done;
+        strcpy(index[k].name, names[i]);
+        index[k].offset = pos;
+        index[k].size = size;
+        pos += size;
+    }
+    hdr.file_size = pos;
+
+    ok = fseek(fp, 0, SEEK_SET) == 0
+      && fwrite(&hdr, sizeof(hdr), 1, fp) == 1
+      && fwrite(index, sizeof(nn_bundle_entry), count, fp) == (size_t)count;
+
+done:
+    if (fp && fclose(fp) != 0) ok = 0;
+    if (fp && !ok) remove(path);
+    free(order);
+    free(index);
+    return ok;
+}
+
+// Maps a bundle. Only the bundle header and the index bounds are checked here; individual records are checked by nn_bundle_get.
+int nn_bundle_open(const char *path, nn_bundle *b)
+{
+    memset(b, 0, sizeof(*b));
+    if (!nn_map_file(path, &b->map))
+    {
+        fprintf(stderr, "%s: cannot map bundle\n", path);
+        return 0;
+    }
+    const nn_bundle_header *hdr = b->map.data;
+    if (b->map.size < sizeof(*hdr) || memcmp(hdr->magic, NN_BUNDLE_MAGIC, 4) != 0 || hdr->version != NN_BUNDLE_VERSION)
+        fprintf(stderr, "%s: not an nn bundle\n", path);
+    else if (hdr->endian != NN_FILE_ENDIAN)
+        fprintf(stderr, "%s: bundle was written with the other byte order and cannot be mapped\n", path);
+    else if (hdr->file_size != b->map.size || hdr->index_offset % 8 != 0
+             || hdr->index_offset + sizeof(nn_bundle_entry) * (uint64_t)hdr->count > b->map.size)
+        fprintf(stderr, "%s: bundle is truncated\n", path);
+    else
+    {
+        b->hdr = hdr;
+        b->index = (const nn_bundle_entry *)((const uint8_t *)b->map.data + hdr->index_offset);
+        b->count = (int)hdr->count;
+        return 1;
+    }
+    nn_unmap_file(&b->map);
+    return 0;
+}
+
+void nn_bundle_close(nn_bundle *b)
+{
+    nn_unmap_file(&b->map);
+    memset(b, 0, sizeof(*b));
+}
+
+// Binary search over the sorted index. Returns the entry number or -1.
+int nn_bundle_find(nn_bundle b, const char *name)
+{
+    int lo = 0, hi = b.count - 1;
+    while (lo <= hi)
+    {
+        int mid = lo + (hi - lo) / 2;
+        int c = strncmp(name, b.index[mid].name, NN_BUNDLE_NAME_MAX);
+        if (c == 0) return mid;
+        if (c < 0) hi = mid - 1;
+        else lo = mid + 1;
+    }
+    return -1;
+}
+
+// Checks that entry i's record lies inside the mapping and is at least a header long.
+static int nn_bundle__entry_ok(nn_bundle b, int i)
+{
+    NN_ASSERT(i >= 0 && i < b.count);
+    nn_bundle_entry e = b.index[i];
+    if (e.offset % NN_FILE_ALIGN != 0 || e.size < sizeof(nn_file_header) || e.offset > b.map.size
+        || e.size > b.map.size - e.offset)
+    {
+        fprintf(stderr, "%.*s: record out of bounds\n", NN_BUNDLE_NAME_MAX, e.name);
+        return 0;
+    }
+    return 1;
+}
+
+// Builds a net for entry i whose parameters point into the mapping. Release it with nn_bundle_release before closing the bundle.
+int nn_bundle_get(nn_bundle b, int i, nn *net)
+{
+    if (!nn_bundle__entry_ok(b, i)) return 0;
+    const char *name = b.index[i].name;
+    nn_bundle_entry e = b.index[i];
+    const uint8_t *rec = (const uint8_t *)b.map.data + e.offset;
+    nn_file_header hdr;
+    memcpy(&hdr, rec, sizeof(hdr));
+    int swap;
+    if (!nn_file_check_header(name, &hdr, &swap)) return 0;
+    if (swap || hdr.payload_offset + sizeof(float) * hdr.param_count != e.size)
+    {
+        fprintf(stderr, "%.*s: record does not match its index entry\n", NN_BUNDLE_NAME_MAX, name);
+        return 0;
+    }
+    int *arch = malloc(sizeof(int) * hdr.layers);
+    NN_ASSERT(arch != NULL);
+    if (!nn_file_check_arch(name, hdr, rec + sizeof(hdr), 0, arch))
+    {
+        free(arch);
+        return 0;
+    }
+    // nn_wrap takes a mutable pointer because trainable nets share the type; nothing here ever writes through it.
+    *net = nn_wrap(arch, hdr.layers, (float *)(rec + hdr.payload_offset));
+    free(arch);
+    return 1;
+}
+
+// Full checksum of one record. This touches every page of the model, so it is kept out of nn_bundle_get.
+// Returns 0 for a record that fails the checksum or lies outside the file.
+int nn_bundle_verify(nn_bundle b, int i)
+{
+    if (!nn_bundle__entry_ok(b, i)) return 0;
+    const uint8_t *rec = (const uint8_t *)b.map.data + b.index[i].offset;
+    nn_file_header hdr;
+    memcpy(&hdr, rec, sizeof(hdr));
+    uint64_t stored = hdr.checksum;
+    hdr.checksum = 0;
+    uint64_t h = nn_checksum(NN_CHECKSUM_INIT, &hdr, sizeof(hdr));
+    h = nn_checksum(h, rec + sizeof(hdr), b.index[i].size - sizeof(hdr));
+    return h == stored;
+}
+
+void nn_bundle_release(nn net)
+{
+    nn_unwrap(net);
+}
+
+#endif // NN_BUNDLE_IMPLEMENTATION
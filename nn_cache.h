@@ -0,0 +1,431 @@
+#ifndef NN_CACHE_H
+#define NN_CACHE_H
+
+// Decoded image cache: PNG directory trees decoded once into one file that training programs mmap instead of calling stbi_load.
+//
+// Layout:
+//
+//   nn_cache_header         64 bytes
+//   nn_cache_entry[count]   one per image file, sorted by path
+//   pixels                  8-bit grayscale, row-major, each image starting on an NN_FILE_ALIGN boundary
+//
+// Paths are stored exactly as the file was reached from the directories passed to nn_cache_build ("./Downscaled/a.png"),
+// so a program can look images up with the same strings it used to build paths for stbi_load. Images inside a directory
+// whose name is a number (MNIST/train/5/...) get that number as their label, all others get -1.
+//
+// Files with identical contents ("aegypti29b - Copy.png") are detected by content hash. Only the first copy (shortest name)
+// keeps pixels; the others stay in the index marked NN_CACHE_DUP and share its pixels, so lookups by name still work while
+// iteration that skips duplicates sees every image once.
+//
+// nn_cache_build is incremental: a file whose size and modification time match the old cache entry is not read or decoded
+// again, its pixels are copied from the old mapping. If nothing changed the cache file is left alone.
+//
+//   #define STB_IMAGE_IMPLEMENTATION
+//   #include "stb_image.h"
+//   #define NN_IMPLEMENTATION
+//   #include "nn.h"
+//   #define NN_IO_IMPLEMENTATION
+//   #include "nn_io.h"
+//   #define NN_CACHE_IMPLEMENTATION
+//   #include "nn_cache.h"
+
+#define NN_CACHE_MAGIC "NNIC"
+#define NN_CACHE_VERSION 1u
+#define NN_CACHE_PATH_MAX 192
+
+#define NN_CACHE_DUP 1u // same contents as an earlier entry; pixels are shared with it
+#define NN_CACHE_BAD 2u // could not be decoded; no pixels
+
+typedef struct
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t endian;
+    uint32_t count;
+    uint64_t entries_offset;
+    uint64_t file_size;
+    uint8_t pad[32];
+} nn_cache_header;
+
+typedef struct
+{
+    char path[NN_CACHE_PATH_MAX]; // NUL terminated
+    uint64_t hash; // FNV-1a of the encoded file
+    uint64_t file_size; // of the encoded file, with mtime used to detect changes
+    int64_t mtime;
+    uint64_t offset; // of the pixels, from the start of the cache file
+    uint32_t w, h;
+    int32_t label;
+    uint32_t flags;
+    uint8_t pad[16];
+} nn_cache_entry;
+
+typedef struct
+{
+    nn_mapping map;
+    const nn_cache_entry *entries;
+    int count;
+} nn_cache;
+
+int nn_cache_build(const char *path, const char **dirs, int dir_count);
+int nn_cache_open(const char *path, nn_cache *c);
+void nn_cache_close(nn_cache *c);
+int nn_cache_find(nn_cache c, const char *path);
+const uint8_t *nn_cache_pixels(nn_cache c, int i);
+
+#endif // NN_CACHE_H
+
+#ifdef NN_CACHE_IMPLEMENTATION
+
+#include <ctype.h>
+#include <dirent.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+typedef struct
+{
+    nn_cache_entry e;
+    const uint8_t *pixels; // into the old mapping (reused) or owned (freshly decoded)
+    int owned;
+} nn_cache__item;
+
+typedef struct
+{
+    nn_cache__item *items;
+    int count, cap;
+} nn_cache__list;
+
+static void nn_cache__push(nn_cache__list *l, const char *path, struct stat *st)
+{
+    if (l->count == l->cap)
+    {
+        l->cap = l->cap ? 2 * l->cap : 256;
+        l->items = realloc(l->items, sizeof(nn_cache__item) * l->cap);
+        NN_ASSERT(l->items != NULL);
+    }
+    nn_cache__item *it = &l->items[l->count++];
+    memset(it, 0, sizeof(*it));
+    snprintf(it->e.path, NN_CACHE_PATH_MAX, "%s", path);
+    it->e.file_size = (uint64_t)st->st_size;
+    it->e.mtime = (int64_t)st->st_mtime;
+    it->e.label = -1;
+}
+
+// Collects every .png below dir. Directory entries come back in no particular order; the list is sorted afterwards.
+static void nn_cache__walk(nn_cache__list *l, const char *dir)
+{
+    DIR *d = opendir(dir);
+    if (!d)
+    {
+        fprintf(stderr, "Could not open %s\n", dir);
+        return;
+    }
+    struct dirent *ent;
+    while ((ent = readdir(d)) != NULL)
+    {
+        if (ent->d_name[0] == '.') continue;
+        char path[1024];
+        snprintf(path, sizeof(path), "%s/%s", dir, ent->d_name);
+        struct stat st;
+        if (stat(path, &st) != 0) continue;
+        if (S_ISDIR(st.st_mode))
+            nn_cache__walk(l, path);
+        else if (strstr(ent->d_name, ".png") != NULL)
+        {
+            if (strlen(path) >= NN_CACHE_PATH_MAX)
+                fprintf(stderr, "Skipping %s (path too long for the cache)\n", path);
+            else
+                nn_cache__push(l, path, &st);
+        }
+    }
+    closedir(d);
+}
+
+static int nn_cache__by_path(const void *a, const void *b)
+{
+    return strcmp(((const nn_cache__item *)a)->e.path, ((const nn_cache__item *)b)->e.path);
+}
+
+static const nn_cache__item *nn_cache__sort_items;
+
+// Groups identical hashes together with the preferred copy (shortest name, then alphabetical) first.
+static int nn_cache__by_hash(const void *a, const void *b)
+{
+    const nn_cache_entry *x = &nn_cache__sort_items[*(const int *)a].e;
+    const nn_cache_entry *y = &nn_cache__sort_items[*(const int *)b].e;
+    if (x->hash != y->hash) return x->hash < y->hash ? -1 : 1;
+    size_t lx = strlen(x->path), ly = strlen(y->path);
+    if (lx != ly) return lx < ly ? -1 : 1;
+    return strcmp(x->path, y->path);
+}
+
+// Number of the directory the file is in, or -1 if that directory name is not a number.
+static int32_t nn_cache__label(const char *path)
+{
+    const char *end = strrchr(path, '/');
+    if (!end) return -1;
+    const char *start = end;
+    while (start > path && start[-1] != '/') start--;
+    if (start == end) return -1;
+    int32_t v = 0;
+    for (const char *p = start; p < end; p++)
+    {
+        if (!isdigit((unsigned char)*p) || v > 100000000) return -1;
+        v = v * 10 + (*p - '0');
+    }
+    return v;
+}
+
+static int nn_cache__decode(nn_cache__item *it)
+{
+    FILE *fp = fopen(it->e.path, "rb");
+    if (!fp) return 0;
+    uint8_t *buf = malloc(it->e.file_size ? it->e.file_size : 1);
+    NN_ASSERT(buf != NULL);
+    size_t n = fread(buf, 1, it->e.file_size, fp);
+    fclose(fp);
+    if (n != it->e.file_size)
+    {
+        free(buf);
+        return 0;
+    }
+    it->e.hash = nn_checksum(NN_CHECKSUM_INIT, buf, n);
+    int w, h, comp;
+    uint8_t *px = stbi_load_from_memory(buf, (int)n, &w, &h, &comp, 1);
+    free(buf);
+    if (!px)
+    {
+        fprintf(stderr, "Could not decode %s, it will be skipped\n", it->e.path);
+        it->e.flags = NN_CACHE_BAD;
+        return 1;
+    }
+    // stbi allocates with STBI_MALLOC, which may not be plain malloc; keep our own copy so freeing is uniform.
+    uint8_t *own = malloc((size_t)w * h);
+    NN_ASSERT(own != NULL);
+    memcpy(own, px, (size_t)w * h);
+    stbi_image_free(px);
+    it->e.w = (uint32_t)w;
+    it->e.h = (uint32_t)h;
+    it->pixels = own;
+    it->owned = 1;
+    return 1;
+}
+
+static int nn_cache__pad(FILE *fp, uint64_t *pos)
+{
+    static const uint8_t zeros[NN_FILE_ALIGN];
+    uint64_t pad = (NN_FILE_ALIGN - *pos % NN_FILE_ALIGN) % NN_FILE_ALIGN;
+    *pos += pad;
+    return fwrite(zeros, 1, pad, fp) == pad;
+}
+
+static int nn_cache__write(const char *path, nn_cache__list *l)
+{
+    int ok = 0;
+    FILE *fp = fopen(path, "wb");
+    if (!fp) return 0;
+
+    nn_cache_header hdr = {
+        .magic = {'N', 'N', 'I', 'C'},
+        .version = NN_CACHE_VERSION,
+        .endian = NN_FILE_ENDIAN,
+        .count = (uint32_t)l->count,
+        .entries_offset = sizeof(nn_cache_header),
+    };
+    uint64_t pos = sizeof(hdr) + sizeof(nn_cache_entry) * (uint64_t)l->count;
+    if (fseek(fp, (long)pos, SEEK_SET) != 0) goto done;
+
+    // Pixels of duplicates are resolved after their original has been placed: dups point at the entry they copy via offset = index + 1.
+    for (int i = 0; i < l->count; i++)
+    {
+        nn_cache__item *it = &l->items[i];
+        if (it->e.flags & (NN_CACHE_DUP | NN_CACHE_BAD)) continue;
+        if (!nn_cache__pad(fp, &pos)) goto done;
+        size_t size = (size_t)it->e.w * it->e.h;
+        if (fwrite(it->pixels, 1, size, fp) != size) goto done;
+        it->e.offset = pos;
+        pos += size;
+    }
+    for (int i = 0; i < l->count; i++)
+    {
+        nn_cache__item *it = &l->items[i];
+        if (it->e.flags & NN_CACHE_DUP) it->e.offset = l->items[it->e.offset - 1].e.offset;
+    }
+    hdr.file_size = pos;
+
+    if (fseek(fp, 0, SEEK_SET) != 0 || fwrite(&hdr, sizeof(hdr), 1, fp) != 1) goto done;
+    ok = 1;
+    for (int i = 0; ok && i < l->count; i++)
+        ok = fwrite(&l->items[i].e, sizeof(nn_cache_entry), 1, fp) == 1;
+
+done:
+    if (fclose(fp) != 0) ok = 0;
+    if (!ok) remove(path);
+    return ok;
+}
+
+// Builds or refreshes the cache at path from every .png below the given directories.
+// Returns 1 if the cache is up to date afterwards (rebuilt or unchanged), 0 on failure.
+int nn_cache_build(const char *path, const char **dirs, int dir_count)
+{
+    nn_cache__list l = {0};
+    for (int i = 0; i < dir_count; i++)
+        nn_cache__walk(&l, dirs[i]);
+    if (l.count > 1) qsort(l.items, l.count, sizeof(nn_cache__item), nn_cache__by_path);
+
+    nn_cache old = {0};
+    int have_old = 0;
+    FILE *probe = fopen(path, "rb");
+    if (probe)
+    {
+        fclose(probe);
+        have_old = nn_cache_open(path, &old);
+    }
+
+    int decoded = 0, ok = 1;
+    int changed = !have_old || old.count != l.count;
+    for (int i = 0; i < l.count; i++)
+    {
+        nn_cache__item *it = &l.items[i];
+        it->e.label = nn_cache__label(it->e.path);
+        int j = have_old ? nn_cache_find(old, it->e.path) : -1;
+        if (j >= 0 && old.entries[j].file_size == it->e.file_size && old.entries[j].mtime == it->e.mtime)
+        {
+            nn_cache_entry prev = old.entries[j];
+            it->e.hash = prev.hash;
+            it->e.w = prev.w;
+            it->e.h = prev.h;
+            it->e.flags = prev.flags & NN_CACHE_BAD;
+            if (!(prev.flags & NN_CACHE_BAD)) it->pixels = (const uint8_t *)old.map.data + prev.offset;
+            continue;
+        }
+        changed = 1;
+        if (!nn_cache__decode(it))
+        {
+            fprintf(stderr, "Could not read %s\n", it->e.path);
+            ok = 0;
+            goto done;
+        }
+        decoded++;
+    }
+
+    if (!changed)
+        goto done;
+
+    // Mark duplicates: within a run of equal hashes, entries whose pixels match the first one share them.
+    int *order = malloc(sizeof(int) * (l.count ? l.count : 1));
+    NN_ASSERT(order != NULL);
+    for (int i = 0; i < l.count; i++) order[i] = i;
+    nn_cache__sort_items = l.items;
+    if (l.count > 1) qsort(order, l.count, sizeof(int), nn_cache__by_hash);
+    int dups = 0;
+    for (int k = 0; k < l.count;)
+    {
+        int first = order[k++];
+        nn_cache_entry *a = &l.items[first].e;
+        while (k < l.count && l.items[order[k]].e.hash == a->hash)
+        {
+            nn_cache__item *b = &l.items[order[k++]];
+            if (!(a->flags | b->e.flags) && a->w == b->e.w && a->h == b->e.h
+                && memcmp(l.items[first].pixels, b->pixels, (size_t)a->w * a->h) == 0)
+            {
+                b->e.flags = NN_CACHE_DUP;
+                b->e.offset = (uint64_t)first + 1;
+                dups++;
+            }
+        }
+    }
+    free(order);
+
+    char tmp[1024];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    ok = nn_cache__write(tmp, &l);
+    // The old mapping has to go before the file can be replaced (Windows refuses to replace a mapped file).
+    if (have_old)
+    {
+        nn_cache_close(&old);
+        have_old = 0;
+    }
+    if (ok)
+    {
+#ifdef _WIN32
+        ok = MoveFileExA(tmp, path, MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+        ok = rename(tmp, path) == 0;
+#endif
+        if (!ok) remove(tmp);
+    }
+    if (ok)
+        printf("%s: %d images (%d decoded, %d duplicates)\n", path, l.count, decoded, dups);
+    else
+        fprintf(stderr, "Could not write %s\n", path);
+
+done:
+    if (have_old) nn_cache_close(&old);
+    for (int i = 0; i < l.count; i++)
+        if (l.items[i].owned) free((void *)l.items[i].pixels);
+    free(l.items);
+    return ok;
+}
+
+// Maps a cache file. Entry bounds are checked here once so lookups can trust them.
+int nn_cache_open(const char *path, nn_cache *c)
+{
+    memset(c, 0, sizeof(*c));
+    if (!nn_map_file(path, &c->map))
+    {
+        fprintf(stderr, "%s: cannot map image cache\n", path);
+        return 0;
+    }
+    const nn_cache_header *hdr = c->map.data;
+    int ok = c->map.size >= sizeof(*hdr) && memcmp(hdr->magic, NN_CACHE_MAGIC, 4) == 0 && hdr->version == NN_CACHE_VERSION
+          && hdr->endian == NN_FILE_ENDIAN && hdr->file_size == c->map.size && hdr->entries_offset % 8 == 0
+          && hdr->entries_offset + sizeof(nn_cache_entry) * (uint64_t)hdr->count <= c->map.size;
+    const nn_cache_entry *entries = ok ? (const nn_cache_entry *)((const uint8_t *)c->map.data + hdr->entries_offset) : NULL;
+    for (uint32_t i = 0; ok && i < hdr->count; i++)
+        ok = (entries[i].flags & NN_CACHE_BAD) || entries[i].offset + (uint64_t)entries[i].w * entries[i].h <= c->map.size;
+    if (!ok)
+    {
+        fprintf(stderr, "%s: not a valid image cache (rebuild it)\n", path);
+        nn_unmap_file(&c->map);
+        return 0;
+    }
+    c->entries = entries;
+    c->count = (int)hdr->count;
+    return 1;
+}
+
+void nn_cache_close(nn_cache *c)
+{
+    nn_unmap_file(&c->map);
+    memset(c, 0, sizeof(*c));
+}
+
+// Binary search by path. Returns the entry number or -1.
+int nn_cache_find(nn_cache c, const char *path)
+{
+    int lo = 0, hi = c.count - 1;
+    while (lo <= hi)
+    {
+        int mid = lo + (hi - lo) / 2;
+        int r = strncmp(path, c.entries[mid].path, NN_CACHE_PATH_MAX);
+        if (r == 0) return mid;
+        if (r < 0) hi = mid - 1;
+        else lo = mid + 1;
+    }
+    return -1;
+}
+
+// Grayscale pixels of entry i (entries[i].w * entries[i].h bytes), or NULL if it could not be decoded.
+const uint8_t *nn_cache_pixels(nn_cache c, int i)
+{
+    NN_ASSERT(i >= 0 && i < c.count);
+    if (c.entries[i].flags & NN_CACHE_BAD) return NULL;
+    return (const uint8_t *)c.map.data + c.entries[i].offset;
+}
+
+#endif // NN_CACHE_IMPLEMENTATION
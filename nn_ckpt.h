@@ -0,0 +1,254 @@
+#ifndef NN_CKPT_H
+#define NN_CKPT_H
+
+// Training checkpoints: parameters plus everything a training loop needs to pick up exactly where it stopped.
+//
+// A checkpoint file is an nn_ckpt_header (run state) followed by a regular nn_io.h model record, so the parameters are
+// checksummed and arch-checked the same way model files are. Files are always written to "<path>.tmp", flushed to disk
+// and then renamed over <path>, so a crash mid-write leaves the previous checkpoint intact and a half-written one is never loaded.
+//
+// nn_ckpt_writer does the writing on a background thread. nn_ckpt_submit publishes the parameter arena and the run state
+// together as one nn_snap version (one memcpy, no lock) and returns, so the training loop never blocks on disk. The writer
+// always writes the latest version: a checkpoint submitted while the previous one is still being written waits in the
+// snapshot, and is replaced if a newer one comes before the writer gets to it. nn_ckpt_writer_stop writes out the last
+// one if it is still waiting.
+//
+//   #define NN_IMPLEMENTATION
+//   #include "nn.h"
+//   #define NN_IO_IMPLEMENTATION
+//   #include "nn_io.h"
+//   #define NN_SNAP_IMPLEMENTATION
+//   #include "nn_snap.h"
+//   #define NN_CKPT_IMPLEMENTATION
+//   #include "nn_ckpt.h"
+//
+// Link with -lpthread.
+
+#include <pthread.h>
+
+// Where the run is. The meaning of cursor/tag/aux is up to the training program
+// (e.g. cursor = image index, tag = image name, aux[0] = cost accumulated so far).
+typedef struct
+{
+    uint64_t epoch; // next epoch (or step) to run
+    uint64_t cursor;
+    uint64_t seed; // srand seed the run was started with; rand() is only used for initialization
+    uint32_t threads; // worker count: the gradient reduction order, and so the exact result, depends on it
+    float rate; // learning rate (plain gradient descent has no other optimizer state)
+    double aux[4];
+    char tag[64];
+} nn_ckpt_state;
+
+typedef struct
+{
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    nn_snap published; // submitted checkpoints, with the nn_ckpt_state as extra
+    nn snap; // the writer thread's copy of the parameters being written
+    char path[512];
+    atomic_int idle; // the writer waits on cond for a new version
+    int quit;
+    int submitted;
+    int written;
+    int skipped; // replaced by a newer checkpoint before they were written, final after nn_ckpt_writer_stop
+} nn_ckpt_writer;
+
+int nn_ckpt_save(const char *path, nn net, nn_ckpt_state st);
+int nn_ckpt_load(const char *path, nn net, nn_ckpt_state *st);
+int nn_ckpt_writer_start(nn_ckpt_writer *w, const char *path, nn net);
+int nn_ckpt_submit(nn_ckpt_writer *w, nn net, nn_ckpt_state st);
+void nn_ckpt_writer_stop(nn_ckpt_writer *w);
+
+#endif // NN_CKPT_H
+
+#ifdef NN_CKPT_IMPLEMENTATION
+
+#include <string.h>
+
+#ifdef _WIN32
+#include <io.h>
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+#define NN_CKPT_MAGIC "NNCK"
+#define NN_CKPT_VERSION 1u
+
+typedef struct
+{
+    char magic[4];
+    uint32_t version;
+    nn_ckpt_state state;
+    uint64_t checksum; // of magic, version and state
+} nn_ckpt_header;
+
+static uint64_t nn_ckpt__state_sum(const nn_ckpt_header *hdr)
+{
+    return nn_checksum(NN_CHECKSUM_INIT, hdr, offsetof(nn_ckpt_header, checksum));
+}
+
+// Makes the finished temp file durable, closes it and moves it over the real checkpoint in one step.
+static int nn_ckpt__commit(FILE *fp, const char *tmp, const char *path)
+{
+    int ok = fflush(fp) == 0;
+#ifdef _WIN32
+    ok = ok && _commit(_fileno(fp)) == 0;
+#else
+    ok = ok && fsync(fileno(fp)) == 0;
+#endif
+    if (fclose(fp) != 0) ok = 0;
+    if (!ok) return 0;
+#ifdef _WIN32
+    return MoveFileExA(tmp, path, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+    return rename(tmp, path) == 0;
+#endif
+}
+
+// Synchronous checkpoint: writes <path>.tmp and atomically renames it to <path>.
+int nn_ckpt_save(const char *path, nn net, nn_ckpt_state st)
+{
+    char tmp[520];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    nn_ckpt_header hdr = {.magic = {'N', 'N', 'C', 'K'}, .version = NN_CKPT_VERSION};
+    hdr.state = st;
+    hdr.state.tag[sizeof(hdr.state.tag) - 1] = '\0';
+    hdr.checksum = nn_ckpt__state_sum(&hdr);
+
+    FILE *fp = fopen(tmp, "wb");
+    if (!fp) return 0;
+    if (fwrite(&hdr, sizeof(hdr), 1, fp) != 1 || nn_write(fp, net) == 0)
+    {
+        fclose(fp);
+        remove(tmp);
+        return 0;
+    }
+    if (!nn_ckpt__commit(fp, tmp, path))
+    {
+        remove(tmp);
+        return 0;
+    }
+    return 1;
+}
+
+// Restores parameters and run state into an already allocated net of the same architecture.
+// Returns 0 if there is no usable checkpoint at path (missing, damaged, or for a different architecture).
+int nn_ckpt_load(const char *path, nn net, nn_ckpt_state *st)
+{
+    FILE *fp = fopen(path, "rb");
+    if (!fp) return 0;
+    nn_ckpt_header hdr;
+    if (fread(&hdr, sizeof(hdr), 1, fp) != 1 || memcmp(hdr.magic, NN_CKPT_MAGIC, 4) != 0
+        || hdr.version != NN_CKPT_VERSION || hdr.checksum != nn_ckpt__state_sum(&hdr))
+    {
+        fprintf(stderr, "%s: not a valid checkpoint\n", path);
+        fclose(fp);
+        return 0;
+    }
+
+    nn saved;
+    int ok = nn_read(fp, path, &saved);
+    fclose(fp);
+    if (!ok) return 0;
+
+    ok = saved.count == net.count && saved.param_count == net.param_count;
+    for (int l = 0; ok && l < net.count; l++)
+        ok = saved.w[l].rows == net.w[l].rows && saved.w[l].cols == net.w[l].cols;
+    if (ok)
+    {
+        memcpy(net.params, saved.params, sizeof(float) * net.param_count);
+        *st = hdr.state;
+    }
+    else
+        fprintf(stderr, "%s: checkpoint is for a different architecture\n", path);
+    nn_free(saved);
+    return ok;
+}
+
+static void *nn_ckpt__thread(void *arg)
+{
+    nn_ckpt_writer *w = arg;
+    uint64_t seen = 0;
+    for (;;)
+    {
+        pthread_mutex_lock(&w->lock);
+        atomic_store(&w->idle, 1);
+        atomic_thread_fence(memory_order_seq_cst); // see nn_ckpt_submit
+        while (nn_snap_version(&w->published) == seen && !w->quit)
+            pthread_cond_wait(&w->cond, &w->lock);
+        atomic_store(&w->idle, 0);
+        pthread_mutex_unlock(&w->lock);
+        if (nn_snap_version(&w->published) == seen) break;
+
+        nn_ckpt_state st;
+        seen = nn_snap_read(&w->published, w->snap, &st);
+        if (!nn_ckpt_save(w->path, w->snap, st))
+            fprintf(stderr, "Could not write checkpoint %s\n", w->path);
+        w->written++;
+    }
+    return NULL;
+}
+
+int nn_ckpt_writer_start(nn_ckpt_writer *w, const char *path, nn net)
+{
+    memset(w, 0, sizeof(*w));
+    snprintf(w->path, sizeof(w->path), "%s", path);
+
+    int *arch = malloc(sizeof(int) * (net.count + 1));
+    NN_ASSERT(arch != NULL);
+    arch[0] = NN_INPUT_MAT(net).cols;
+    for (int l = 0; l < net.count; l++)
+        arch[l + 1] = net.w[l].cols;
+    w->snap = nn_alloc(arch, net.count + 1);
+    free(arch);
+    nn_snap_init(&w->published, net, sizeof(nn_ckpt_state));
+    atomic_init(&w->idle, 0);
+
+    pthread_mutex_init(&w->lock, NULL);
+    pthread_cond_init(&w->cond, NULL);
+    if (pthread_create(&w->thread, NULL, nn_ckpt__thread, w) != 0)
+    {
+        pthread_mutex_destroy(&w->lock);
+        pthread_cond_destroy(&w->cond);
+        nn_snap_free(&w->published);
+        nn_free(w->snap);
+        return 0;
+    }
+    return 1;
+}
+
+// Hands a snapshot of net and st to the writer thread. Never waits for I/O. Always returns 1: a checkpoint that is still
+// waiting when the next one is submitted is superseded by it, not lost.
+int nn_ckpt_submit(nn_ckpt_writer *w, nn net, nn_ckpt_state st)
+{
+    w->submitted++;
+    nn_snap_publish(&w->published, net, &st);
+    // Either the writer sees the new version before it goes to sleep, or this sees it idle and wakes it
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&w->idle, memory_order_relaxed))
+    {
+        pthread_mutex_lock(&w->lock);
+        pthread_cond_signal(&w->cond);
+        pthread_mutex_unlock(&w->lock);
+    }
+    return 1;
+}
+
+// Writes out the latest checkpoint if it is still waiting and stops the thread.
+void nn_ckpt_writer_stop(nn_ckpt_writer *w)
+{
+    pthread_mutex_lock(&w->lock);
+    w->quit = 1;
+    pthread_cond_signal(&w->cond);
+    pthread_mutex_unlock(&w->lock);
+    pthread_join(w->thread, NULL);
+    pthread_mutex_destroy(&w->lock);
+    pthread_cond_destroy(&w->cond);
+    w->skipped = w->submitted - w->written;
+    nn_snap_free(&w->published);
+    nn_free(w->snap);
+}
+
+#endif // NN_CKPT_IMPLEMENTATION
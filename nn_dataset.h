@@ -0,0 +1,433 @@
+#ifndef NN_DATASET_H
+#define NN_DATASET_H
+
+// Labelled image datasets for classifiers: one contiguous uint8 tensor of images plus a label per image,
+// and a batch iterator that turns them into float mats for nn.h.
+//
+// nn_dataset_load_dirs reads a class-per-directory tree (MNIST/train/<digit>/*.png). The class folders are scanned and the
+// files decoded in parallel (OpenMP), each straight into its slot of the tensor. Every image must have the size of the first
+// one; others are skipped with a warning.
+//
+// nn_dataset_load_idx maps a pair of IDX files (train-images-idx3-ubyte / train-labels-idx1-ubyte) instead. Nothing is
+// decoded or copied: images and labels point into the mappings, and nn_dataset_images gives the pixels as a mat_u8 view.
+//
+// nn_batcher hands out shuffled, stratified batches: every batch holds the classes in (very nearly) the same proportions as the
+// whole dataset. Only one batch is ever converted to float, so memory stays at count*w*h bytes plus two batch-sized mats.
+// The batcher only looks at nn_dataset, so it works the same whichever loader filled it.
+//
+//   #define STB_IMAGE_IMPLEMENTATION
+//   #include "stb_image.h"
+//   #define NN_IMPLEMENTATION
+//   #include "nn.h"
+//   #define NN_IO_IMPLEMENTATION
+//   #include "nn_io.h"
+//   #define NN_DATASET_IMPLEMENTATION
+//   #include "nn_dataset.h"
+
+#include <stdint.h>
+
+typedef struct
+{
+    int count; // images
+    int w, h; // size of every image; an image is w*h bytes, row-major
+    int classes; // labels are 0..classes-1
+    const uint8_t *images; // count*w*h bytes
+    const uint8_t *labels; // count bytes
+    void *owned[2]; // heap blocks behind images/labels (directory loader)
+    nn_mapping maps[2]; // file mappings behind images/labels (IDX loader)
+} nn_dataset;
+
+typedef struct
+{
+    const nn_dataset *ds;
+    int batch; // rows per batch
+    int *order; // sample order of the current epoch
+    int pos; // next position in order
+    int epoch;
+    uint64_t rng;
+    mat in; // batch x (w*h), pixels scaled to 0..1
+    mat out; // batch x classes, one-hot
+} nn_batcher;
+
+int nn_dataset_load_dirs(const char *root, nn_dataset *ds);
+int nn_dataset_load_idx(const char *images_path, const char *labels_path, nn_dataset *ds);
+void nn_dataset_free(nn_dataset *ds);
+mat_u8 nn_dataset_images(const nn_dataset *ds);
+
+void nn_batcher_init(nn_batcher *b, const nn_dataset *ds, int batch, uint64_t seed);
+int nn_batcher_next(nn_batcher *b, mat *in, mat *out);
+void nn_batcher_free(nn_batcher *b);
+
+#endif // NN_DATASET_H
+
+#ifdef NN_DATASET_IMPLEMENTATION
+
+#include <ctype.h>
+#include <dirent.h>
+#include <string.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#define NN_DATASET_MAX_CLASSES 256
+
+typedef struct
+{
+    char **paths;
+    int count;
+} nn_dataset__files;
+
+static int nn_dataset__cmp_paths(const void *a, const void *b)
+{
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+// Sorted .png paths in dir, so the tensor layout does not depend on directory order.
+static nn_dataset__files nn_dataset__list(const char *dir)
+{
+    nn_dataset__files f = {0};
+    DIR *d = opendir(dir);
+    if (!d) return f;
+    int cap = 0;
+    struct dirent *ent;
+    while ((ent = readdir(d)) != NULL)
+    {
+        if (strstr(ent->d_name, ".png") == NULL) continue;
+        if (f.count == cap)
+        {
+            cap = cap ? 2 * cap : 256;
+            f.paths = realloc(f.paths, sizeof(char *) * cap);
+            NN_ASSERT(f.paths != NULL);
+        }
+        size_t len = strlen(dir) + strlen(ent->d_name) + 2;
+        f.paths[f.count] = malloc(len);
+        NN_ASSERT(f.paths[f.count] != NULL);
+        snprintf(f.paths[f.count++], len, "%s/%s", dir, ent->d_name);
+    }
+    closedir(d);
+    if (f.count > 1) qsort(f.paths, f.count, sizeof(char *), nn_dataset__cmp_paths);
+    return f;
+}
+
+// Class number of a folder name, or -1. Only the canonical spelling counts ("5", not "05"): the folder is opened again
+// by printing the number, and aliases would list one class twice.
+static int nn_dataset__class_of(const char *name)
+{
+    if (!*name) return -1;
+    if (name[0] == '0' && name[1] != '\0') return -1;
+    int v = 0;
+    for (const char *p = name; *p; p++)
+    {
+        if (!isdigit((unsigned char)*p)) return -1;
+        v = v * 10 + (*p - '0');
+        if (v >= NN_DATASET_MAX_CLASSES) return -1;
+    }
+    return v;
+}
+
+// Loads every root/<class>/*.png, where <class> is a number below 256 and becomes the label.
+// Returns 0 if no image could be loaded.
+int nn_dataset_load_dirs(const char *root, nn_dataset *ds)
+{
+    memset(ds, 0, sizeof(*ds));
+    int present[NN_DATASET_MAX_CLASSES];
+    unsigned char seen[NN_DATASET_MAX_CLASSES] = {0};
+    int class_count = 0;
+    DIR *d = opendir(root);
+    if (!d)
+    {
+        fprintf(stderr, "Could not open %s\n", root);
+        return 0;
+    }
+    struct dirent *ent;
+    while ((ent = readdir(d)) != NULL)
+    {
+        int c = nn_dataset__class_of(ent->d_name);
+        if (c < 0 || seen[c]) continue;
+        seen[c] = 1;
+        present[class_count++] = c;
+    }
+    closedir(d);
+
+    // Scan the class folders in parallel, then lay the classes out in label order.
+    nn_dataset__files files[NN_DATASET_MAX_CLASSES] = {0};
+#pragma omp parallel for schedule(dynamic)
+    for (int i = 0; i < class_count; i++)
+    {
+        char dir[1024];
+        snprintf(dir, sizeof(dir), "%s/%d", root, present[i]);
+        files[present[i]] = nn_dataset__list(dir);
+    }
+
+    int total = 0;
+    for (int c = 0; c < NN_DATASET_MAX_CLASSES; c++)
+        total += files[c].count;
+    char **paths = malloc(sizeof(char *) * (total ? total : 1));
+    uint8_t *labels = malloc(total ? total : 1);
+    NN_ASSERT(paths != NULL && labels != NULL);
+    int n = 0;
+    for (int c = 0; c < NN_DATASET_MAX_CLASSES; c++)
+    {
+        for (int i = 0; i < files[c].count; i++)
+        {
+            paths[n] = files[c].paths[i];
+            labels[n++] = (uint8_t)c;
+            if (c + 1 > ds->classes) ds->classes = c + 1;
+        }
+        free(files[c].paths);
+    }
+
+    // The first decodable image fixes the size, so the tensor can be allocated before the parallel decode.
+    int w = 0, h = 0, comp;
+    for (int i = 0; i < total && w == 0; i++)
+        if (!stbi_info(paths[i], &w, &h, &comp)) w = 0;
+    uint8_t *ok = calloc(total ? total : 1, 1);
+    uint8_t *images = w > 0 ? malloc((size_t)total * w * h) : NULL;
+    NN_ASSERT(ok != NULL);
+    if (w > 0) NN_ASSERT(images != NULL);
+
+    size_t size = (size_t)w * h;
+#pragma omp parallel for schedule(dynamic, 32)
+    for (int i = 0; i < (w > 0 ? total : 0); i++)
+    {
+        int iw, ih, ic;
+        uint8_t *px = stbi_load(paths[i], &iw, &ih, &ic, 1);
+        if (!px)
+            fprintf(stderr, "Skipping %s (load error)\n", paths[i]);
+        else if (iw != w || ih != h)
+            fprintf(stderr, "Skipping %s (%dx%d, expected %dx%d)\n", paths[i], iw, ih, w, h);
+        else
+        {
+            memcpy(images + (size_t)i * size, px, size);
+            ok[i] = 1;
+        }
+        stbi_image_free(px);
+    }
+
+    // Close the gaps left by skipped files.
+    for (int i = 0; i < total; i++)
+    {
+        if (ok[i])
+        {
+            if (ds->count != i) memmove(images + (size_t)ds->count * size, images + (size_t)i * size, size);
+            labels[ds->count++] = labels[i];
+        }
+        free(paths[i]);
+    }
+    free(paths);
+    free(ok);
+
+    ds->w = w;
+    ds->h = h;
+    ds->images = ds->owned[0] = images;
+    ds->labels = ds->owned[1] = labels;
+    if (ds->count == 0)
+    {
+        fprintf(stderr, "No images found under %s\n", root);
+        nn_dataset_free(ds);
+        return 0;
+    }
+    return 1;
+}
+
+static uint32_t nn_dataset__be32(const uint8_t *p)
+{
+    return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+}
+
+// Maps an IDX file and checks its header: magic 0x00 0x00 0x08 (unsigned byte) <dims>, then dims big-endian uint32 sizes.
+static const uint8_t *nn_dataset__map_idx(const char *path, nn_mapping *m, int dims, uint32_t *sizes)
+{
+    if (!nn_map_file(path, m))
+    {
+        fprintf(stderr, "Could not map %s\n", path);
+        return NULL;
+    }
+    const uint8_t *p = m->data;
+    size_t header = 4 + 4 * (size_t)dims;
+    uint64_t n = 1;
+    int ok = m->size >= header && p[0] == 0 && p[1] == 0 && p[2] == 0x08 && p[3] == dims;
+    for (int i = 0; ok && i < dims; i++)
+    {
+        sizes[i] = nn_dataset__be32(p + 4 + 4 * i);
+        // Checked before multiplying, so a crafted header cannot wrap n into a size that fits the file.
+        ok = sizes[i] != 0 && n <= (m->size - header) / sizes[i];
+        n *= sizes[i];
+    }
+    if (!ok || m->size < header + n)
+    {
+        fprintf(stderr, "%s: not an unsigned byte IDX file with %d dimensions\n", path, dims);
+        nn_unmap_file(m);
+        return NULL;
+    }
+    return p + header;
+}
+
+// Maps an IDX image file (count x rows x cols) and its label file. Images and labels stay in the page cache, shared and
+// read-only; the dataset only keeps pointers into the mappings.
+int nn_dataset_load_idx(const char *images_path, const char *labels_path, nn_dataset *ds)
+{
+    memset(ds, 0, sizeof(*ds));
+    uint32_t isz[3], lsz[1];
+    const uint8_t *images = nn_dataset__map_idx(images_path, &ds->maps[0], 3, isz);
+    const uint8_t *labels = images ? nn_dataset__map_idx(labels_path, &ds->maps[1], 1, lsz) : NULL;
+    if (!labels)
+    {
+        nn_dataset_free(ds);
+        return 0;
+    }
+    if (isz[0] != lsz[0] || isz[0] > INT32_MAX)
+    {
+        fprintf(stderr, "%s has %u images but %s has %u labels\n", images_path, isz[0], labels_path, lsz[0]);
+        nn_dataset_free(ds);
+        return 0;
+    }
+    if ((uint64_t)isz[1] * isz[2] > INT32_MAX)
+    {
+        fprintf(stderr, "%s: images of %ux%u are too large\n", images_path, isz[2], isz[1]);
+        nn_dataset_free(ds);
+        return 0;
+    }
+    ds->count = (int)isz[0];
+    ds->h = (int)isz[1];
+    ds->w = (int)isz[2];
+    ds->images = images;
+    ds->labels = labels;
+    for (int i = 0; i < ds->count; i++)
+        if (labels[i] + 1 > ds->classes) ds->classes = labels[i] + 1;
+    return 1;
+}
+
+void nn_dataset_free(nn_dataset *ds)
+{
+    free(ds->owned[0]);
+    free(ds->owned[1]);
+    nn_unmap_file(&ds->maps[0]);
+    nn_unmap_file(&ds->maps[1]);
+    memset(ds, 0, sizeof(*ds));
+}
+
+// All images as a count x (w*h) matrix of bytes, without copying. Use mat_from_u8 (scale 1/255) to get normalized floats.
+mat_u8 nn_dataset_images(const nn_dataset *ds)
+{
+    int size = ds->w * ds->h;
+    return (mat_u8){.rows = ds->count, .cols = size, .stride = size, .data = ds->images};
+}
+
+// splitmix64: the batcher has its own generator so shuffling neither depends on nor disturbs rand().
+static uint64_t nn_batcher__rand(uint64_t *s)
+{
+    uint64_t z = (*s += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+typedef struct
+{
+    double key;
+    int index;
+} nn_batcher__slot;
+
+static int nn_batcher__cmp(const void *a, const void *b)
+{
+    double x = ((const nn_batcher__slot *)a)->key, y = ((const nn_batcher__slot *)b)->key;
+    return (x > y) - (x < y);
+}
+
+// New epoch order. Each class is shuffled on its own, and the k-th of its n samples gets the key (k + u)/n, u in [0,1).
+// Sorting all samples by key spreads every class evenly over the epoch, so any run of consecutive samples is stratified.
+static void nn_batcher__shuffle(nn_batcher *b)
+{
+    const nn_dataset *ds = b->ds;
+    int start[NN_DATASET_MAX_CLASSES + 1] = {0};
+    for (int i = 0; i < ds->count; i++)
+        start[ds->labels[i] + 1]++;
+    for (int c = 0; c < NN_DATASET_MAX_CLASSES; c++)
+        start[c + 1] += start[c];
+
+    // Group sample indices by class (order doubles as the buffer), then Fisher-Yates each group.
+    int fill[NN_DATASET_MAX_CLASSES];
+    memcpy(fill, start, sizeof(fill));
+    for (int i = 0; i < ds->count; i++)
+        b->order[fill[ds->labels[i]]++] = i;
+
+    nn_batcher__slot *slots = malloc(sizeof(*slots) * ds->count);
+    NN_ASSERT(slots != NULL);
+    for (int c = 0; c < NN_DATASET_MAX_CLASSES; c++)
+    {
+        int *g = b->order + start[c];
+        int n = start[c + 1] - start[c];
+        for (int k = n - 1; k > 0; k--)
+        {
+            int r = (int)(nn_batcher__rand(&b->rng) % (uint64_t)(k + 1));
+            int t = g[k];
+            g[k] = g[r];
+            g[r] = t;
+        }
+        for (int k = 0; k < n; k++)
+        {
+            double u = (double)(nn_batcher__rand(&b->rng) >> 11) / 9007199254740992.0;
+            slots[start[c] + k] = (nn_batcher__slot){.key = (k + u) / n, .index = g[k]};
+        }
+    }
+    qsort(slots, ds->count, sizeof(*slots), nn_batcher__cmp);
+    for (int i = 0; i < ds->count; i++)
+        b->order[i] = slots[i].index;
+    free(slots);
+}
+
+void nn_batcher_init(nn_batcher *b, const nn_dataset *ds, int batch, uint64_t seed)
+{
+    NN_ASSERT(batch > 0 && ds->count > 0);
+    memset(b, 0, sizeof(*b));
+    b->ds = ds;
+    b->batch = batch;
+    b->rng = seed;
+    b->order = malloc(sizeof(int) * ds->count);
+    NN_ASSERT(b->order != NULL);
+    b->in = mat_alloc(batch, ds->w * ds->h);
+    b->out = mat_alloc(batch, ds->classes);
+    nn_batcher__shuffle(b);
+}
+
+// Converts the next batch into *in / *out (views of the batcher's buffers, valid until the next call) and returns its row count.
+// The last batch of an epoch may be short. Returns 0 once at the end of every epoch; the next call starts a freshly shuffled one.
+int nn_batcher_next(nn_batcher *b, mat *in, mat *out)
+{
+    const nn_dataset *ds = b->ds;
+    if (b->pos >= ds->count)
+    {
+        b->pos = 0;
+        b->epoch++;
+        nn_batcher__shuffle(b);
+        return 0;
+    }
+    int n = ds->count - b->pos < b->batch ? ds->count - b->pos : b->batch;
+    mat_u8 images = nn_dataset_images(ds);
+    for (int r = 0; r < n; r++)
+    {
+        int s = b->order[b->pos + r];
+        mat_u8 row = {.rows = 1, .cols = images.cols, .stride = images.stride, .data = &MAT_U8_AT(images, s, 0)};
+        mat_from_u8(mat_getRow(b->in, r), row, 1.0f / 255.0f);
+        float *hot = &MAT_AT(b->out, r, 0);
+        for (int j = 0; j < ds->classes; j++)
+            hot[j] = 0.0f;
+        hot[ds->labels[s]] = 1.0f;
+    }
+    b->pos += n;
+    *in = (mat){.rows = n, .cols = b->in.cols, .stride = b->in.stride, .data = b->in.data};
+    *out = (mat){.rows = n, .cols = b->out.cols, .stride = b->out.stride, .data = b->out.data};
+    return n;
+}
+
+void nn_batcher_free(nn_batcher *b)
+{
+    free(b->order);
+    free(b->in.data);
+    free(b->out.data);
+    memset(b, 0, sizeof(*b));
+}
+
+#endif // NN_DATASET_IMPLEMENTATION
@@ -0,0 +1,272 @@
+#ifndef NN_DIAGRAM_H
+#define NN_DIAGRAM_H
+
+// Cached network diagram for the visualizers: the layout and the rasterized connection lines are computed once, after that
+// a frame only repaints the connections whose color changed.
+//
+// Every connection is drawn once into an owner map (with olivec_line, so the pixels are exactly the ones it would draw),
+// which leaves for each connection the list of pixels where it ends up on top of all the others. The diagram keeps a
+// layer with the background and all connections in it; nn_diagram_draw compares the colors the caller put in
+// edge_colors with the ones in the layer and rewrites only the pixels of the connections that differ, in the layer and
+// in the canvas. A frame therefore costs in proportion to the connections that changed color, not to the canvas size
+// times the number of connections. Colors with alpha below 255 cannot be drawn from the lists (the result depends on
+// what is underneath), for those the connections are drawn again in order.
+//
+// Connections are always at the bottom. Whatever the caller draws over them (neurons, previews, legends) has to be
+// drawn again every frame, since a changed connection is repainted in the canvas below it; things that are blended
+// rather than copied need nn_diagram_restore on their area first, and all restores have to come before the drawing.
+//
+//   nn_diagram d;
+//   nn_diagram_init(&d, canvas.width, canvas.height, arch, arch_count, BACKGROUND);
+//   // every frame:
+//   d.edge_colors[nn_diagram_edge(&d, l, i, j)] = color_of(w[l][i][j]);   // for every connection
+//   nn_diagram_draw(&d, canvas);
+//   nn_diagram_restore_neurons(&d, canvas, radius);
+//   ... draw the neurons and the rest
+//
+// Include olive.c before this header.
+//
+//   #define NN_DIAGRAM_IMPLEMENTATION
+//   #include "nn_diagram.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct
+{
+    size_t width, height;
+    int layer_count;
+    int *layer_start; // first neuron of each layer, layer_count + 1 entries
+    int *neuron_x; // neuron centers, layer after layer
+    int *neuron_y;
+    int edge_count;
+    int *edge_start; // first connection leaving each layer
+    int *edges; // x1, y1, x2, y2 of every connection, in drawing order
+    uint32_t *edge_colors; // set by the caller before nn_diagram_draw
+    uint32_t *drawn; // color each connection has in the layer
+    uint32_t *owned_start; // edge_count + 1 offsets into owned
+    uint32_t *owned; // (y << 16) | x of the pixels where each connection is on top
+    uint32_t *layer; // background and connections, width*height
+    uint32_t background;
+    int layer_valid; // layer matches drawn
+    const uint32_t *shown; // canvas pixels that hold a copy of the layer under the overlays, NULL if none
+    size_t shown_stride;
+} nn_diagram;
+
+void nn_diagram_init(nn_diagram *d, size_t width, size_t height, const int *arch, int arch_count, uint32_t background);
+void nn_diagram_free(nn_diagram *d);
+int nn_diagram_draw(nn_diagram *d, Olivec_Canvas oc);
+void nn_diagram_restore(const nn_diagram *d, Olivec_Canvas oc, int x, int y, int w, int h);
+void nn_diagram_restore_neurons(const nn_diagram *d, Olivec_Canvas oc, int radius);
+
+// Index of the connection from neuron `from` of layer l to neuron `to` of layer l + 1.
+static inline int nn_diagram_edge(const nn_diagram *d, int l, int from, int to)
+{
+    int next = d->layer_start[l + 2] - d->layer_start[l + 1];
+    return d->edge_start[l] + from * next + to;
+}
+
+#endif // NN_DIAGRAM_H
+
+#ifdef NN_DIAGRAM_IMPLEMENTATION
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef NN_ASSERT
+#include <assert.h>
+#define NN_ASSERT assert
+#endif
+
+// Lays out the neurons like the visualizers always did (50 pixel margins, layers in equal columns, neurons spread evenly
+// down each column) and rasterizes the connections into the owner lists.
+void nn_diagram_init(nn_diagram *d, size_t width, size_t height, const int *arch, int arch_count, uint32_t background)
+{
+    NN_ASSERT(arch_count > 0);
+    NN_ASSERT(width <= 0x10000 && height <= 0x10000);
+    memset(d, 0, sizeof(*d));
+    d->width = width;
+    d->height = height;
+    d->layer_count = arch_count;
+    d->background = background;
+
+    d->layer_start = malloc(sizeof(int) * (arch_count + 1));
+    d->edge_start = malloc(sizeof(int) * arch_count);
+    NN_ASSERT(d->layer_start != NULL && d->edge_start != NULL);
+    d->layer_start[0] = 0;
+    for (int l = 0; l < arch_count; ++l) {
+        d->layer_start[l + 1] = d->layer_start[l] + arch[l];
+        d->edge_start[l] = d->edge_count;
+        if (l + 1 < arch_count) d->edge_count += arch[l] * arch[l + 1];
+    }
+    NN_ASSERT(d->edge_count < 0xFFFFFF);
+
+    int neuron_count = d->layer_start[arch_count];
+    d->neuron_x = malloc(sizeof(int) * neuron_count);
+    d->neuron_y = malloc(sizeof(int) * neuron_count);
+    NN_ASSERT(d->neuron_x != NULL && d->neuron_y != NULL);
+    int layer_bvpad = 50;
+    int layer_bhpad = 50;
+    int net_width = (int)width - layer_bhpad * 2;
+    int net_height = (int)height - 2 * layer_bvpad;
+    int layer_hpad = net_width / arch_count;
+    int net_x = (int)width / 2 - net_width / 2;
+    int net_y = (int)height / 2 - net_height / 2;
+    for (int l = 0; l < arch_count; ++l) {
+        int layer_vpad = net_height / arch[l];
+        for (int i = 0; i < arch[l]; ++i) {
+            d->neuron_x[d->layer_start[l] + i] = net_x + l * layer_hpad + layer_hpad / 2;
+            d->neuron_y[d->layer_start[l] + i] = net_y + i * layer_vpad + layer_vpad / 2;
+        }
+    }
+
+    int edge_count = d->edge_count;
+    d->edges = malloc(sizeof(int) * 4 * (edge_count ? edge_count : 1));
+    d->edge_colors = calloc(edge_count ? edge_count : 1, sizeof(uint32_t));
+    d->drawn = calloc(edge_count ? edge_count : 1, sizeof(uint32_t));
+    d->owned_start = calloc(edge_count + 1, sizeof(uint32_t));
+    d->layer = malloc(sizeof(uint32_t) * width * height);
+    uint32_t *owner = malloc(sizeof(uint32_t) * width * height);
+    NN_ASSERT(d->edges != NULL && d->edge_colors != NULL && d->drawn != NULL && d->owned_start != NULL);
+    NN_ASSERT(d->layer != NULL && owner != NULL);
+
+    // Draw every connection with its index as the color; what is left in a pixel is the connection drawn last over it
+    Olivec_Canvas oc = olivec_canvas(owner, width, height, width);
+    Olivec_Batch batch = {0};
+    olivec_batch_fill(&batch, 0xFFFFFFFF);
+    for (int l = 0; l + 1 < arch_count; ++l) {
+        for (int i = 0; i < arch[l]; ++i) {
+            for (int j = 0; j < arch[l + 1]; ++j) {
+                int e = nn_diagram_edge(d, l, i, j);
+                int *p = &d->edges[4 * e];
+                p[0] = d->neuron_x[d->layer_start[l] + i];
+                p[1] = d->neuron_y[d->layer_start[l] + i];
+                p[2] = d->neuron_x[d->layer_start[l + 1] + j];
+                p[3] = d->neuron_y[d->layer_start[l + 1] + j];
+                olivec_batch_line(&batch, p[0], p[1], p[2], p[3], 0xFF000000 | (uint32_t)e);
+            }
+        }
+    }
+    olivec_batch_draw(oc, &batch);
+    olivec_batch_free(&batch);
+
+    size_t pixel_count = width * height;
+    for (size_t k = 0; k < pixel_count; ++k) {
+        uint32_t e = owner[k] & 0xFFFFFF;
+        if (e != 0xFFFFFF) d->owned_start[e + 1]++;
+    }
+    for (int e = 0; e < edge_count; ++e) d->owned_start[e + 1] += d->owned_start[e];
+    d->owned = malloc(sizeof(uint32_t) * (d->owned_start[edge_count] ? d->owned_start[edge_count] : 1));
+    NN_ASSERT(d->owned != NULL);
+    for (size_t y = 0; y < height; ++y) {
+        for (size_t x = 0; x < width; ++x) {
+            uint32_t e = owner[y * width + x] & 0xFFFFFF;
+            if (e != 0xFFFFFF) d->owned[d->owned_start[e]++] = (uint32_t)(y << 16 | x);
+        }
+    }
+    // The placement advanced every offset to the start of the next connection
+    for (int e = edge_count; e > 0; --e) d->owned_start[e] = d->owned_start[e - 1];
+    d->owned_start[0] = 0;
+    free(owner);
+}
+
+void nn_diagram_free(nn_diagram *d)
+{
+    free(d->layer_start);
+    free(d->neuron_x);
+    free(d->neuron_y);
+    free(d->edge_start);
+    free(d->edges);
+    free(d->edge_colors);
+    free(d->drawn);
+    free(d->owned_start);
+    free(d->owned);
+    free(d->layer);
+    memset(d, 0, sizeof(*d));
+}
+
+// Writes the pixels of connection e in its current color to `pixels` (stride in pixels).
+static void nn_diagram__paint(const nn_diagram *d, int e, uint32_t *pixels, size_t stride)
+{
+    // An opaque olivec_line keeps the alpha of the pixel, which is the background's
+    uint32_t c = (d->background & 0xFF000000) | (d->edge_colors[e] & 0x00FFFFFF);
+    for (uint32_t k = d->owned_start[e]; k < d->owned_start[e + 1]; ++k) {
+        uint32_t xy = d->owned[k];
+        pixels[(xy >> 16) * stride + (xy & 0xFFFF)] = c;
+    }
+}
+
+// Brings the connections in oc up to date with edge_colors and returns how many were repainted. After a different canvas
+// (or a translucent color) the whole layer is copied, otherwise only the changed connections are written.
+int nn_diagram_draw(nn_diagram *d, Olivec_Canvas oc)
+{
+    NN_ASSERT(oc.width == d->width && oc.height == d->height);
+    int edge_count = d->edge_count;
+    int translucent = 0;
+    for (int e = 0; e < edge_count; ++e)
+        translucent |= (d->edge_colors[e] >> 24) != 0xFF;
+
+    int repainted = 0;
+    Olivec_Canvas layer = olivec_canvas(d->layer, d->width, d->height, d->width);
+    if (translucent) {
+        // Blending depends on what is below, so draw everything in order like the plain renderer
+        olivec_fill(layer, d->background);
+        for (int e = 0; e < edge_count; ++e) {
+            const int *p = &d->edges[4 * e];
+            olivec_line(layer, p[0], p[1], p[2], p[3], d->edge_colors[e]);
+            d->drawn[e] = d->edge_colors[e];
+        }
+        repainted = edge_count;
+        d->layer_valid = 0; // the owner lists do not describe it
+        d->shown = NULL;
+    } else if (!d->layer_valid) {
+        olivec_fill(layer, d->background);
+        for (int e = 0; e < edge_count; ++e) {
+            nn_diagram__paint(d, e, d->layer, d->width);
+            d->drawn[e] = d->edge_colors[e];
+        }
+        repainted = edge_count;
+        d->layer_valid = 1;
+        d->shown = NULL;
+    }
+
+    int incremental = d->shown == oc.pixels && d->shown_stride == oc.stride;
+    if (d->layer_valid && repainted == 0) {
+        // Connections own disjoint pixels, so they can be repainted in any order and on any thread
+#pragma omp parallel for schedule(dynamic, 64) reduction(+ : repainted)
+        for (int e = 0; e < edge_count; ++e) {
+            if (d->drawn[e] == d->edge_colors[e]) continue;
+            nn_diagram__paint(d, e, d->layer, d->width);
+            if (incremental) nn_diagram__paint(d, e, oc.pixels, oc.stride);
+            d->drawn[e] = d->edge_colors[e];
+            repainted++;
+        }
+    }
+
+    if (!incremental) {
+        for (size_t y = 0; y < d->height; ++y)
+            memcpy(&OLIVEC_PIXEL(oc, 0, y), &d->layer[y * d->width], sizeof(uint32_t) * d->width);
+        d->shown = d->layer_valid ? oc.pixels : NULL;
+        d->shown_stride = oc.stride;
+    }
+    return repainted;
+}
+
+// Copies the connections under the rectangle (olivec_rect coordinates) back into oc, clearing what was drawn over them.
+void nn_diagram_restore(const nn_diagram *d, Olivec_Canvas oc, int x, int y, int w, int h)
+{
+    Olivec_Normalized_Rect nr = {0};
+    if (!olivec_normalize_rect(x, y, w, h, oc.width, oc.height, &nr)) return;
+    for (int row = nr.y1; row <= nr.y2; ++row)
+        memcpy(&OLIVEC_PIXEL(oc, nr.x1, row), &d->layer[row * d->width + nr.x1], sizeof(uint32_t) * (nr.x2 - nr.x1 + 1));
+}
+
+// Restores the area of every neuron drawn as olivec_circle(oc, x, y, radius, color).
+void nn_diagram_restore_neurons(const nn_diagram *d, Olivec_Canvas oc, int radius)
+{
+    int r1 = radius + 1;
+    for (int n = 0; n < d->layer_start[d->layer_count]; ++n)
+        nn_diagram_restore(d, oc, d->neuron_x[n] - r1, d->neuron_y[n] - r1, 2 * r1, 2 * r1);
+}
+
+#endif // NN_DIAGRAM_IMPLEMENTATION
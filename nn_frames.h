@@ -0,0 +1,156 @@
+#ifndef NN_FRAMES_H
+#define NN_FRAMES_H
+
+// Background visualization: training publishes a parameter snapshot and carries on, a separate thread renders and saves
+// the frame from that snapshot.
+//
+// nn_frames_submit publishes the parameters and the frame number to an nn_snap (one memcpy, no lock, no allocation)
+// and returns. The frame thread claims the latest version, copies it into its own net and renders it. If rendering cannot
+// keep up, a frame that was not claimed yet is replaced by the newer one rather than stalling training, so the frames
+// that are rendered are always the most recent. Claiming swaps the pending version number out of one atomic, the same
+// one submit swaps the new version into, so submit knows for certain whether the frame it replaced was ever claimed. The
+// training thread only takes the lock to wake the frame thread when it is idle, never while it is rendering.
+// The render callback runs on the frame thread only, so buffers it keeps in `user` are reused frame after frame without
+// locking.
+//
+// OpenMP regions started from the frame thread (nn_grid, nn_png_write) run on a single thread, so visualization costs
+// training at most one core. A render callback can raise that with omp_set_num_threads for a short region of its own,
+// e.g. the preview evaluation; the setting only applies to the frame thread.
+//
+//   #define NN_IMPLEMENTATION
+//   #include "nn.h"
+//   #define NN_SNAP_IMPLEMENTATION
+//   #include "nn_snap.h"
+//   #define NN_FRAMES_IMPLEMENTATION
+//   #include "nn_frames.h"
+//
+// Link with -lpthread.
+
+#include <pthread.h>
+
+// Renders frame number `frame` from `snap`, a private copy of the parameters at submit time.
+typedef void (*nn_frames_fn)(nn snap, int frame, void *user);
+
+typedef struct
+{
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    nn_snap snap; // published frames, with the frame number as extra
+    nn view; // the frame thread's copy of the frame it renders
+    _Atomic uint64_t pending; // version submitted and not claimed by the frame thread yet, 0 if none
+    atomic_int idle; // the frame thread waits on cond for a new version
+    int quit;
+    nn_frames_fn render;
+    void *user;
+    int submitted;
+    int dropped; // replaced before the frame thread got to them, final after nn_frames_stop
+    int rendered;
+} nn_frames;
+
+int nn_frames_start(nn_frames *f, nn net, nn_frames_fn render, void *user);
+int nn_frames_submit(nn_frames *f, nn net, int frame);
+void nn_frames_stop(nn_frames *f);
+
+#endif // NN_FRAMES_H
+
+#ifdef NN_FRAMES_IMPLEMENTATION
+
+#include <string.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+static void *nn_frames__thread(void *arg)
+{
+    nn_frames *f = arg;
+#ifdef _OPENMP
+    omp_set_num_threads(1);
+#endif
+    for (;;)
+    {
+        pthread_mutex_lock(&f->lock);
+        atomic_store(&f->idle, 1);
+        // Pairs with the fence in nn_frames_submit: either this sees the new version or submit sees idle and signals.
+        atomic_thread_fence(memory_order_seq_cst);
+        while (atomic_load(&f->pending) == 0 && !f->quit)
+            pthread_cond_wait(&f->cond, &f->lock);
+        atomic_store(&f->idle, 0);
+        pthread_mutex_unlock(&f->lock);
+        uint64_t claimed = atomic_exchange(&f->pending, 0);
+        if (claimed == 0) break; // quit, and everything was rendered
+
+        // Only fails if two newer frames were published during the copy; the newest of them is pending by then.
+        int frame = 0;
+        if (!nn_snap_read_version(&f->snap, claimed, f->view, &frame)) continue;
+        f->render(f->view, frame, f->user);
+        f->rendered++;
+    }
+    return NULL;
+}
+
+// Starts the frame thread. Returns 0 if the thread could not be created.
+int nn_frames_start(nn_frames *f, nn net, nn_frames_fn render, void *user)
+{
+    memset(f, 0, sizeof(*f));
+    f->render = render;
+    f->user = user;
+    nn_snap_init(&f->snap, net, sizeof(int));
+    int *arch = malloc(sizeof(int) * (net.count + 1));
+    NN_ASSERT(arch != NULL);
+    arch[0] = NN_INPUT_MAT(net).cols;
+    for (int l = 0; l < net.count; l++)
+        arch[l + 1] = net.w[l].cols;
+    f->view = nn_alloc(arch, net.count + 1);
+    free(arch);
+    atomic_init(&f->pending, 0);
+    atomic_init(&f->idle, 0);
+
+    pthread_mutex_init(&f->lock, NULL);
+    pthread_cond_init(&f->cond, NULL);
+    if (pthread_create(&f->thread, NULL, nn_frames__thread, f) != 0)
+    {
+        pthread_mutex_destroy(&f->lock);
+        pthread_cond_destroy(&f->cond);
+        nn_snap_free(&f->snap);
+        nn_free(f->view);
+        memset(f, 0, sizeof(*f));
+        return 0;
+    }
+    return 1;
+}
+
+// Publishes frame `frame` from the current parameters of net. Never waits for rendering. Returns 0 if this replaced the
+// previous frame because the frame thread had not claimed it yet; such a frame is never rendered.
+int nn_frames_submit(nn_frames *f, nn net, int frame)
+{
+    f->submitted++;
+    uint64_t v = nn_snap_publish(&f->snap, net, &frame);
+    int replaced = atomic_exchange(&f->pending, v) != 0;
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&f->idle, memory_order_relaxed))
+    {
+        pthread_mutex_lock(&f->lock);
+        pthread_cond_signal(&f->cond);
+        pthread_mutex_unlock(&f->lock);
+    }
+    return !replaced;
+}
+
+// Renders the latest frame if it is still waiting, then stops the thread.
+void nn_frames_stop(nn_frames *f)
+{
+    pthread_mutex_lock(&f->lock);
+    f->quit = 1;
+    pthread_cond_signal(&f->cond);
+    pthread_mutex_unlock(&f->lock);
+    pthread_join(f->thread, NULL);
+    pthread_mutex_destroy(&f->lock);
+    pthread_cond_destroy(&f->cond);
+    f->dropped = f->submitted - f->rendered;
+    nn_snap_free(&f->snap);
+    nn_free(f->view);
+}
+
+#endif // NN_FRAMES_IMPLEMENTATION
@@ -0,0 +1,372 @@
+#ifndef NN_GIF_H
+#define NN_GIF_H
+
+// Streaming animated GIF writer for visualization frames.
+//
+// Frames are appended as they are produced and the file is a complete, viewable GIF after every frame (the trailer is
+// rewritten each time), so the animation is finished the moment the last frame is added and a run that stops early still
+// leaves a valid file that nn_gif_open can append to.
+//
+// All frames share one fixed 256-entry palette built for the visualizations in this repo: a gray ramp, the red->green ramp,
+// the same ramp with red and blue swapped (how 0xAARRGGBB colors come out when the canvas is written as RGBA bytes), a small
+// RGB cube for everything else, and one transparent entry. Pixels are mapped through a 64x64x64 lookup table.
+// Each frame after the first only stores the rectangle that changed since the previous one, with unchanged pixels inside it
+// made transparent. The LZW codes of a rectangle are produced in row bands on OpenMP threads, each band starting from an empty
+// dictionary, and the bit streams are joined with clear codes.
+//
+//   nn_gif gif;
+//   nn_gif_open(&gif, "training.gif", 1024, 768, 10, 0);
+//   nn_gif_add_frame(&gif, canvas.pixels, canvas.stride * sizeof(uint32_t)); // RGBA bytes, as for nn_png_write
+//   nn_gif_close(&gif);
+//
+//   #define NN_GIF_IMPLEMENTATION
+//   #include "nn_gif.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stddef.h>
+
+#define NN_GIF_TRANSPARENT 255
+#define NN_GIF_BAND_PIXELS (64 * 1024) // minimum pixels per LZW band handed to a thread
+
+typedef struct
+{
+    FILE *fp;
+    int w, h;
+    int delay; // per frame, in 1/100 s
+    int frames; // frames added since open
+    int ok;
+    uint8_t palette[256 * 3];
+    uint8_t *lut; // 64*64*64 entries: (r>>2, g>>2, b>>2) -> palette index
+    uint8_t *prev; // indexed previous frame
+    uint8_t *cur;
+} nn_gif;
+
+int nn_gif_open(nn_gif *g, const char *path, int w, int h, int delay, int append);
+int nn_gif_add_frame(nn_gif *g, const uint8_t *rgba, int stride);
+int nn_gif_close(nn_gif *g);
+
+#endif // NN_GIF_H
+
+#ifdef NN_GIF_IMPLEMENTATION
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#ifndef NN_ASSERT
+#include <assert.h>
+#define NN_ASSERT assert
+#endif
+
+#define NN_GIF_HASH 8192 // LZW dictionary hash slots; the dictionary never holds more than 4096 codes
+
+static void nn_gif__palette(uint8_t *pal)
+{
+    for (int i = 0; i < 64; i++)
+    {
+        uint8_t v = (uint8_t)(i * 255 / 63);
+        uint8_t *gray = pal + 3 * i, *rg = pal + 3 * (64 + i), *bg = pal + 3 * (128 + i);
+        gray[0] = gray[1] = gray[2] = v;
+        rg[0] = (uint8_t)(255 - v), rg[1] = v, rg[2] = 0;
+        bg[0] = 0, bg[1] = v, bg[2] = (uint8_t)(255 - v);
+    }
+    for (int c = 0; c < 63; c++)
+    {
+        uint8_t *p = pal + 3 * (192 + c);
+        p[0] = (uint8_t)((c >> 4 & 3) * 85);
+        p[1] = (uint8_t)((c >> 2 & 3) * 85);
+        p[2] = (uint8_t)((c & 3) * 85);
+    }
+    pal[3 * NN_GIF_TRANSPARENT] = pal[3 * NN_GIF_TRANSPARENT + 1] = pal[3 * NN_GIF_TRANSPARENT + 2] = 0;
+}
+
+// Nearest palette entry (squared RGB distance) for the center of every 4x4x4 color cell.
+static void nn_gif__build_lut(uint8_t *lut, const uint8_t *pal)
+{
+#pragma omp parallel for schedule(static)
+    for (int cell = 0; cell < 64 * 64 * 64; cell++)
+    {
+        int r = (cell >> 12) * 4 + 2, g = (cell >> 6 & 63) * 4 + 2, b = (cell & 63) * 4 + 2;
+        int best = 0, best_d = 1 << 30;
+        for (int i = 0; i < 256; i++)
+        {
+            if (i == NN_GIF_TRANSPARENT) continue;
+            int dr = r - pal[3 * i], dg = g - pal[3 * i + 1], db = b - pal[3 * i + 2];
+            int d = dr * dr + dg * dg + db * db;
+            if (d < best_d)
+            {
+                best_d = d;
+                best = i;
+            }
+        }
+        lut[cell] = (uint8_t)best;
+    }
+}
+
+static void nn_gif__le16(uint8_t *p, int v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+// Opens path for w x h frames shown `delay` hundredths of a second each, looping forever.
+// With append = 1 an existing animation of the same size written by this encoder is continued instead of replaced.
+int nn_gif_open(nn_gif *g, const char *path, int w, int h, int delay, int append)
+{
+    memset(g, 0, sizeof(*g));
+    NN_ASSERT(w > 0 && w < 65536 && h > 0 && h < 65536);
+    g->w = w;
+    g->h = h;
+    g->delay = delay;
+    nn_gif__palette(g->palette);
+
+    uint8_t head[13 + 768];
+    memcpy(head, "GIF89a", 6);
+    nn_gif__le16(head + 6, w);
+    nn_gif__le16(head + 8, h);
+    head[10] = 0xF7; // global color table of 256 entries, 8 bits per channel
+    head[11] = 0; // background color
+    head[12] = 0; // no aspect ratio
+    memcpy(head + 13, g->palette, 768);
+
+    if (append && (g->fp = fopen(path, "r+b")) != NULL)
+    {
+        // Only continue files that start with exactly our header and end in a trailer.
+        uint8_t old[sizeof(head)];
+        int same = fread(old, 1, sizeof(old), g->fp) == sizeof(old) && memcmp(old, head, sizeof(head)) == 0
+                   && fseek(g->fp, -1, SEEK_END) == 0 && fgetc(g->fp) == 0x3B && fseek(g->fp, -1, SEEK_END) == 0;
+        if (!same)
+        {
+            fclose(g->fp);
+            g->fp = NULL;
+        }
+    }
+    if (!g->fp)
+    {
+        g->fp = fopen(path, "wb");
+        if (!g->fp)
+        {
+            fprintf(stderr, "Could not open %s for writing\n", path);
+            return 0;
+        }
+        static const uint8_t loop[19] = {0x21, 0xFF, 0x0B, 'N', 'E', 'T', 'S', 'C', 'A', 'P', 'E', '2', '.', '0', 0x03, 0x01, 0x00, 0x00, 0x00};
+        g->ok = fwrite(head, 1, sizeof(head), g->fp) == sizeof(head) && fwrite(loop, 1, sizeof(loop), g->fp) == sizeof(loop)
+                && fputc(0x3B, g->fp) != EOF && fflush(g->fp) == 0 && fseek(g->fp, -1, SEEK_END) == 0;
+    }
+    else
+        g->ok = 1;
+
+    g->lut = malloc(64 * 64 * 64);
+    g->prev = malloc((size_t)w * h);
+    g->cur = malloc((size_t)w * h);
+    if (!g->lut || !g->prev || !g->cur)
+        g->ok = 0;
+    else
+        nn_gif__build_lut(g->lut, g->palette);
+    return g->ok;
+}
+
+// LSB-first bit stream, the order GIF packs LZW codes in.
+typedef struct
+{
+    uint8_t *data;
+    size_t cap;
+    size_t len; // complete bytes
+    uint32_t acc;
+    int nacc;
+    int end_size; // code size in effect after the last code
+} nn_gif__bits;
+
+static void nn_gif__put(nn_gif__bits *b, uint32_t code, int size)
+{
+    b->acc |= code << b->nacc;
+    b->nacc += size;
+    while (b->nacc >= 8)
+    {
+        if (b->len == b->cap)
+        {
+            b->cap = b->cap ? 2 * b->cap : 4096;
+            b->data = realloc(b->data, b->cap);
+            NN_ASSERT(b->data != NULL);
+        }
+        b->data[b->len++] = (uint8_t)b->acc;
+        b->acc >>= 8;
+        b->nacc -= 8;
+    }
+}
+
+// Appends all bits of src to dst.
+static void nn_gif__append(nn_gif__bits *dst, const nn_gif__bits *src)
+{
+    for (size_t i = 0; i < src->len; i++)
+        nn_gif__put(dst, src->data[i], 8);
+    if (src->nacc > 0) nn_gif__put(dst, src->acc & ((1u << src->nacc) - 1), src->nacc);
+}
+
+// LZW codes for n pixels, starting from an empty dictionary (as after a clear code) but without emitting the clear itself.
+// A full dictionary is cleared in-stream; out->end_size is the code size the following code has to be written with.
+static void nn_gif__lzw(nn_gif__bits *out, const uint8_t *px, size_t n, uint32_t *keys, uint16_t *vals)
+{
+    memset(keys, 0, sizeof(uint32_t) * NN_GIF_HASH);
+    int size = 9, next = 258;
+    uint32_t key = px[0];
+    for (size_t i = 1; i < n; i++)
+    {
+        uint32_t k = (key << 8 | px[i]) + 1; // +1 so that 0 marks an empty slot
+        uint32_t h = (k * 2654435761u) >> (32 - 13);
+        while (keys[h] != 0 && keys[h] != k)
+            h = (h + 1) & (NN_GIF_HASH - 1);
+        if (keys[h] == k)
+        {
+            key = vals[h];
+            continue;
+        }
+        nn_gif__put(out, key, size);
+        if (next < 4096)
+        {
+            if (next == 1 << size) size++;
+            keys[h] = k;
+            vals[h] = (uint16_t)next++;
+        }
+        else
+        {
+            nn_gif__put(out, 256, size);
+            memset(keys, 0, sizeof(uint32_t) * NN_GIF_HASH);
+            size = 9;
+            next = 258;
+        }
+        key = px[i];
+    }
+    nn_gif__put(out, key, size);
+    // The decoder adds a dictionary entry for this last code before reading the next one, so the next code is one bit wider
+    // if that entry reaches a power of two. (Right after a clear the decoder adds nothing, but then next is 258 anyway.)
+    out->end_size = next < 4096 && next == 1 << size ? size + 1 : size;
+}
+
+// Appends one frame (w x h pixels, 4 bytes each in R, G, B, A order, rows `stride` bytes apart). Alpha is ignored.
+int nn_gif_add_frame(nn_gif *g, const uint8_t *rgba, int stride)
+{
+    if (!g->fp || !g->ok) return 0;
+    int w = g->w, h = g->h;
+
+#pragma omp parallel for schedule(static)
+    for (int y = 0; y < h; y++)
+    {
+        const uint8_t *src = rgba + (size_t)y * stride;
+        uint8_t *dst = g->cur + (size_t)y * w;
+        for (int x = 0; x < w; x++, src += 4)
+            dst[x] = g->lut[(src[0] >> 2) << 12 | (src[1] >> 2) << 6 | src[2] >> 2];
+    }
+
+    // Rectangle that differs from the previous frame; the first frame of a session is always stored whole.
+    int x0 = 0, y0 = 0, x1 = w - 1, y1 = h - 1;
+    if (g->frames > 0)
+    {
+        x0 = w, y0 = h, x1 = -1, y1 = -1;
+        for (int y = 0; y < h; y++)
+        {
+            const uint8_t *a = g->cur + (size_t)y * w, *b = g->prev + (size_t)y * w;
+            if (memcmp(a, b, w) == 0) continue;
+            int l = 0, r = w - 1;
+            while (a[l] == b[l]) l++;
+            while (a[r] == b[r]) r--;
+            if (l < x0) x0 = l;
+            if (r > x1) x1 = r;
+            if (y < y0) y0 = y;
+            y1 = y;
+        }
+        if (x1 < 0) x0 = y0 = x1 = y1 = 0; // nothing changed: a single transparent pixel still carries the delay
+    }
+    int rw = x1 - x0 + 1, rh = y1 - y0 + 1;
+    size_t n = (size_t)rw * rh;
+    uint8_t *rect = malloc(n);
+    if (!rect) return g->ok = 0;
+    for (int y = 0; y < rh; y++)
+    {
+        const uint8_t *a = g->cur + (size_t)(y0 + y) * w + x0, *b = g->prev + (size_t)(y0 + y) * w + x0;
+        uint8_t *dst = rect + (size_t)y * rw;
+        for (int x = 0; x < rw; x++)
+            dst[x] = g->frames > 0 && a[x] == b[x] ? NN_GIF_TRANSPARENT : a[x];
+    }
+
+    // Whole rows per band, so every band is a contiguous run of the rectangle.
+    int band_rows = (int)(NN_GIF_BAND_PIXELS / rw) + 1;
+    int band_count = (rh + band_rows - 1) / band_rows;
+    nn_gif__bits *bands = calloc(band_count, sizeof(nn_gif__bits));
+    if (!bands)
+    {
+        free(rect);
+        return g->ok = 0;
+    }
+#pragma omp parallel
+    {
+        uint32_t *keys = malloc(sizeof(uint32_t) * NN_GIF_HASH);
+        uint16_t *vals = malloc(sizeof(uint16_t) * NN_GIF_HASH);
+        NN_ASSERT(keys != NULL && vals != NULL);
+#pragma omp for schedule(dynamic)
+        for (int b = 0; b < band_count; b++)
+        {
+            int r0 = b * band_rows, r1 = r0 + band_rows < rh ? r0 + band_rows : rh;
+            nn_gif__lzw(&bands[b], rect + (size_t)r0 * rw, (size_t)(r1 - r0) * rw, keys, vals);
+        }
+        free(keys);
+        free(vals);
+    }
+
+    // Each band is introduced by a clear code written at the code size the previous band ended with.
+    nn_gif__bits all = {0};
+    int size = 9;
+    for (int b = 0; b < band_count; b++)
+    {
+        nn_gif__put(&all, 256, size);
+        nn_gif__append(&all, &bands[b]);
+        size = bands[b].end_size;
+        free(bands[b].data);
+    }
+    nn_gif__put(&all, 257, size);
+    if (all.nacc > 0) nn_gif__put(&all, 0, 8 - all.nacc);
+    free(bands);
+    free(rect);
+
+    uint8_t gce[8] = {0x21, 0xF9, 0x04, 0x05, 0, 0, NN_GIF_TRANSPARENT, 0x00}; // keep previous frame underneath, transparency on
+    nn_gif__le16(gce + 4, g->delay);
+    uint8_t desc[11] = {0x2C, 0, 0, 0, 0, 0, 0, 0, 0, 0x00, 8}; // no local color table, LZW minimum code size 8
+    nn_gif__le16(desc + 1, x0);
+    nn_gif__le16(desc + 3, y0);
+    nn_gif__le16(desc + 5, rw);
+    nn_gif__le16(desc + 7, rh);
+    int ok = fwrite(gce, 1, sizeof(gce), g->fp) == sizeof(gce) && fwrite(desc, 1, sizeof(desc), g->fp) == sizeof(desc);
+    for (size_t i = 0; ok && i < all.len; i += 255)
+    {
+        uint8_t k = (uint8_t)(all.len - i < 255 ? all.len - i : 255);
+        ok = fputc(k, g->fp) != EOF && fwrite(all.data + i, 1, k, g->fp) == k;
+    }
+    free(all.data);
+    // Block terminator and trailer; the trailer is overwritten by the next frame.
+    ok = ok && fputc(0x00, g->fp) != EOF && fputc(0x3B, g->fp) != EOF && fflush(g->fp) == 0 && fseek(g->fp, -1, SEEK_END) == 0;
+    g->ok = ok;
+
+    uint8_t *t = g->prev;
+    g->prev = g->cur;
+    g->cur = t;
+    g->frames++;
+    return ok;
+}
+
+// Closes the file (the trailer is already in place). Returns 1 if every frame was written.
+int nn_gif_close(nn_gif *g)
+{
+    int ok = g->ok;
+    if (g->fp && fclose(g->fp) != 0) ok = 0;
+    free(g->lut);
+    free(g->prev);
+    free(g->cur);
+    memset(g, 0, sizeof(*g));
+    return ok;
+}
+
+#endif // NN_GIF_IMPLEMENTATION
@@ -0,0 +1,189 @@
+#ifndef NN_GRID_H
+#define NN_GRID_H
+
+// Evaluates a coordinate network (arch {2, ..., 1}) on a dense pixel grid.
+// Pixel (x, y) of a w*h grid is fed the input (x/(w-1), y/(h-1)), the same normalization the training code uses.
+// nn_grid_eval_view renders only a window of that unit square: the corners of the output land on the corners of the view,
+// so a crop at any zoom costs exactly w*h forward passes no matter how large the equivalent full frame would be.
+// nn_grid_eval_rows renders a horizontal strip of the same grid, so a huge image can be produced strip by strip
+// (e.g. into nn_image.h's streaming writer) without ever holding the full frame.
+// nn_grid_eval_progressive produces the same image coarse-to-fine, handing the buffer to a callback after every pass.
+// The grid is cut into tiles, tiles are handed out to OpenMP threads, and each tile goes through nn_forward_batch.
+//
+//   #define NN_IMPLEMENTATION
+//   #include "nn.h"
+//   #define NN_GRID_IMPLEMENTATION
+//   #include "nn_grid.h"
+//
+// nn.h has to be included before this header.
+
+#ifndef NN_GRID_TILE_W
+#define NN_GRID_TILE_W 64
+#endif
+
+#ifndef NN_GRID_TILE_H
+#define NN_GRID_TILE_H 8
+#endif
+
+// Sample spacing of the first progressive pass (a power of two). 8 means the first image costs 1/64 of the full render.
+#ifndef NN_GRID_PROGRESSIVE_STEP
+#define NN_GRID_PROGRESSIVE_STEP 8
+#endif
+
+// Normalized window of the (x, y) input square; {0, 0, 1, 1} is the full image.
+typedef struct
+{
+    float x0, y0;
+    float x1, y1;
+} nn_view;
+
+#define NN_VIEW_FULL ((nn_view){0.0f, 0.0f, 1.0f, 1.0f})
+
+nn_view nn_view_zoom(float cx, float cy, float zoom);
+void nn_grid_eval(nn net, float *out, int w, int h, int stride);
+void nn_grid_eval_view(nn net, float *out, int w, int h, int stride, nn_view view);
+void nn_grid_eval_rows(nn net, float *out, int w, int h, int stride, nn_view view, int first, int count);
+
+// Called after every progressive pass with the whole (block-filled) buffer. `step` is the sample spacing of the pass that just finished; 1 means final.
+typedef void (*nn_grid_pass_fn)(const float *out, int w, int h, int stride, int pass, int step, void *user);
+
+void nn_grid_eval_progressive(nn net, float *out, int w, int h, int stride, nn_view view, nn_grid_pass_fn on_pass, void *user);
+
+#endif // NN_GRID_H
+
+#ifdef NN_GRID_IMPLEMENTATION
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// Window of size 1/zoom centered on (cx, cy), e.g. nn_view_zoom(0.3f, 0.6f, 50.0f) for a 50x close-up. It may extend past the unit square.
+nn_view nn_view_zoom(float cx, float cy, float zoom)
+{
+    NN_ASSERT(zoom > 0.0f);
+    float r = 0.5f / zoom;
+    return (nn_view){cx - r, cy - r, cx + r, cy + r};
+}
+
+// Evaluates every pixel of a w*h grid into out (row stride `stride` floats). The net is only read, so it may be shared.
+void nn_grid_eval(nn net, float *out, int w, int h, int stride)
+{
+    nn_grid_eval_view(net, out, w, h, stride, NN_VIEW_FULL);
+}
+
+// Evaluates a w*h grid spanning `view` into out. Pixel (x, y) is fed (view.x0 + x*(view.x1 - view.x0)/(w-1), ...).
+void nn_grid_eval_view(nn net, float *out, int w, int h, int stride, nn_view view)
+{
+    nn_grid_eval_rows(net, out, w, h, stride, view, 0, h);
+}
+
+// Evaluates rows first..first+count-1 of the w*h grid spanning `view`; grid row `first` lands in row 0 of out.
+// Every pixel gets exactly the input nn_grid_eval_view would give it, so strips put together are identical to a full render.
+void nn_grid_eval_rows(nn net, float *out, int w, int h, int stride, nn_view view, int first, int count)
+{
+    NN_ASSERT(NN_INPUT_MAT(net).cols == 2);
+    NN_ASSERT(NN_OUTPUT_MAT(net).cols == 1);
+    NN_ASSERT(first >= 0 && count >= 0 && first + count <= h);
+    int tiles_x = (w + NN_GRID_TILE_W - 1) / NN_GRID_TILE_W;
+    int tiles_y = (count + NN_GRID_TILE_H - 1) / NN_GRID_TILE_H;
+    float sx = w > 1 ? (view.x1 - view.x0) / (w - 1) : 0.0f;
+    float sy = h > 1 ? (view.y1 - view.y0) / (h - 1) : 0.0f;
+
+#pragma omp parallel
+    {
+        float *scratch = NN_MALLOC(sizeof(float) * nn_batch_scratch_size(net));
+        mat in = mat_alloc(NN_GRID_TILE_W * NN_GRID_TILE_H, 2);
+        mat res = mat_alloc(NN_GRID_TILE_W * NN_GRID_TILE_H, 1);
+        NN_ASSERT(scratch != NULL);
+
+#pragma omp for schedule(dynamic)
+        for (int t = 0; t < tiles_x * tiles_y; t++)
+        {
+            int x0 = (t % tiles_x) * NN_GRID_TILE_W;
+            int y0 = (t / tiles_x) * NN_GRID_TILE_H;
+            int tw = w - x0 < NN_GRID_TILE_W ? w - x0 : NN_GRID_TILE_W;
+            int th = count - y0 < NN_GRID_TILE_H ? count - y0 : NN_GRID_TILE_H;
+
+            in.rows = res.rows = tw * th;
+            for (int y = 0; y < th; y++)
+                for (int x = 0; x < tw; x++)
+                {
+                    MAT_AT(in, y * tw + x, 0) = view.x0 + (x0 + x) * sx;
+                    MAT_AT(in, y * tw + x, 1) = view.y0 + (first + y0 + y) * sy;
+                }
+            nn_forward_batch(net, in, res, scratch);
+            for (int y = 0; y < th; y++)
+                for (int x = 0; x < tw; x++)
+                    out[(size_t)(y0 + y) * stride + x0 + x] = MAT_AT(res, y * tw + x, 0);
+        }
+
+        free(scratch);
+        free(in.data);
+        free(res.data);
+    }
+}
+
+// Fills the step*step block whose top-left corner is (x, y), clipped to the grid.
+static void nn_grid__fill_block(float *out, int w, int h, int stride, int x, int y, int step, float v)
+{
+    int x1 = x + step < w ? x + step : w;
+    int y1 = y + step < h ? y + step : h;
+    for (int yy = y; yy < y1; yy++)
+        for (int xx = x; xx < x1; xx++)
+            out[(size_t)yy * stride + xx] = v;
+}
+
+// Same result as nn_grid_eval_view, produced in passes of halving sample spacing.
+// The first pass evaluates every NN_GRID_PROGRESSIVE_STEP-th pixel in both directions; each later pass evaluates only the pixels
+// that are on its lattice but not on any coarser one, so every pixel is still evaluated exactly once.
+// Each evaluated sample is held over its step*step block so the buffer handed to on_pass is always a complete image.
+void nn_grid_eval_progressive(nn net, float *out, int w, int h, int stride, nn_view view, nn_grid_pass_fn on_pass, void *user)
+{
+    NN_ASSERT(NN_INPUT_MAT(net).cols == 2);
+    NN_ASSERT(NN_OUTPUT_MAT(net).cols == 1);
+    float sx = w > 1 ? (view.x1 - view.x0) / (w - 1) : 0.0f;
+    float sy = h > 1 ? (view.y1 - view.y0) / (h - 1) : 0.0f;
+
+    int pass = 0;
+    for (int step = NN_GRID_PROGRESSIVE_STEP; step >= 1; step /= 2, pass++)
+    {
+        int rows = (h + step - 1) / step;
+
+#pragma omp parallel
+        {
+            float *scratch = NN_MALLOC(sizeof(float) * nn_batch_scratch_size(net));
+            mat in = mat_alloc(w, 2);
+            mat res = mat_alloc(w, 1);
+            NN_ASSERT(scratch != NULL);
+
+#pragma omp for schedule(dynamic)
+            for (int r = 0; r < rows; r++)
+            {
+                int y = r * step;
+                // On rows that an earlier pass already sampled only the odd multiples of step are new.
+                int first = pass > 0 && y % (2 * step) == 0 ? step : 0;
+                int xstep = first ? 2 * step : step;
+                int n = 0;
+                for (int x = first; x < w; x += xstep, n++)
+                {
+                    MAT_AT(in, n, 0) = view.x0 + x * sx;
+                    MAT_AT(in, n, 1) = view.y0 + y * sy;
+                }
+                if (n == 0) continue;
+                in.rows = res.rows = n;
+                nn_forward_batch(net, in, res, scratch);
+                n = 0;
+                for (int x = first; x < w; x += xstep, n++)
+                    nn_grid__fill_block(out, w, h, stride, x, y, step, MAT_AT(res, n, 0));
+            }
+
+            free(scratch);
+            free(in.data);
+            free(res.data);
+        }
+
+        if (on_pass) on_pass(out, w, h, stride, pass, step, user);
+    }
+}
+
+#endif // NN_GRID_IMPLEMENTATION
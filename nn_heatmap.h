@@ -0,0 +1,287 @@
+#ifndef NN_HEATMAP_H
+#define NN_HEATMAP_H
+
+// Heatmap view of a network for layers too wide to draw as a diagram. Every weight matrix net.w[l] is blitted as a tile of
+// square cells, row i / column j being the weight from neuron i of layer l to neuron j of layer l + 1. Under each tile
+// the biases net.b[l] form a strip of cells lined up with the columns, and under the strip a histogram shows how the
+// activations of layer l + 1 were spread over [0, 1] for the inputs last passed to nn_heatmap_sample.
+//
+// Values are colored through a lookup table filled from the caller's color function (the visualizers pass their
+// weight_to_rgcolor), so each of them keeps its own scheme and pixel format. The table samples the function at
+// NN_HEATMAP_LUT_SIZE points over [-NN_HEATMAP_RANGE, NN_HEATMAP_RANGE]; values outside get the color of the nearest end.
+// Table indices are computed four values at a time with SSE2 where available.
+//
+// A frame costs in proportion to the number of parameters (times the cell area), not to the number of connections times
+// their length on screen, so {2, 128, 64, 32, 1} draws as fast as a toy net draws as lines.
+//
+//   nn_heatmap hm;
+//   nn_heatmap_init(&hm, net, weight_to_rgcolor, BACKGROUND, FOREGROUND);
+//   // every frame:
+//   nn_heatmap_sample(&hm, net, some_inputs);   // optional, for the histograms
+//   nn_heatmap_draw(&hm, canvas, net);
+//
+// nn.h and olive.c have to be included before this header.
+//
+//   #define NN_HEATMAP_IMPLEMENTATION
+//   #include "nn_heatmap.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef NN_HEATMAP_LUT_SIZE
+#define NN_HEATMAP_LUT_SIZE 4096
+#endif
+
+#ifndef NN_HEATMAP_RANGE
+#define NN_HEATMAP_RANGE 8.0f // tanhf is 1 to within a color level past this
+#endif
+
+#ifndef NN_HEATMAP_BINS
+#define NN_HEATMAP_BINS 32 // activation histogram bins over [0, 1]
+#endif
+
+#define NN_HEATMAP_MAX_CELL 24 // largest cell side in pixels, for tiny nets
+#define NN_HEATMAP_MIN_SLOT 96 // narrowest column a layer gets, so 1-wide outputs still have a label and a readable histogram
+#define NN_HEATMAP_MARGIN 16
+#define NN_HEATMAP_GAP 16
+#define NN_HEATMAP_LABEL_H 18 // text over every tile
+#define NN_HEATMAP_HIST_H 64
+
+typedef uint32_t (*nn_heatmap_color_fn)(float value);
+
+typedef struct
+{
+    uint32_t lut[NN_HEATMAP_LUT_SIZE];
+    uint32_t background;
+    uint32_t foreground; // labels and histogram bars
+    int layer_count;
+    int width; // widest layer
+    uint32_t *hist; // NN_HEATMAP_BINS counts per layer, activations of a[l + 1]
+    int samples; // inputs behind hist, 0 before the first nn_heatmap_sample
+    float *scratch; // two activation rows for nn_heatmap_sample
+    uint32_t *line; // one tile row: colors, then the row expanded to cells
+} nn_heatmap;
+
+void nn_heatmap_init(nn_heatmap *h, nn net, nn_heatmap_color_fn color, uint32_t background, uint32_t foreground);
+void nn_heatmap_free(nn_heatmap *h);
+void nn_heatmap_colors(const nn_heatmap *h, const float *values, uint32_t *colors, size_t count);
+void nn_heatmap_sample(nn_heatmap *h, nn net, mat in);
+void nn_heatmap_draw(nn_heatmap *h, Olivec_Canvas oc, nn net);
+
+#endif // NN_HEATMAP_H
+
+#ifdef NN_HEATMAP_IMPLEMENTATION
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef NN_ASSERT
+#include <assert.h>
+#define NN_ASSERT assert
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define NN_HEATMAP_SSE2 1
+#endif
+
+#define NN_HEATMAP__SCALE ((NN_HEATMAP_LUT_SIZE - 1) / (2.0f * NN_HEATMAP_RANGE))
+
+void nn_heatmap_init(nn_heatmap *h, nn net, nn_heatmap_color_fn color, uint32_t background, uint32_t foreground)
+{
+    memset(h, 0, sizeof(*h));
+    for (int i = 0; i < NN_HEATMAP_LUT_SIZE; i++)
+        h->lut[i] = color(-NN_HEATMAP_RANGE + i / NN_HEATMAP__SCALE);
+    h->background = background;
+    h->foreground = foreground;
+    h->layer_count = net.count;
+    h->width = nn_max_width(net);
+    h->hist = calloc((size_t)net.count * NN_HEATMAP_BINS, sizeof(uint32_t));
+    h->scratch = malloc(2 * sizeof(float) * h->width);
+    h->line = malloc(sizeof(uint32_t) * h->width * (1 + NN_HEATMAP_MAX_CELL));
+    NN_ASSERT(h->hist != NULL && h->scratch != NULL && h->line != NULL);
+}
+
+void nn_heatmap_free(nn_heatmap *h)
+{
+    free(h->hist);
+    free(h->scratch);
+    free(h->line);
+    h->hist = NULL;
+    h->scratch = NULL;
+    h->line = NULL;
+}
+
+// Nearest table entry for every value. NaN ends up at index 0 on both paths.
+void nn_heatmap_colors(const nn_heatmap *h, const float *values, uint32_t *colors, size_t count)
+{
+    const float scale = NN_HEATMAP__SCALE;
+    const float offset = NN_HEATMAP_RANGE * NN_HEATMAP__SCALE + 0.5f;
+    const float top = (float)(NN_HEATMAP_LUT_SIZE - 1);
+    size_t i = 0;
+#ifdef NN_HEATMAP_SSE2
+    const __m128 vscale = _mm_set1_ps(scale), voffset = _mm_set1_ps(offset);
+    const __m128 vzero = _mm_setzero_ps(), vtop = _mm_set1_ps(top);
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 x = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(values + i), vscale), voffset);
+        x = _mm_min_ps(_mm_max_ps(x, vzero), vtop); // maxps returns its second operand for NaN
+        int idx[4];
+        _mm_storeu_si128((__m128i *)idx, _mm_cvttps_epi32(x));
+        colors[i + 0] = h->lut[idx[0]];
+        colors[i + 1] = h->lut[idx[1]];
+        colors[i + 2] = h->lut[idx[2]];
+        colors[i + 3] = h->lut[idx[3]];
+    }
+#endif
+    for (; i < count; i++)
+    {
+        float x = values[i] * scale + offset;
+        if (!(x > 0.0f)) x = 0.0f;
+        if (x > top) x = top;
+        colors[i] = h->lut[(int)x];
+    }
+}
+
+// Forward pass over every row of `in`, binning the activations of each layer. Only reads the net, like nn_forward_batch.
+void nn_heatmap_sample(nn_heatmap *h, nn net, mat in)
+{
+    NN_ASSERT(in.cols == NN_INPUT_MAT(net).cols);
+    NN_ASSERT(net.count == h->layer_count);
+    memset(h->hist, 0, sizeof(uint32_t) * net.count * NN_HEATMAP_BINS);
+    float *buf[2] = {h->scratch, h->scratch + h->width};
+
+    for (int r = 0; r < in.rows; r++)
+    {
+        const float *cur = &MAT_AT(in, r, 0);
+        for (int l = 0; l < net.count; l++)
+        {
+            float *dst = buf[l & 1];
+            int n = net.w[l].cols;
+            for (int j = 0; j < n; j++)
+                dst[j] = net.b[l].data[j];
+            for (int k = 0; k < net.w[l].rows; k++)
+            {
+                float a = cur[k];
+                const float *wrow = &MAT_AT(net.w[l], k, 0);
+                for (int j = 0; j < n; j++)
+                    dst[j] += a * wrow[j];
+            }
+            uint32_t *hist = h->hist + (size_t)l * NN_HEATMAP_BINS;
+            for (int j = 0; j < n; j++)
+            {
+                dst[j] = sigmoidf(dst[j]);
+                int b = (int)(dst[j] * NN_HEATMAP_BINS);
+                hist[b < 0 ? 0 : b >= NN_HEATMAP_BINS ? NN_HEATMAP_BINS - 1 : b]++;
+            }
+            cur = dst;
+        }
+    }
+    h->samples = in.rows;
+}
+
+// rows x cols values as cell_w x cell_h rectangles with the top left corner at (x, y), clipped to the canvas
+static void nn_heatmap__tile(nn_heatmap *h, Olivec_Canvas oc, int x, int y, int cell_w, int cell_h,
+                             const float *values, int rows, int cols, size_t stride)
+{
+    int x0 = x < 0 ? 0 : x;
+    int x1 = x + cols * cell_w;
+    if (x1 > (int)oc.width) x1 = (int)oc.width;
+    if (x0 >= x1) return;
+    uint32_t *colors = h->line;
+    uint32_t *cells = h->line + cols;
+
+    for (int i = 0; i < rows; i++)
+    {
+        int y0 = y + i * cell_h, y1 = y0 + cell_h;
+        if (y0 < 0) y0 = 0;
+        if (y1 > (int)oc.height) y1 = (int)oc.height;
+        if (y0 >= y1) continue;
+
+        nn_heatmap_colors(h, values + i * stride, colors, cols);
+        const uint32_t *src = colors;
+        if (cell_w > 1)
+        {
+            for (int j = 0; j < cols; j++)
+                olivec_fill_span(cells + (size_t)j * cell_w, cell_w, colors[j]);
+            src = cells;
+        }
+        for (int py = y0; py < y1; py++)
+            memcpy(&OLIVEC_PIXEL(oc, x0, py), src + (x0 - x), sizeof(uint32_t) * (x1 - x0));
+    }
+}
+
+// Largest cell size at which all layers fit side by side, 1 if even that does not (the canvas then clips)
+static int nn_heatmap__cell(nn net, int width, int height)
+{
+    for (int cell = NN_HEATMAP_MAX_CELL; cell > 1; cell--)
+    {
+        int w = NN_HEATMAP_GAP * (net.count - 1), rows = 0;
+        for (int l = 0; l < net.count; l++)
+        {
+            int tw = net.w[l].cols * cell;
+            w += tw > NN_HEATMAP_MIN_SLOT ? tw : NN_HEATMAP_MIN_SLOT;
+            if (net.w[l].rows > rows) rows = net.w[l].rows;
+        }
+        int bias_h = cell > 4 ? cell : 4;
+        int h = NN_HEATMAP_LABEL_H + rows * cell + 4 + bias_h + 8 + NN_HEATMAP_HIST_H;
+        if (w <= width && h <= height)
+            return cell;
+    }
+    return 1;
+}
+
+void nn_heatmap_draw(nn_heatmap *h, Olivec_Canvas oc, nn net)
+{
+    NN_ASSERT(net.count == h->layer_count);
+    olivec_fill(oc, h->background);
+    int cell = nn_heatmap__cell(net, (int)oc.width - 2 * NN_HEATMAP_MARGIN, (int)oc.height - 2 * NN_HEATMAP_MARGIN);
+    int bias_h = cell > 4 ? cell : 4;
+
+    int rows = 0, total = NN_HEATMAP_GAP * (net.count - 1);
+    for (int l = 0; l < net.count; l++)
+    {
+        int tw = net.w[l].cols * cell;
+        total += tw > NN_HEATMAP_MIN_SLOT ? tw : NN_HEATMAP_MIN_SLOT;
+        if (net.w[l].rows > rows) rows = net.w[l].rows;
+    }
+    int x = ((int)oc.width - total) / 2;
+    if (x < NN_HEATMAP_MARGIN) x = NN_HEATMAP_MARGIN;
+    int tile_y = NN_HEATMAP_MARGIN + NN_HEATMAP_LABEL_H;
+    int bias_y = tile_y + rows * cell + 4;
+    int hist_y = bias_y + bias_h + 8;
+
+    for (int l = 0; l < net.count; l++)
+    {
+        mat w = net.w[l];
+        int tw = w.cols * cell;
+        int slot = tw > NN_HEATMAP_MIN_SLOT ? tw : NN_HEATMAP_MIN_SLOT;
+
+        char label[32];
+        snprintf(label, sizeof(label), "w%d %dx%d", l, w.rows, w.cols);
+        Olivec_Canvas label_area = olivec_subcanvas(oc, x, NN_HEATMAP_MARGIN, slot, NN_HEATMAP_LABEL_H);
+        if (label_area.pixels)
+            olivec_text(label_area, label, 0, 0, olivec_default_font, 2, h->foreground);
+
+        nn_heatmap__tile(h, oc, x, tile_y, cell, cell, w.data, w.rows, w.cols, w.stride);
+        nn_heatmap__tile(h, oc, x, bias_y, cell, bias_h, net.b[l].data, 1, w.cols, 0);
+
+        // Histogram of a[l + 1], bars scaled to the fullest bin of the layer
+        olivec_rect(oc, x, hist_y + NN_HEATMAP_HIST_H, slot, 1, h->foreground);
+        const uint32_t *hist = h->hist + (size_t)l * NN_HEATMAP_BINS;
+        uint32_t peak = 0;
+        for (int b = 0; b < NN_HEATMAP_BINS; b++)
+            if (hist[b] > peak) peak = hist[b];
+        for (int b = 0; h->samples > 0 && peak > 0 && b < NN_HEATMAP_BINS; b++)
+        {
+            int bx0 = x + b * slot / NN_HEATMAP_BINS, bx1 = x + (b + 1) * slot / NN_HEATMAP_BINS;
+            int bh = (int)((uint64_t)hist[b] * NN_HEATMAP_HIST_H / peak);
+            if (bh > 0)
+                olivec_rect(oc, bx0, hist_y + NN_HEATMAP_HIST_H - bh, bx1 - bx0 > 1 ? bx1 - bx0 - 1 : 1, bh, h->foreground);
+        }
+        x += slot + NN_HEATMAP_GAP;
+    }
+}
+
+#endif // NN_HEATMAP_IMPLEMENTATION
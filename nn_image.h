@@ -0,0 +1,661 @@
+#ifndef NN_IMAGE_H
+#define NN_IMAGE_H
+
+// Streaming image writer: the image is handed over a few rows at a time and goes to disk as it arrives, so the whole frame
+// never has to exist in memory and the first bytes are written as soon as the first strip is rendered.
+//
+// The format follows the file extension:
+//   .png        8-bit gray, gray+alpha, RGB or RGBA PNG. Rows are filtered and fed to an incremental deflate
+//               (LZ77 + fixed Huffman codes); compressed data leaves in IDAT chunks whenever a chunk's worth is ready.
+//   .pgm/.ppm   binary P5 (1 channel) / P6 (3 channels), written as is.
+//   anything else  raw bytes, rows back to back.
+//
+//   nn_image_writer w;
+//   nn_image_open(&w, "big.png", width, height, 1, NN_IMAGE_LEVEL_DEFAULT);
+//   for each strip: nn_image_write_rows(&w, rows, row_count, row_stride);
+//   nn_image_close(&w);
+//
+// nn_png_write is a drop-in for stbi_write_png (same arguments) for images that are already in memory: the rows are cut
+// into bands, every band is filtered and deflated on its own OpenMP thread, and the band streams are joined with zlib sync
+// flushes into one valid stream (the Adler-32 checksums are combined, not recomputed). nn_png_compression_level plays the role
+// of stbi_write_png_compression_level; NN_IMAGE_LEVEL_FAST trades some file size for speed, which suits preview frames.
+//
+//   #define NN_IMAGE_IMPLEMENTATION
+//   #include "nn_image.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stddef.h>
+
+#define NN_IMAGE_LEVEL_FAST 1 // short match search, single filter (Paeth)
+#define NN_IMAGE_LEVEL_DEFAULT 6 // longer match search, per-row adaptive filter choice
+
+#define NN_DEFLATE_WINDOW 32768
+#define NN_DEFLATE_BLOCK (128 * 1024) // pending input compressed per fixed-Huffman block
+#define NN_PNG_BAND_BYTES (256 * 1024) // nn_png_write: minimum raw bytes per band handed to a thread
+
+// Incremental zlib stream. Input goes in through nn_deflate_push, compressed bytes collect in out/out_len for the caller to drain.
+typedef struct
+{
+    int level;
+    uint8_t *buf; // history (up to NN_DEFLATE_WINDOW bytes) followed by pending input
+    size_t hist, len;
+    int32_t *head; // hash of 3 bytes -> latest position in buf, -1 if none
+    int32_t *prev; // position -> previous position with the same hash
+    uint32_t bits;
+    int nbits;
+    uint8_t *out;
+    size_t out_len, out_cap;
+    uint32_t adler;
+} nn_deflate;
+
+enum { NN_IMAGE_PNG, NN_IMAGE_PNM, NN_IMAGE_RAW };
+
+typedef struct
+{
+    FILE *fp;
+    int format;
+    int w, h, comp;
+    int level;
+    int rows; // rows written so far
+    int ok;
+    nn_deflate z;
+    uint8_t *prev; // previous row (PNG filters), zeros before the first row
+    uint8_t *filt; // 5 candidate filtered rows, each 1 + w*comp bytes
+} nn_image_writer;
+
+int nn_deflate_init(nn_deflate *d, int level);
+void nn_deflate_push(nn_deflate *d, const uint8_t *data, size_t n);
+void nn_deflate_flush(nn_deflate *d, int final);
+void nn_deflate_free(nn_deflate *d);
+
+uint32_t nn_crc32(uint32_t crc, const uint8_t *data, size_t n);
+uint32_t nn_adler32(uint32_t adler, const uint8_t *data, size_t n);
+uint32_t nn_adler32_combine(uint32_t adler1, uint32_t adler2, size_t len2);
+
+int nn_image_open(nn_image_writer *w, const char *path, int width, int height, int comp, int level);
+int nn_image_write_rows(nn_image_writer *w, const uint8_t *rows, int count, int stride);
+int nn_image_close(nn_image_writer *w);
+
+extern int nn_png_compression_level;
+int nn_png_write(const char *path, int w, int h, int comp, const void *data, int stride);
+
+#endif // NN_IMAGE_H
+
+#ifdef NN_IMAGE_IMPLEMENTATION
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#ifndef NN_ASSERT
+#include <assert.h>
+#define NN_ASSERT assert
+#endif
+
+#define NN_DEFLATE_HASH_BITS 15
+#define NN_DEFLATE_MIN_MATCH 3
+#define NN_DEFLATE_MAX_MATCH 258
+
+static const uint16_t nn_deflate__len_base[] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+static const uint8_t nn_deflate__len_extra[] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+static const uint16_t nn_deflate__dist_base[] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+static const uint8_t nn_deflate__dist_extra[] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+static void nn_deflate__byte(nn_deflate *d, uint8_t b)
+{
+    if (d->out_len == d->out_cap)
+    {
+        d->out_cap = d->out_cap ? 2 * d->out_cap : 65536;
+        d->out = realloc(d->out, d->out_cap);
+        NN_ASSERT(d->out != NULL);
+    }
+    d->out[d->out_len++] = b;
+}
+
+// Deflate packs bits LSB first.
+static void nn_deflate__bits(nn_deflate *d, uint32_t value, int count)
+{
+    d->bits |= value << d->nbits;
+    d->nbits += count;
+    while (d->nbits >= 8)
+    {
+        nn_deflate__byte(d, (uint8_t)d->bits);
+        d->bits >>= 8;
+        d->nbits -= 8;
+    }
+}
+
+// Huffman codes are defined MSB first, so they go out reversed.
+static void nn_deflate__code(nn_deflate *d, uint32_t code, int count)
+{
+    uint32_t r = 0;
+    for (int i = 0; i < count; i++)
+        r |= ((code >> i) & 1u) << (count - 1 - i);
+    nn_deflate__bits(d, r, count);
+}
+
+// Fixed Huffman literal/length alphabet (RFC 1951, 3.2.6).
+static void nn_deflate__sym(nn_deflate *d, int v)
+{
+    if (v < 144) nn_deflate__code(d, 0x30 + v, 8);
+    else if (v < 256) nn_deflate__code(d, 0x190 + v - 144, 9);
+    else if (v < 280) nn_deflate__code(d, v - 256, 7);
+    else nn_deflate__code(d, 0xC0 + v - 280, 8);
+}
+
+static void nn_deflate__match(nn_deflate *d, int len, int dist)
+{
+    int i = 0;
+    while (i < 28 && nn_deflate__len_base[i + 1] <= len) i++;
+    nn_deflate__sym(d, 257 + i);
+    nn_deflate__bits(d, len - nn_deflate__len_base[i], nn_deflate__len_extra[i]);
+    int j = 0;
+    while (j < 29 && nn_deflate__dist_base[j + 1] <= dist) j++;
+    nn_deflate__code(d, j, 5);
+    nn_deflate__bits(d, dist - nn_deflate__dist_base[j], nn_deflate__dist_extra[j]);
+}
+
+static uint32_t nn_deflate__hash(const uint8_t *p)
+{
+    uint32_t v = (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16;
+    return (v * 2654435761u) >> (32 - NN_DEFLATE_HASH_BITS);
+}
+
+static void nn_deflate__insert(nn_deflate *d, size_t p)
+{
+    if (p + NN_DEFLATE_MIN_MATCH > d->len) return;
+    uint32_t h = nn_deflate__hash(d->buf + p);
+    d->prev[p] = d->head[h];
+    d->head[h] = (int32_t)p;
+}
+
+// Compresses everything pending as one fixed-Huffman block, then keeps only the last window of history.
+static void nn_deflate__compress(nn_deflate *d)
+{
+    if (d->len == d->hist) return;
+    nn_deflate__bits(d, 0, 1); // BFINAL = 0
+    nn_deflate__bits(d, 1, 2); // BTYPE = 01, fixed codes
+    // Candidates tried per position, and the match length that is good enough to stop searching.
+    int chain_limit = d->level * 4;
+    size_t nice = d->level <= 1 ? 32 : d->level >= 9 ? NN_DEFLATE_MAX_MATCH : 16u << (d->level / 2);
+
+    size_t p = d->hist;
+    while (p < d->len)
+    {
+        int best = 0, best_dist = 0;
+        size_t max = d->len - p < NN_DEFLATE_MAX_MATCH ? d->len - p : NN_DEFLATE_MAX_MATCH;
+        if (max >= NN_DEFLATE_MIN_MATCH)
+        {
+            int32_t cand = d->head[nn_deflate__hash(d->buf + p)];
+            for (int chain = chain_limit; cand >= 0 && p - (size_t)cand <= NN_DEFLATE_WINDOW && chain > 0; chain--)
+            {
+                const uint8_t *a = d->buf + cand, *b = d->buf + p;
+                if (a[best] == b[best])
+                {
+                    int n = 0;
+                    while ((size_t)n < max && a[n] == b[n]) n++;
+                    if (n > best)
+                    {
+                        best = n;
+                        best_dist = (int)(p - (size_t)cand);
+                        if ((size_t)n == max || (size_t)n >= nice) break;
+                    }
+                }
+                cand = d->prev[cand];
+            }
+        }
+        if (best >= NN_DEFLATE_MIN_MATCH)
+        {
+            nn_deflate__match(d, best, best_dist);
+            for (int k = 0; k < best; k++)
+                nn_deflate__insert(d, p + k);
+            p += best;
+        }
+        else
+        {
+            nn_deflate__sym(d, d->buf[p]);
+            nn_deflate__insert(d, p);
+            p++;
+        }
+    }
+    nn_deflate__sym(d, 256); // end of block
+
+    // Slide: positions are indices into buf, so shifting the buffer means shifting every stored position too.
+    size_t shift = d->len > NN_DEFLATE_WINDOW ? d->len - NN_DEFLATE_WINDOW : 0;
+    if (shift > 0)
+    {
+        memmove(d->buf, d->buf + shift, d->len - shift);
+        for (size_t i = 0; i < d->len - shift; i++)
+        {
+            int32_t v = d->prev[i + shift];
+            d->prev[i] = v >= (int32_t)shift ? v - (int32_t)shift : -1;
+        }
+        for (int i = 0; i < 1 << NN_DEFLATE_HASH_BITS; i++)
+            d->head[i] = d->head[i] >= (int32_t)shift ? d->head[i] - (int32_t)shift : -1;
+        d->len -= shift;
+    }
+    d->hist = d->len;
+}
+
+static int nn_deflate__init(nn_deflate *d, int level, int zlib_header)
+{
+    memset(d, 0, sizeof(*d));
+    d->level = level < 1 ? 1 : level > 9 ? 9 : level;
+    d->buf = malloc(NN_DEFLATE_WINDOW + NN_DEFLATE_BLOCK);
+    d->prev = malloc(sizeof(int32_t) * (NN_DEFLATE_WINDOW + NN_DEFLATE_BLOCK));
+    d->head = malloc(sizeof(int32_t) << NN_DEFLATE_HASH_BITS);
+    if (!d->buf || !d->prev || !d->head)
+    {
+        nn_deflate_free(d);
+        return 0;
+    }
+    memset(d->head, 0xFF, sizeof(int32_t) << NN_DEFLATE_HASH_BITS);
+    d->adler = 1;
+    if (zlib_header)
+    {
+        nn_deflate__byte(d, 0x78);
+        nn_deflate__byte(d, d->level <= 1 ? 0x01 : 0x9C);
+    }
+    return 1;
+}
+
+// Starts a zlib stream (2-byte header written to out). level 1..9; 1 searches least.
+int nn_deflate_init(nn_deflate *d, int level)
+{
+    return nn_deflate__init(d, level, 1);
+}
+
+void nn_deflate_push(nn_deflate *d, const uint8_t *data, size_t n)
+{
+    d->adler = nn_adler32(d->adler, data, n);
+    while (n > 0)
+    {
+        size_t room = NN_DEFLATE_WINDOW + NN_DEFLATE_BLOCK - d->len;
+        size_t k = n < room ? n : room;
+        memcpy(d->buf + d->len, data, k);
+        d->len += k;
+        data += k;
+        n -= k;
+        if (d->len == NN_DEFLATE_WINDOW + NN_DEFLATE_BLOCK) nn_deflate__compress(d);
+    }
+}
+
+// Compresses everything pushed so far and byte-aligns the output.
+// final = 0 is a zlib sync flush (empty stored block), after which the stream can be continued or concatenated;
+// final = 1 ends the deflate stream and appends the Adler-32 trailer.
+void nn_deflate_flush(nn_deflate *d, int final)
+{
+    nn_deflate__compress(d);
+    if (final)
+    {
+        nn_deflate__bits(d, 1, 1);
+        nn_deflate__bits(d, 1, 2);
+        nn_deflate__sym(d, 256);
+        if (d->nbits > 0) nn_deflate__bits(d, 0, 8 - d->nbits);
+        for (int i = 3; i >= 0; i--)
+            nn_deflate__byte(d, (uint8_t)(d->adler >> (8 * i)));
+    }
+    else
+    {
+        nn_deflate__bits(d, 0, 1);
+        nn_deflate__bits(d, 0, 2);
+        if (d->nbits > 0) nn_deflate__bits(d, 0, 8 - d->nbits);
+        nn_deflate__byte(d, 0x00);
+        nn_deflate__byte(d, 0x00);
+        nn_deflate__byte(d, 0xFF);
+        nn_deflate__byte(d, 0xFF);
+    }
+}
+
+void nn_deflate_free(nn_deflate *d)
+{
+    free(d->buf);
+    free(d->prev);
+    free(d->head);
+    free(d->out);
+    memset(d, 0, sizeof(*d));
+}
+
+uint32_t nn_adler32(uint32_t adler, const uint8_t *data, size_t n)
+{
+    uint32_t a = adler & 0xFFFF, b = adler >> 16;
+    while (n > 0)
+    {
+        size_t k = n < 5552 ? n : 5552; // largest run before b can overflow 32 bits
+        n -= k;
+        while (k--)
+        {
+            a += *data++;
+            b += a;
+        }
+        a %= 65521;
+        b %= 65521;
+    }
+    return b << 16 | a;
+}
+
+// Adler-32 of A followed by B, given adler(A), adler(B) (started from 1) and the length of B.
+uint32_t nn_adler32_combine(uint32_t adler1, uint32_t adler2, size_t len2)
+{
+    const uint32_t base = 65521;
+    uint32_t rem = (uint32_t)(len2 % base);
+    uint32_t a1 = adler1 & 0xFFFF, b1 = adler1 >> 16, a2 = adler2 & 0xFFFF, b2 = adler2 >> 16;
+    uint32_t a = (a1 + a2 + base - 1) % base;
+    uint32_t b = (uint32_t)(((uint64_t)rem * a1 + b1 + b2 + base - rem) % base);
+    return b << 16 | a;
+}
+
+// CRC-32 (reflected polynomial 0xEDB88320) of every byte value. A constant rather than a lazily filled table, so
+// concurrent first writes from different threads cannot race on it.
+static const uint32_t nn_crc32__table[256] = {
+    0x00000000u, 0x77073096u, 0xEE0E612Cu, 0x990951BAu, 0x076DC419u, 0x706AF48Fu, 0xE963A535u, 0x9E6495A3u,
+    0x0EDB8832u, 0x79DCB8A4u, 0xE0D5E91Eu, 0x97D2D988u, 0x09B64C2Bu, 0x7EB17CBDu, 0xE7B82D07u, 0x90BF1D91u,
+    0x1DB71064u, 0x6AB020F2u, 0xF3B97148u, 0x84BE41DEu, 0x1ADAD47Du, 0x6DDDE4EBu, 0xF4D4B551u, 0x83D385C7u,
+    0x136C9856u, 0x646BA8C0u, 0xFD62F97Au, 0x8A65C9ECu, 0x14015C4Fu, 0x63066CD9u, 0xFA0F3D63u, 0x8D080DF5u,
+    0x3B6E20C8u, 0x4C69105Eu, 0xD56041E4u, 0xA2677172u, 0x3C03E4D1u, 0x4B04D447u, 0xD20D85FDu, 0xA50AB56Bu,
+    0x35B5A8FAu, 0x42B2986Cu, 0xDBBBC9D6u, 0xACBCF940u, 0x32D86CE3u, 0x45DF5C75u, 0xDCD60DCFu, 0xABD13D59u,
+    0x26D930ACu, 0x51DE003Au, 0xC8D75180u, 0xBFD06116u, 0x21B4F4B5u, 0x56B3C423u, 0xCFBA9599u, 0xB8BDA50Fu,
+    0x2802B89Eu, 0x5F058808u, 0xC60CD9B2u, 0xB10BE924u, 0x2F6F7C87u, 0x58684C11u, 0xC1611DABu, 0xB6662D3Du,
+    0x76DC4190u, 0x01DB7106u, 0x98D220BCu, 0xEFD5102Au, 0x71B18589u, 0x06B6B51Fu, 0x9FBFE4A5u, 0xE8B8D433u,
+    0x7807C9A2u, 0x0F00F934u, 0x9609A88Eu, 0xE10E9818u, 0x7F6A0DBBu, 0x086D3D2Du, 0x91646C97u, 0xE6635C01u,
+    0x6B6B51F4u, 0x1C6C6162u, 0x856530D8u, 0xF262004Eu, 0x6C0695EDu, 0x1B01A57Bu, 0x8208F4C1u, 0xF50FC457u,
+    0x65B0D9C6u, 0x12B7E950u, 0x8BBEB8EAu, 0xFCB9887Cu, 0x62DD1DDFu, 0x15DA2D49u, 0x8CD37CF3u, 0xFBD44C65u,
+    0x4DB26158u, 0x3AB551CEu, 0xA3BC0074u, 0xD4BB30E2u, 0x4ADFA541u, 0x3DD895D7u, 0xA4D1C46Du, 0xD3D6F4FBu,
+    0x4369E96Au, 0x346ED9FCu, 0xAD678846u, 0xDA60B8D0u, 0x44042D73u, 0x33031DE5u, 0xAA0A4C5Fu, 0xDD0D7CC9u,
+    0x5005713Cu, 0x270241AAu, 0xBE0B1010u, 0xC90C2086u, 0x5768B525u, 0x206F85B3u, 0xB966D409u, 0xCE61E49Fu,
+    0x5EDEF90Eu, 0x29D9C998u, 0xB0D09822u, 0xC7D7A8B4u, 0x59B33D17u, 0x2EB40D81u, 0xB7BD5C3Bu, 0xC0BA6CADu,
+    0xEDB88320u, 0x9ABFB3B6u, 0x03B6E20Cu, 0x74B1D29Au, 0xEAD54739u, 0x9DD277AFu, 0x04DB2615u, 0x73DC1683u,
+    0xE3630B12u, 0x94643B84u, 0x0D6D6A3Eu, 0x7A6A5AA8u, 0xE40ECF0Bu, 0x9309FF9Du, 0x0A00AE27u, 0x7D079EB1u,
+    0xF00F9344u, 0x8708A3D2u, 0x1E01F268u, 0x6906C2FEu, 0xF762575Du, 0x806567CBu, 0x196C3671u, 0x6E6B06E7u,
+    0xFED41B76u, 0x89D32BE0u, 0x10DA7A5Au, 0x67DD4ACCu, 0xF9B9DF6Fu, 0x8EBEEFF9u, 0x17B7BE43u, 0x60B08ED5u,
+    0xD6D6A3E8u, 0xA1D1937Eu, 0x38D8C2C4u, 0x4FDFF252u, 0xD1BB67F1u, 0xA6BC5767u, 0x3FB506DDu, 0x48B2364Bu,
+    0xD80D2BDAu, 0xAF0A1B4Cu, 0x36034AF6u, 0x41047A60u, 0xDF60EFC3u, 0xA867DF55u, 0x316E8EEFu, 0x4669BE79u,
+    0xCB61B38Cu, 0xBC66831Au, 0x256FD2A0u, 0x5268E236u, 0xCC0C7795u, 0xBB0B4703u, 0x220216B9u, 0x5505262Fu,
+    0xC5BA3BBEu, 0xB2BD0B28u, 0x2BB45A92u, 0x5CB36A04u, 0xC2D7FFA7u, 0xB5D0CF31u, 0x2CD99E8Bu, 0x5BDEAE1Du,
+    0x9B64C2B0u, 0xEC63F226u, 0x756AA39Cu, 0x026D930Au, 0x9C0906A9u, 0xEB0E363Fu, 0x72076785u, 0x05005713u,
+    0x95BF4A82u, 0xE2B87A14u, 0x7BB12BAEu, 0x0CB61B38u, 0x92D28E9Bu, 0xE5D5BE0Du, 0x7CDCEFB7u, 0x0BDBDF21u,
+    0x86D3D2D4u, 0xF1D4E242u, 0x68DDB3F8u, 0x1FDA836Eu, 0x81BE16CDu, 0xF6B9265Bu, 0x6FB077E1u, 0x18B74777u,
+    0x88085AE6u, 0xFF0F6A70u, 0x66063BCAu, 0x11010B5Cu, 0x8F659EFFu, 0xF862AE69u, 0x616BFFD3u, 0x166CCF45u,
+    0xA00AE278u, 0xD70DD2EEu, 0x4E048354u, 0x3903B3C2u, 0xA7672661u, 0xD06016F7u, 0x4969474Du, 0x3E6E77DBu,
+    0xAED16A4Au, 0xD9D65ADCu, 0x40DF0B66u, 0x37D83BF0u, 0xA9BCAE53u, 0xDEBB9EC5u, 0x47B2CF7Fu, 0x30B5FFE9u,
+    0xBDBDF21Cu, 0xCABAC28Au, 0x53B39330u, 0x24B4A3A6u, 0xBAD03605u, 0xCDD70693u, 0x54DE5729u, 0x23D967BFu,
+    0xB3667A2Eu, 0xC4614AB8u, 0x5D681B02u, 0x2A6F2B94u, 0xB40BBE37u, 0xC30C8EA1u, 0x5A05DF1Bu, 0x2D02EF8Du,
+};
+
+// Call with crc = 0 to start.
+uint32_t nn_crc32(uint32_t crc, const uint8_t *data, size_t n)
+{
+    crc = ~crc;
+    while (n--)
+        crc = nn_crc32__table[(crc ^ *data++) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+static void nn_image__be32(uint8_t *p, uint32_t v)
+{
+    p[0] = (uint8_t)(v >> 24);
+    p[1] = (uint8_t)(v >> 16);
+    p[2] = (uint8_t)(v >> 8);
+    p[3] = (uint8_t)v;
+}
+
+static int nn_image__chunk(FILE *fp, const char *type, const uint8_t *data, size_t n)
+{
+    uint8_t hdr[8], crc_be[4];
+    nn_image__be32(hdr, (uint32_t)n);
+    memcpy(hdr + 4, type, 4);
+    uint32_t crc = nn_crc32(nn_crc32(0, hdr + 4, 4), data, n);
+    nn_image__be32(crc_be, crc);
+    return fwrite(hdr, 1, 8, fp) == 8 && (n == 0 || fwrite(data, 1, n, fp) == n) && fwrite(crc_be, 1, 4, fp) == 4;
+}
+
+// Writes out whatever the compressor has produced as IDAT chunks.
+static void nn_image__drain(nn_image_writer *w)
+{
+    if (w->z.out_len == 0) return;
+    if (!nn_image__chunk(w->fp, "IDAT", w->z.out, w->z.out_len)) w->ok = 0;
+    w->z.out_len = 0;
+}
+
+// PNG signature and IHDR for an 8-bit image with comp channels.
+static int nn_image__png_header(FILE *fp, int width, int height, int comp)
+{
+    static const uint8_t color_type[] = {0, 0, 4, 2, 6};
+    uint8_t ihdr[13];
+    nn_image__be32(ihdr, (uint32_t)width);
+    nn_image__be32(ihdr + 4, (uint32_t)height);
+    ihdr[8] = 8; // bit depth
+    ihdr[9] = color_type[comp];
+    ihdr[10] = ihdr[11] = ihdr[12] = 0; // deflate, adaptive filtering, no interlace
+    return fwrite("\x89PNG\r\n\x1a\n", 1, 8, fp) == 8 && nn_image__chunk(fp, "IHDR", ihdr, sizeof(ihdr));
+}
+
+static int nn_image__paeth(int a, int b, int c)
+{
+    int p = a + b - c, pa = abs(p - a), pb = abs(p - b), pc = abs(p - c);
+    if (pa <= pb && pa <= pc) return a;
+    return pb <= pc ? b : c;
+}
+
+// Filters one row with filter type f (0 none, 1 sub, 2 up, 3 average, 4 Paeth) into dst (filter byte + data).
+static void nn_image__filter(uint8_t *dst, const uint8_t *row, const uint8_t *prev, int n, int bpp, int f)
+{
+    dst[0] = (uint8_t)f;
+    for (int i = 0; i < n; i++)
+    {
+        int a = i >= bpp ? row[i - bpp] : 0, b = prev[i], c = i >= bpp ? prev[i - bpp] : 0;
+        int pred = f == 1 ? a : f == 2 ? b : f == 3 ? (a + b) >> 1 : f == 4 ? nn_image__paeth(a, b, c) : 0;
+        dst[1 + i] = (uint8_t)(row[i] - pred);
+    }
+}
+
+// Picks the filter PNG encoders usually pick: the one whose output has the smallest sum of |signed byte|.
+// The fast level always uses Paeth, which suits smooth renders. filt has room for 5 filtered rows.
+static const uint8_t *nn_image__filter_row(uint8_t *filt, const uint8_t *row, const uint8_t *prev, int n, int bpp, int level)
+{
+    if (level <= NN_IMAGE_LEVEL_FAST)
+    {
+        nn_image__filter(filt, row, prev, n, bpp, 4);
+        return filt;
+    }
+    int best = 0;
+    long best_sum = -1;
+    for (int f = 0; f < 5; f++)
+    {
+        uint8_t *dst = filt + (size_t)f * (n + 1);
+        nn_image__filter(dst, row, prev, n, bpp, f);
+        long sum = 0;
+        for (int i = 1; i <= n; i++)
+            sum += abs((int8_t)dst[i]);
+        if (best_sum < 0 || sum < best_sum)
+        {
+            best_sum = sum;
+            best = f;
+        }
+    }
+    return filt + (size_t)best * (n + 1);
+}
+
+// Opens path for a width x height image with comp channels (1 gray, 2 gray+alpha, 3 RGB, 4 RGBA).
+// level only matters for PNG: NN_IMAGE_LEVEL_FAST .. 9.
+int nn_image_open(nn_image_writer *w, const char *path, int width, int height, int comp, int level)
+{
+    memset(w, 0, sizeof(*w));
+    NN_ASSERT(width > 0 && height > 0 && comp >= 1 && comp <= 4);
+    const char *ext = strrchr(path, '.');
+    w->format = ext && (strcmp(ext, ".png") == 0 || strcmp(ext, ".PNG") == 0) ? NN_IMAGE_PNG
+              : ext && (strcmp(ext, ".pgm") == 0 || strcmp(ext, ".ppm") == 0) ? NN_IMAGE_PNM
+              : NN_IMAGE_RAW;
+    if (w->format == NN_IMAGE_PNM && comp != 1 && comp != 3)
+    {
+        fprintf(stderr, "%s: PGM/PPM needs 1 or 3 channels, not %d\n", path, comp);
+        return 0;
+    }
+    w->w = width;
+    w->h = height;
+    w->comp = comp;
+    w->level = level;
+    w->ok = 1;
+    w->fp = fopen(path, "wb");
+    if (!w->fp)
+    {
+        fprintf(stderr, "Could not open %s for writing\n", path);
+        return 0;
+    }
+
+    if (w->format == NN_IMAGE_PNM)
+    {
+        fprintf(w->fp, "P%c\n%d %d\n255\n", comp == 1 ? '5' : '6', width, height);
+    }
+    else if (w->format == NN_IMAGE_PNG)
+    {
+        size_t n = (size_t)width * comp;
+        w->prev = calloc(n, 1);
+        w->filt = malloc(5 * (n + 1));
+        if (!w->prev || !w->filt || !nn_deflate_init(&w->z, level))
+        {
+            fclose(w->fp);
+            free(w->prev);
+            free(w->filt);
+            memset(w, 0, sizeof(*w));
+            return 0;
+        }
+        w->ok = nn_image__png_header(w->fp, width, height, comp);
+    }
+    return w->ok;
+}
+
+// Appends count rows (each width*comp bytes, `stride` bytes apart). Rows beyond the image height are an error.
+int nn_image_write_rows(nn_image_writer *w, const uint8_t *rows, int count, int stride)
+{
+    if (!w->fp || w->rows + count > w->h)
+    {
+        w->ok = 0;
+        return 0;
+    }
+    size_t n = (size_t)w->w * w->comp;
+    for (int r = 0; r < count && w->ok; r++)
+    {
+        const uint8_t *row = rows + (size_t)r * stride;
+        if (w->format == NN_IMAGE_PNG)
+        {
+            nn_deflate_push(&w->z, nn_image__filter_row(w->filt, row, w->prev, (int)n, w->comp, w->level), n + 1);
+            memcpy(w->prev, row, n);
+            if (w->z.out_len >= 65536) nn_image__drain(w);
+        }
+        else if (fwrite(row, 1, n, w->fp) != n)
+            w->ok = 0;
+    }
+    w->rows += count;
+    return w->ok;
+}
+
+// Finishes the file. Returns 1 only if every row was written and nothing failed along the way.
+int nn_image_close(nn_image_writer *w)
+{
+    if (!w->fp) return 0;
+    int ok = w->ok && w->rows == w->h;
+    if (w->format == NN_IMAGE_PNG)
+    {
+        if (ok)
+        {
+            nn_deflate_flush(&w->z, 1);
+            nn_image__drain(w);
+            ok = w->ok && nn_image__chunk(w->fp, "IEND", NULL, 0);
+        }
+        nn_deflate_free(&w->z);
+        free(w->prev);
+        free(w->filt);
+    }
+    if (fclose(w->fp) != 0) ok = 0;
+    memset(w, 0, sizeof(*w));
+    return ok;
+}
+
+int nn_png_compression_level = NN_IMAGE_LEVEL_DEFAULT;
+
+typedef struct
+{
+    uint8_t *out; // raw deflate data ending in a sync flush
+    size_t len;
+    uint32_t adler; // of this band's filtered bytes alone
+    size_t raw_len;
+} nn_png__band;
+
+// Writes an in-memory image like stbi_write_png(path, w, h, comp, data, stride). Returns 1 on success, 0 on failure.
+int nn_png_write(const char *path, int w, int h, int comp, const void *data, int stride)
+{
+    if (w <= 0 || h <= 0 || comp < 1 || comp > 4) return 0;
+    int level = nn_png_compression_level;
+    size_t n = (size_t)w * comp;
+    int band_rows = (int)(NN_PNG_BAND_BYTES / (n + 1)) + 1;
+    int band_count = (h + band_rows - 1) / band_rows;
+    nn_png__band *bands = calloc(band_count, sizeof(nn_png__band));
+    uint8_t *zero = calloc(n, 1);
+    if (!bands || !zero)
+    {
+        free(bands);
+        free(zero);
+        return 0;
+    }
+    const uint8_t *pixels = data;
+    int failed = 0;
+
+    // Bands only share read-only pixels: the row above a band's first row is still available for the Up/Average/Paeth filters,
+    // so the filtered bytes are exactly what a single-threaded encoder would produce.
+#pragma omp parallel
+    {
+        uint8_t *filt = malloc(5 * (n + 1));
+#pragma omp for schedule(dynamic)
+        for (int b = 0; b < band_count; b++)
+        {
+            nn_deflate d;
+            if (!filt || !nn_deflate__init(&d, level, b == 0))
+            {
+#pragma omp atomic write
+                failed = 1;
+                continue;
+            }
+            int y0 = b * band_rows, y1 = y0 + band_rows < h ? y0 + band_rows : h;
+            for (int y = y0; y < y1; y++)
+            {
+                const uint8_t *row = pixels + (size_t)y * stride;
+                const uint8_t *prev = y > 0 ? row - stride : zero;
+                nn_deflate_push(&d, nn_image__filter_row(filt, row, prev, (int)n, comp, level), n + 1);
+            }
+            nn_deflate_flush(&d, 0);
+            bands[b].out = d.out;
+            bands[b].len = d.out_len;
+            bands[b].adler = d.adler;
+            bands[b].raw_len = (size_t)(y1 - y0) * (n + 1);
+            d.out = NULL;
+            nn_deflate_free(&d);
+        }
+        free(filt);
+    }
+
+    FILE *fp = failed ? NULL : fopen(path, "wb");
+    int ok = fp != NULL && nn_image__png_header(fp, w, h, comp);
+    uint32_t adler = 1;
+    for (int b = 0; b < band_count; b++)
+    {
+        ok = ok && nn_image__chunk(fp, "IDAT", bands[b].out, bands[b].len);
+        adler = nn_adler32_combine(adler, bands[b].adler, bands[b].raw_len);
+        free(bands[b].out);
+    }
+    // Every band ended byte-aligned on a sync flush, so the stream is closed with an empty final fixed block and the checksum.
+    uint8_t tail[6] = {0x03, 0x00};
+    nn_image__be32(tail + 2, adler);
+    ok = ok && nn_image__chunk(fp, "IDAT", tail, sizeof(tail)) && nn_image__chunk(fp, "IEND", NULL, 0);
+    if (fp && fclose(fp) != 0) ok = 0;
+    if (!ok && fp) remove(path);
+    free(bands);
+    free(zero);
+    return ok;
+}
+
+#endif // NN_IMAGE_IMPLEMENTATION
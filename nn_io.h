@@ -0,0 +1,392 @@
+#ifndef NN_IO_H
+#define NN_IO_H
+
+// Self-describing model files for nn.h networks.
+//
+// Layout (all integers in the byte order recorded in `endian`):
+//
+//   nn_file_header            64 bytes, fixed
+//   uint32_t arch[layers]     layer widths, input first
+//   uint8_t  act[layers - 1]  activation of every non-input layer (NN_ACT_*)
+//   zero padding              up to header.payload_offset, a multiple of header.align
+//   float    params[param_count]   the nn parameter arena: w[0], b[0], w[1], b[1], ...
+//
+// `checksum` is FNV-1a 64 over the whole file with the checksum field itself zeroed.
+// nn_load allocates the net from the stored architecture and freads the payload straight into net.params, so a file can
+// never be loaded into the wrong architecture. Files written on a machine of the other endianness are byte-swapped on load.
+//
+// nn_load_raw reads the old headerless model.dat dumps, but only if the file size matches the given architecture exactly.
+//
+// nn_map_file / nn_unmap_file map a whole file read-only (mmap, or a file mapping on Windows) for zero-copy readers such as nn_bundle.h.
+//
+//   #define NN_IMPLEMENTATION
+//   #include "nn.h"
+//   #define NN_IO_IMPLEMENTATION
+//   #include "nn_io.h"
+
+#include <stdint.h>
+
+#define NN_FILE_MAGIC "NNMF"
+#define NN_FILE_VERSION 1u
+#define NN_FILE_ENDIAN 0x01020304u
+#define NN_FILE_ALIGN 64u
+
+#define NN_DTYPE_F32 1u
+
+#define NN_ACT_SIGMOID 1u
+
+#define NN_CHECKSUM_INIT 0xCBF29CE484222325ull
+
+typedef struct
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t endian;
+    uint32_t dtype;
+    uint32_t layers; // arch_count
+    uint32_t align;
+    uint32_t payload_offset;
+    uint32_t reserved;
+    uint64_t param_count;
+    uint64_t checksum;
+    uint8_t pad[16];
+} nn_file_header;
+
+typedef struct
+{
+    const void *data;
+    size_t size;
+    void *handle; // platform specific, NULL when nothing is mapped
+} nn_mapping;
+
+int nn_save(const char *path, nn net);
+size_t nn_write(FILE *fp, nn net);
+int nn_load(const char *path, nn *net);
+int nn_read(FILE *fp, const char *path, nn *net);
+int nn_load_raw(const char *path, int *arch, int arch_count, nn *net);
+int nn_file_has_magic(const char *path);
+uint64_t nn_checksum(uint64_t h, const void *data, size_t n);
+int nn_file_check_header(const char *path, nn_file_header *hdr, int *swap);
+int nn_file_check_arch(const char *path, nn_file_header hdr, const uint8_t *meta, int swap, int *arch);
+int nn_map_file(const char *path, nn_mapping *m);
+void nn_unmap_file(nn_mapping *m);
+
+#endif // NN_IO_H
+
+#ifdef NN_IO_IMPLEMENTATION
+
+#include <string.h>
+
+uint64_t nn_checksum(uint64_t h, const void *data, size_t n)
+{
+    const uint8_t *p = data;
+    for (size_t i = 0; i < n; i++)
+    {
+        h ^= p[i];
+        h *= 0x100000001B3ull;
+    }
+    return h;
+}
+
+static uint32_t nn_io__swap32(uint32_t v)
+{
+    return (v >> 24) | ((v >> 8) & 0xFF00u) | ((v << 8) & 0xFF0000u) | (v << 24);
+}
+
+static uint64_t nn_io__swap64(uint64_t v)
+{
+    return ((uint64_t)nn_io__swap32((uint32_t)v) << 32) | nn_io__swap32((uint32_t)(v >> 32));
+}
+
+static uint32_t nn_io__payload_offset(uint32_t layers)
+{
+    uint32_t off = sizeof(nn_file_header) + layers * sizeof(uint32_t) + (layers - 1);
+    return (off + NN_FILE_ALIGN - 1) / NN_FILE_ALIGN * NN_FILE_ALIGN;
+}
+
+// Writes one model record (header, arch, padding, parameters) at the current position of fp.
+// The payload is aligned relative to the start of the record, so callers embedding records should start them on an NN_FILE_ALIGN boundary.
+// Returns the number of bytes written, 0 on failure.
+size_t nn_write(FILE *fp, nn net)
+{
+    uint32_t layers = net.count + 1;
+    nn_file_header hdr = {
+        .magic = {'N', 'N', 'M', 'F'},
+        .version = NN_FILE_VERSION,
+        .endian = NN_FILE_ENDIAN,
+        .dtype = NN_DTYPE_F32,
+        .layers = layers,
+        .align = NN_FILE_ALIGN,
+        .payload_offset = nn_io__payload_offset(layers),
+        .param_count = net.param_count,
+    };
+
+    // Everything between the fixed header and the payload: arch, activations, padding.
+    size_t meta_size = hdr.payload_offset - sizeof(hdr);
+    uint8_t *meta = calloc(meta_size, 1);
+    if (!meta) return 0;
+    for (uint32_t i = 0; i < layers; i++)
+    {
+        uint32_t width = NN_INPUT_MAT(net).cols;
+        if (i > 0) width = net.w[i - 1].cols;
+        memcpy(meta + i * sizeof(uint32_t), &width, sizeof(width));
+    }
+    memset(meta + layers * sizeof(uint32_t), NN_ACT_SIGMOID, layers - 1);
+
+    uint64_t h = NN_CHECKSUM_INIT;
+    h = nn_checksum(h, &hdr, sizeof(hdr));
+    h = nn_checksum(h, meta, meta_size);
+    h = nn_checksum(h, net.params, sizeof(float) * net.param_count);
+    hdr.checksum = h;
+
+    int ok = fwrite(&hdr, sizeof(hdr), 1, fp) == 1
+          && fwrite(meta, 1, meta_size, fp) == meta_size
+          && fwrite(net.params, sizeof(float), net.param_count, fp) == net.param_count;
+    free(meta);
+    return ok ? hdr.payload_offset + sizeof(float) * net.param_count : 0;
+}
+
+int nn_save(const char *path, nn net)
+{
+    FILE *fp = fopen(path, "wb");
+    if (!fp) return 0;
+    int ok = nn_write(fp, net) != 0;
+    if (fclose(fp) != 0) ok = 0;
+    if (!ok) remove(path);
+    return ok;
+}
+
+#define NN_IO_FAIL(...) do { fprintf(stderr, "%s: ", path); fprintf(stderr, __VA_ARGS__); fputc('\n', stderr); goto fail; } while (0)
+
+// Validates a fixed header as read from disk and converts it to native byte order. *swap tells whether the rest of the record needs swapping.
+int nn_file_check_header(const char *path, nn_file_header *hdr, int *swap)
+{
+    if (memcmp(hdr->magic, NN_FILE_MAGIC, 4) != 0) NN_IO_FAIL("not an nn model file (bad magic)");
+    *swap = hdr->endian == nn_io__swap32(NN_FILE_ENDIAN);
+    if (!*swap && hdr->endian != NN_FILE_ENDIAN) NN_IO_FAIL("unknown byte order marker 0x%08x", hdr->endian);
+    if (*swap)
+    {
+        hdr->version = nn_io__swap32(hdr->version);
+        hdr->dtype = nn_io__swap32(hdr->dtype);
+        hdr->layers = nn_io__swap32(hdr->layers);
+        hdr->align = nn_io__swap32(hdr->align);
+        hdr->payload_offset = nn_io__swap32(hdr->payload_offset);
+        hdr->param_count = nn_io__swap64(hdr->param_count);
+        hdr->checksum = nn_io__swap64(hdr->checksum);
+    }
+    if (hdr->version != NN_FILE_VERSION) NN_IO_FAIL("unsupported version %u", hdr->version);
+    if (hdr->dtype != NN_DTYPE_F32) NN_IO_FAIL("unsupported dtype %u", hdr->dtype);
+    if (hdr->layers < 2 || hdr->layers > 1024) NN_IO_FAIL("bad layer count %u", hdr->layers);
+    if (hdr->align == 0 || hdr->payload_offset % hdr->align != 0
+        || hdr->payload_offset < sizeof(*hdr) + hdr->layers * sizeof(uint32_t) + (hdr->layers - 1))
+        NN_IO_FAIL("bad payload offset %u", hdr->payload_offset);
+    return 1;
+fail:
+    return 0;
+}
+
+// Decodes the arch/activation block that follows a checked header into arch[hdr.layers] and checks it against param_count.
+int nn_file_check_arch(const char *path, nn_file_header hdr, const uint8_t *meta, int swap, int *arch)
+{
+    uint64_t expected = 0;
+    for (uint32_t i = 0; i < hdr.layers; i++)
+    {
+        uint32_t width;
+        memcpy(&width, meta + i * sizeof(uint32_t), sizeof(width));
+        if (swap) width = nn_io__swap32(width);
+        if (width == 0 || width > (1u << 20)) NN_IO_FAIL("bad width %u for layer %u", width, i);
+        arch[i] = (int)width;
+        if (i > 0) expected += (uint64_t)arch[i - 1] * arch[i] + arch[i];
+        if (i > 0 && meta[hdr.layers * sizeof(uint32_t) + i - 1] != NN_ACT_SIGMOID)
+            NN_IO_FAIL("unsupported activation %u on layer %u", meta[hdr.layers * sizeof(uint32_t) + i - 1], i);
+    }
+    if (expected != hdr.param_count) NN_IO_FAIL("parameter count %llu does not match architecture (%llu)",
+                                                (unsigned long long)hdr.param_count, (unsigned long long)expected);
+    return 1;
+fail:
+    return 0;
+}
+
+// Reads one model record (as written by nn_write) from the current position of fp into a freshly allocated net.
+// `path` is only used in error messages. Returns 0 (with a message on stderr) if the record is not a valid model.
+int nn_read(FILE *fp, const char *path, nn *net)
+{
+    uint8_t *meta = NULL;
+    int *arch = NULL;
+    nn res = {0};
+
+    int swap;
+    nn_file_header hdr;
+    if (fread(&hdr, sizeof(hdr), 1, fp) != 1) NN_IO_FAIL("truncated header");
+    nn_file_header raw = hdr; // as stored, for the checksum
+    if (!nn_file_check_header(path, &hdr, &swap)) goto fail;
+
+    size_t meta_size = hdr.payload_offset - sizeof(hdr);
+    meta = malloc(meta_size);
+    arch = malloc(sizeof(int) * hdr.layers);
+    if (!meta || !arch) NN_IO_FAIL("out of memory");
+    if (fread(meta, 1, meta_size, fp) != meta_size) NN_IO_FAIL("truncated architecture");
+    if (!nn_file_check_arch(path, hdr, meta, swap, arch)) goto fail;
+
+    res = nn_alloc(arch, hdr.layers);
+    if (fread(res.params, sizeof(float), res.param_count, fp) != res.param_count) NN_IO_FAIL("truncated parameters");
+
+    raw.checksum = 0;
+    uint64_t h = NN_CHECKSUM_INIT;
+    h = nn_checksum(h, &raw, sizeof(raw));
+    h = nn_checksum(h, meta, meta_size);
+    h = nn_checksum(h, res.params, sizeof(float) * res.param_count);
+    if (h != hdr.checksum) NN_IO_FAIL("checksum mismatch, file is corrupted");
+
+    if (swap)
+    {
+        uint32_t *p = (uint32_t *)res.params;
+        for (size_t i = 0; i < res.param_count; i++)
+            p[i] = nn_io__swap32(p[i]);
+    }
+
+    free(meta);
+    free(arch);
+    *net = res;
+    return 1;
+
+fail:
+    free(meta);
+    free(arch);
+    if (res.params) nn_free(res);
+    return 0;
+}
+
+// Loads a model saved by nn_save into a freshly allocated net. Returns 0 (with a message on stderr) if the file is not a valid model.
+int nn_load(const char *path, nn *net)
+{
+    FILE *fp = fopen(path, "rb");
+    if (!fp)
+    {
+        fprintf(stderr, "%s: cannot open model file\n", path);
+        return 0;
+    }
+    nn res;
+    int ok = nn_read(fp, path, &res);
+    if (ok && fgetc(fp) != EOF)
+    {
+        fprintf(stderr, "%s: trailing bytes after parameters\n", path);
+        nn_free(res);
+        ok = 0;
+    }
+    fclose(fp);
+    if (ok) *net = res;
+    return ok;
+}
+
+// 1 if the file starts with the model magic, 0 if it does not or cannot be read. Prints nothing, so a caller can tell a
+// versioned model from a legacy raw dump before picking the loader whose errors it wants to see.
+int nn_file_has_magic(const char *path)
+{
+    char magic[4];
+    FILE *fp = fopen(path, "rb");
+    if (!fp) return 0;
+    int ok = fread(magic, 1, 4, fp) == 4 && memcmp(magic, NN_FILE_MAGIC, 4) == 0;
+    fclose(fp);
+    return ok;
+}
+
+// Reads a legacy headerless dump (raw w/b floats, the old model.dat) into a net of the given architecture.
+// The file has to be exactly as large as that architecture's parameter set, which catches loading with the wrong arch.
+int nn_load_raw(const char *path, int *arch, int arch_count, nn *net)
+{
+    nn res = nn_alloc(arch, arch_count);
+    FILE *fp = fopen(path, "rb");
+    if (!fp)
+    {
+        fprintf(stderr, "%s: cannot open model file\n", path);
+        nn_free(res);
+        return 0;
+    }
+    size_t n = fread(res.params, sizeof(float), res.param_count, fp);
+    int extra = fgetc(fp) != EOF;
+    fclose(fp);
+    if (n != res.param_count || extra)
+    {
+        fprintf(stderr, "%s: size does not match a %zu-parameter network\n", path, res.param_count);
+        nn_free(res);
+        return 0;
+    }
+    *net = res;
+    return 1;
+}
+
+#undef NN_IO_FAIL
+
+#ifdef _WIN32
+#include <windows.h>
+
+int nn_map_file(const char *path, nn_mapping *m)
+{
+    memset(m, 0, sizeof(*m));
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) return 0;
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+    {
+        CloseHandle(file);
+        return 0;
+    }
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(file);
+    if (!mapping) return 0;
+    const void *data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!data)
+    {
+        CloseHandle(mapping);
+        return 0;
+    }
+    m->data = data;
+    m->size = (size_t)size.QuadPart;
+    m->handle = mapping;
+    return 1;
+}
+
+void nn_unmap_file(nn_mapping *m)
+{
+    if (!m->handle) return;
+    UnmapViewOfFile(m->data);
+    CloseHandle(m->handle);
+    memset(m, 0, sizeof(*m));
+}
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Maps a whole file read-only and shared, so every process mapping the same file uses the same page-cache pages.
+int nn_map_file(const char *path, nn_mapping *m)
+{
+    memset(m, 0, sizeof(*m));
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return 0;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0)
+    {
+        close(fd);
+        return 0;
+    }
+    void *data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) return 0;
+    m->data = data;
+    m->size = (size_t)st.st_size;
+    m->handle = data;
+    return 1;
+}
+
+void nn_unmap_file(nn_mapping *m)
+{
+    if (!m->handle) return;
+    munmap((void *)m->data, m->size);
+    memset(m, 0, sizeof(*m));
+}
+#endif
+
+#endif // NN_IO_IMPLEMENTATION
@@ -0,0 +1,324 @@
+#ifndef NN_LOADER_H
+#define NN_LOADER_H
+
+// Prefetching sample loader: worker threads prepare the next few training samples (decode, validate, convert to float)
+// while the trainer is busy with the current one.
+//
+// The loader owns `depth` slots, each with preallocated tin/tout matrices. Sample i is always prepared in slot i % depth and
+// handed to the trainer in index order, so results do not depend on thread timing. nn_loader_next gives the trainer a pointer
+// to the slot itself (no copy); the slot goes back to the workers on the following nn_loader_next call, so with depth 2 this
+// is plain double buffering and larger depths read further ahead.
+//
+// The fill callback gets a per-worker nn_arena that is reset before every sample. Defining the stb_image allocation hooks
+// below routes stbi's decode buffers into it, so steady-state decoding does no malloc/free at all:
+//
+//   #define NN_IMPLEMENTATION
+//   #include "nn.h"
+//   #define NN_LOADER_IMPLEMENTATION
+//   #include "nn_loader.h"
+//   #define STBI_MALLOC(sz) nn_arena_stbi_malloc(sz)
+//   #define STBI_REALLOC_SIZED(p, oldsz, newsz) nn_arena_stbi_realloc(p, oldsz, newsz)
+//   #define STBI_FREE(p) nn_arena_stbi_free(p)
+//   #define STB_IMAGE_IMPLEMENTATION
+//   #include "stb_image.h"
+//
+// Outside a fill callback (no arena active) the hooks fall back to malloc/realloc/free. Link with -lpthread.
+
+#include <pthread.h>
+
+#if defined(_MSC_VER)
+#define NN_THREAD_LOCAL __declspec(thread)
+#else
+#define NN_THREAD_LOCAL _Thread_local
+#endif
+
+// Bump allocator over one block. Allocations that do not fit go to malloc and the block is grown to the high-water mark on
+// the next reset, so after the first few samples everything fits.
+typedef struct
+{
+    uint8_t *base;
+    size_t size;
+    size_t used;
+    size_t last; // offset of the most recent allocation, which realloc can grow in place
+    size_t spill; // bytes that went to malloc since the last reset
+} nn_arena;
+
+void *nn_arena_alloc(nn_arena *a, size_t size);
+void *nn_arena_realloc(nn_arena *a, void *p, size_t old_size, size_t size);
+void nn_arena_free(nn_arena *a, void *p);
+void nn_arena_reset(nn_arena *a);
+void nn_arena_release(nn_arena *a);
+
+void *nn_arena_stbi_malloc(size_t size);
+void *nn_arena_stbi_realloc(void *p, size_t old_size, size_t size);
+void nn_arena_stbi_free(void *p);
+
+// Fills tin/tout (tin.rows rows available) for sample `index`. Returns the number of rows filled, or 0 to skip the sample.
+typedef int (*nn_loader_fn)(void *user, int index, mat tin, mat tout, nn_arena *arena);
+
+typedef struct
+{
+    int index; // sample number as passed to the fill callback
+    mat tin, tout; // rows trimmed to what the callback filled
+    int turn; // next index allowed into this slot
+    int state;
+} nn_loader_item;
+
+typedef struct
+{
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    pthread_t *threads;
+    nn_arena *arenas;
+    int thread_count;
+    nn_loader_item *slots;
+    int depth;
+    int rows;
+    int count;
+    int next_claim;
+    int next_consume;
+    nn_loader_item *held;
+    int quit;
+    nn_loader_fn fill;
+    void *user;
+} nn_loader;
+
+int nn_loader_start(nn_loader *l, int count, int depth, int threads, int rows, int in_cols, int out_cols, nn_loader_fn fill, void *user);
+nn_loader_item *nn_loader_next(nn_loader *l);
+void nn_loader_stop(nn_loader *l);
+
+#endif // NN_LOADER_H
+
+#ifdef NN_LOADER_IMPLEMENTATION
+
+#include <string.h>
+
+#define NN_ARENA_ALIGN 16u
+
+static NN_THREAD_LOCAL nn_arena *nn_arena__current;
+
+static int nn_arena__owns(const nn_arena *a, const void *p)
+{
+    return a && a->base && (const uint8_t *)p >= a->base && (const uint8_t *)p < a->base + a->size;
+}
+
+void *nn_arena_alloc(nn_arena *a, size_t size)
+{
+    size_t start = (a->used + NN_ARENA_ALIGN - 1) & ~(size_t)(NN_ARENA_ALIGN - 1);
+    if (a->base && start + size <= a->size)
+    {
+        a->last = start;
+        a->used = start + size;
+        return a->base + start;
+    }
+    a->spill += size;
+    return malloc(size);
+}
+
+void *nn_arena_realloc(nn_arena *a, void *p, size_t old_size, size_t size)
+{
+    if (!p) return nn_arena_alloc(a, size);
+    if (!nn_arena__owns(a, p)) return realloc(p, size);
+    size_t off = (size_t)((uint8_t *)p - a->base);
+    if (off == a->last && off + size <= a->size)
+    {
+        a->used = off + size;
+        return p;
+    }
+    void *q = nn_arena_alloc(a, size);
+    if (q) memcpy(q, p, old_size < size ? old_size : size);
+    return q;
+}
+
+// Arena memory is only reclaimed by nn_arena_reset; spilled blocks are freed right away.
+void nn_arena_free(nn_arena *a, void *p)
+{
+    if (p && !nn_arena__owns(a, p)) free(p);
+}
+
+void nn_arena_reset(nn_arena *a)
+{
+    if (a->spill > 0)
+    {
+        size_t want = a->used + a->spill + NN_ARENA_ALIGN * 64;
+        want += want / 2;
+        free(a->base);
+        a->base = malloc(want);
+        NN_ASSERT(a->base != NULL);
+        a->size = want;
+    }
+    a->used = a->last = a->spill = 0;
+}
+
+void nn_arena_release(nn_arena *a)
+{
+    free(a->base);
+    memset(a, 0, sizeof(*a));
+}
+
+void *nn_arena_stbi_malloc(size_t size)
+{
+    return nn_arena__current ? nn_arena_alloc(nn_arena__current, size) : malloc(size);
+}
+
+void *nn_arena_stbi_realloc(void *p, size_t old_size, size_t size)
+{
+    return nn_arena__current ? nn_arena_realloc(nn_arena__current, p, old_size, size) : realloc(p, size);
+}
+
+void nn_arena_stbi_free(void *p)
+{
+    if (nn_arena__current) nn_arena_free(nn_arena__current, p);
+    else free(p);
+}
+
+enum { NN_LOADER_FREE, NN_LOADER_FILLING, NN_LOADER_READY, NN_LOADER_SKIP };
+
+typedef struct
+{
+    nn_loader *l;
+    int id;
+} nn_loader__arg;
+
+static void *nn_loader__worker(void *arg)
+{
+    nn_loader__arg a = *(nn_loader__arg *)arg;
+    free(arg);
+    nn_loader *l = a.l;
+    nn_arena *arena = &l->arenas[a.id];
+    nn_arena__current = arena;
+
+    pthread_mutex_lock(&l->lock);
+    while (!l->quit && l->next_claim < l->count)
+    {
+        int i = l->next_claim++;
+        nn_loader_item *slot = &l->slots[i % l->depth];
+        while (!l->quit && (slot->turn != i || slot->state != NN_LOADER_FREE))
+            pthread_cond_wait(&l->cond, &l->lock);
+        if (l->quit) break;
+        slot->state = NN_LOADER_FILLING;
+        slot->index = i;
+        pthread_mutex_unlock(&l->lock);
+
+        // The slot belongs to this worker until it is marked ready, so it is filled without the lock.
+        nn_arena_reset(arena);
+        mat tin = slot->tin, tout = slot->tout;
+        tin.rows = tout.rows = l->rows;
+        int rows = l->fill(l->user, i, tin, tout, arena);
+        slot->tin.rows = slot->tout.rows = rows;
+
+        pthread_mutex_lock(&l->lock);
+        slot->state = rows > 0 ? NN_LOADER_READY : NN_LOADER_SKIP;
+        pthread_cond_broadcast(&l->cond);
+    }
+    pthread_mutex_unlock(&l->lock);
+    nn_arena__current = NULL;
+    return NULL;
+}
+
+// Starts `threads` workers preparing samples 0..count-1, at most `depth` (>= 2) of them ahead of the trainer.
+int nn_loader_start(nn_loader *l, int count, int depth, int threads, int rows, int in_cols, int out_cols, nn_loader_fn fill, void *user)
+{
+    NN_ASSERT(depth >= 2 && threads >= 1);
+    memset(l, 0, sizeof(*l));
+    l->count = count;
+    l->depth = depth;
+    l->rows = rows;
+    l->fill = fill;
+    l->user = user;
+    l->slots = calloc(depth, sizeof(nn_loader_item));
+    l->threads = calloc(threads, sizeof(pthread_t));
+    l->arenas = calloc(threads, sizeof(nn_arena));
+    NN_ASSERT(l->slots != NULL && l->threads != NULL && l->arenas != NULL);
+    for (int s = 0; s < depth; s++)
+    {
+        l->slots[s].tin = mat_alloc(rows, in_cols);
+        l->slots[s].tout = mat_alloc(rows, out_cols);
+        l->slots[s].turn = s;
+    }
+    pthread_mutex_init(&l->lock, NULL);
+    pthread_cond_init(&l->cond, NULL);
+
+    for (int t = 0; t < threads; t++)
+    {
+        nn_loader__arg *arg = malloc(sizeof(*arg));
+        NN_ASSERT(arg != NULL);
+        arg->l = l;
+        arg->id = t;
+        if (pthread_create(&l->threads[t], NULL, nn_loader__worker, arg) != 0)
+        {
+            free(arg);
+            break;
+        }
+        l->thread_count++;
+    }
+    if (l->thread_count == 0)
+    {
+        nn_loader_stop(l);
+        return 0;
+    }
+    return 1;
+}
+
+static void nn_loader__release(nn_loader *l, nn_loader_item *slot)
+{
+    slot->state = NN_LOADER_FREE;
+    slot->turn += l->depth;
+    pthread_cond_broadcast(&l->cond);
+}
+
+// Returns the next prepared sample in index order, waiting for it if the workers are behind, or NULL when all samples
+// have been handed out. The previous item returned goes back to the workers, so do not hold on to it across calls.
+nn_loader_item *nn_loader_next(nn_loader *l)
+{
+    pthread_mutex_lock(&l->lock);
+    if (l->held)
+    {
+        nn_loader__release(l, l->held);
+        l->held = NULL;
+    }
+    while (l->next_consume < l->count)
+    {
+        int i = l->next_consume;
+        nn_loader_item *slot = &l->slots[i % l->depth];
+        while (slot->turn != i || (slot->state != NN_LOADER_READY && slot->state != NN_LOADER_SKIP))
+            pthread_cond_wait(&l->cond, &l->lock);
+        l->next_consume++;
+        if (slot->state == NN_LOADER_SKIP)
+        {
+            nn_loader__release(l, slot);
+            continue;
+        }
+        l->held = slot;
+        break;
+    }
+    nn_loader_item *item = l->held;
+    pthread_mutex_unlock(&l->lock);
+    return item;
+}
+
+// Stops the workers (abandoning samples not yet handed out) and frees the slots.
+void nn_loader_stop(nn_loader *l)
+{
+    pthread_mutex_lock(&l->lock);
+    l->quit = 1;
+    pthread_cond_broadcast(&l->cond);
+    pthread_mutex_unlock(&l->lock);
+    for (int t = 0; t < l->thread_count; t++)
+        pthread_join(l->threads[t], NULL);
+    for (int t = 0; t < l->thread_count; t++)
+        nn_arena_release(&l->arenas[t]);
+    for (int s = 0; s < l->depth; s++)
+    {
+        free(l->slots[s].tin.data);
+        free(l->slots[s].tout.data);
+    }
+    pthread_mutex_destroy(&l->lock);
+    pthread_cond_destroy(&l->cond);
+    free(l->slots);
+    free(l->threads);
+    free(l->arenas);
+    memset(l, 0, sizeof(*l));
+}
+
+#endif // NN_LOADER_IMPLEMENTATION
@@ -0,0 +1,302 @@
+// Thread-scaling study of the parallel trainer in upscaler_fast.c, to pick how many cores a training job should get.
+//
+// Runs upscaler_fast's epoch loop (threads backprop their share of the pixels on private copies of the net, sum their
+// gradients into the shared one in a critical section, then one thread averages and applies them) at 1, 2, 4 ... N
+// threads, on a synthetic image so no dataset is needed, and times every phase of every epoch:
+//
+//   compute   per thread: allocating and copying in its net, and nn_backprop_u8 on its rows
+//   reduce    per thread: waiting for and running the critical section that adds its gradients to the shared ones
+//   serial    zeroing the gradients, averaging them and nn_learn, on one thread between the parallel regions
+//   overhead  the rest of the parallel region's wall time: thread start-up and join, and waiting for the slowest thread
+//
+// Strong scaling keeps the image fixed (speedup t1/tN, efficiency speedup/N). Weak scaling grows the image with the
+// thread count, N times the rows at N threads (efficiency t1/tN, 100% means perfectly flat). Bandwidth is the epoch's
+// compulsory traffic (pixels read, nets copied, gradients reduced and applied) over its time, and utilization is that
+// against a STREAM-style triad measured at the same thread count: near 100% means the trainer is bandwidth bound, and
+// more cores on the same memory will not help.
+//
+//to Run:
+//   gcc nn_scaling.c -o nn_scaling -O2 -fopenmp -lm
+//   ./nn_scaling                              (128x128 image, 30 epochs, 1, 2, 4 ... cores)
+//   ./nn_scaling --size 256 --epochs 50 --max-threads 16 --json scaling.json
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <omp.h>
+
+#define NN_IMPLEMENTATION
+#include "nn.h"
+
+#define NN_BENCH_IMPLEMENTATION
+#include "nn_bench.h"
+
+#define WARMUP_EPOCHS 2
+#define TRIAD_FLOATS  (8 << 20) // 32 MB per array, well past the last-level cache
+#define MAX_THREADS   256
+
+// Per-epoch phase times in seconds, summed over the timed epochs.
+typedef struct
+{
+    double epoch, serial, region; // wall
+    double compute, reduce; // mean over threads
+    double compute_max; // slowest thread
+    nn_bench_stats epoch_ms;
+    double bytes; // compulsory traffic of one epoch
+} run_times;
+
+// Stand-in image in the style of nn_workloads.c's: rings over a gradient.
+static void synth_image(uint8_t *px, int w, int h)
+{
+    for (int y = 0; y < h; y++)
+        for (int x = 0; x < w; x++)
+        {
+            float fx = (float)x / (w - 1), fy = (float)y / (h - 1);
+            float r = sqrtf((fx - 0.4f) * (fx - 0.4f) + (fy - 0.5f) * (fy - 0.5f));
+            float v = 0.5f + 0.35f * cosf(18.0f * r) * expf(-3.0f * r) + 0.15f * (fx - fy);
+            if (v < 0.0f) v = 0.0f;
+            if (v > 1.0f) v = 1.0f;
+            px[y * w + x] = (uint8_t)(v * 255.0f + 0.5f);
+        }
+}
+
+// upscaler_fast.c's train_nn on a w*h image with `threads` threads, instrumented. Returns per-epoch averages.
+static run_times train(int w, int h, int threads, int epochs)
+{
+    int arch[] = {2, 14, 7, 1};
+    int arch_count = ARRAY_LEN(arch);
+    uint8_t *px = malloc((size_t)w * h);
+    NN_ASSERT(px != NULL);
+    synth_image(px, w, h);
+    mat tin = mat_alloc(w * h, 2);
+    for (int i = 0; i < w * h; i++)
+    {
+        MAT_AT(tin, i, 0) = (float)(i % w) / (w - 1);
+        MAT_AT(tin, i, 1) = (float)(i / w) / (h - 1);
+    }
+    mat_u8 tout = {.rows = tin.rows, .cols = 1, .stride = 1, .data = px};
+
+    srand(0);
+    nn net = nn_alloc(arch, arch_count);
+    nn g = nn_alloc(arch, arch_count);
+    nn_rand(net, -1, 1);
+
+    run_times rt;
+    memset(&rt, 0, sizeof(rt));
+    double compute[MAX_THREADS], reduce[MAX_THREADS];
+    double *epoch_ms = malloc(sizeof(*epoch_ms) * epochs);
+    NN_ASSERT(epoch_ms != NULL);
+    omp_set_dynamic(0);
+    omp_set_num_threads(threads);
+
+    for (int epoch = -WARMUP_EPOCHS; epoch < epochs; epoch++)
+    {
+        double t0 = nn_bench_now();
+        nn_init(g, 0.0f);
+        double t1 = nn_bench_now();
+        #pragma omp parallel
+        {
+            int tid = omp_get_thread_num();
+            int rows = tin.rows;
+            int start = (tid * rows) / threads;
+            int end = ((tid + 1) * rows) / threads;
+            int sub_rows = end - start;
+            double c0 = nn_bench_now();
+
+            nn local_g = nn_alloc(arch, arch_count);
+            nn local_net = nn_alloc(arch, arch_count);
+            memcpy(local_net.params, net.params, sizeof(float) * net.param_count);
+            mat sub_tin = {.rows = sub_rows, .cols = tin.cols, .stride = tin.stride, .data = &MAT_AT(tin, start, 0)};
+            mat_u8 sub_tout = {.rows = sub_rows, .cols = 1, .stride = 1, .data = &MAT_U8_AT(tout, start, 0)};
+            nn_backprop_u8(local_net, local_g, sub_tin, sub_tout);
+            double c1 = nn_bench_now();
+
+            #pragma omp critical
+            {
+                for (size_t i = 0; i < g.param_count; i++)
+                    g.params[i] += local_g.params[i] * (float)sub_rows;
+            }
+            double c2 = nn_bench_now();
+            compute[tid] = c1 - c0;
+            reduce[tid] = c2 - c1;
+            nn_free(local_g);
+            nn_free(local_net);
+        }
+        double t2 = nn_bench_now();
+        for (size_t i = 0; i < g.param_count; i++)
+            g.params[i] /= (float)tin.rows;
+        nn_learn(net, g, 1.0f);
+        double t3 = nn_bench_now();
+
+        if (epoch < 0) continue;
+        double csum = 0.0, cmax = 0.0, rsum = 0.0;
+        for (int t = 0; t < threads; t++)
+        {
+            csum += compute[t];
+            rsum += reduce[t];
+            if (compute[t] > cmax) cmax = compute[t];
+        }
+        rt.epoch += t3 - t0;
+        rt.serial += (t1 - t0) + (t3 - t2);
+        rt.region += t2 - t1;
+        rt.compute += csum / threads;
+        rt.compute_max += cmax;
+        rt.reduce += rsum / threads;
+        epoch_ms[epoch] = (t3 - t0) * 1e3;
+    }
+
+    rt.epoch /= epochs;
+    rt.serial /= epochs;
+    rt.region /= epochs;
+    rt.compute /= epochs;
+    rt.compute_max /= epochs;
+    rt.reduce /= epochs;
+    rt.epoch_ms = nn_bench_stats_of(epoch_ms, epochs);
+
+    // Pixels (2 floats in, 1 byte out) read once; per thread the net copied in, its gradients zeroed, read back in the
+    // reduction and the shared ones read and written; then the shared gradients zeroed, averaged and applied.
+    double params = (double)net.param_count * sizeof(float);
+    rt.bytes = (double)tin.rows * (2 * sizeof(float) + 1) + threads * (2.0 * params + 3.0 * params) + 6.0 * params;
+
+    free(epoch_ms);
+    free(tin.data);
+    free(px);
+    nn_free(net);
+    nn_free(g);
+    return rt;
+}
+
+// Best-of-five a[i] = b[i] + s * c[i] bandwidth in GB/s with `threads` threads, counting 3 arrays of traffic.
+static double triad_bandwidth(int threads)
+{
+    float *a = malloc(sizeof(float) * TRIAD_FLOATS);
+    float *b = malloc(sizeof(float) * TRIAD_FLOATS);
+    float *c = malloc(sizeof(float) * TRIAD_FLOATS);
+    NN_ASSERT(a && b && c);
+    // First touch by the same threads and schedule as the timed loop, so pages land near the threads that use them.
+    #pragma omp parallel for num_threads(threads) schedule(static)
+    for (long i = 0; i < TRIAD_FLOATS; i++)
+    {
+        a[i] = 0.0f;
+        b[i] = 1.0f;
+        c[i] = 2.0f;
+    }
+    double best = 0.0;
+    for (int r = 0; r < 5; r++)
+    {
+        double t = nn_bench_now();
+        #pragma omp parallel for num_threads(threads) schedule(static)
+        for (long i = 0; i < TRIAD_FLOATS; i++)
+            a[i] = b[i] + 0.5f * c[i];
+        t = nn_bench_now() - t;
+        double gbs = 3.0 * sizeof(float) * TRIAD_FLOATS / t * 1e-9;
+        if (gbs > best) best = gbs;
+    }
+    free(a);
+    free(b);
+    free(c);
+    return best;
+}
+
+static nn_bench_result as_result(const char *name, int w, int h, int threads, run_times rt, double efficiency)
+{
+    nn_bench_result r;
+    memset(&r, 0, sizeof(r));
+    snprintf(r.name, sizeof(r.name), "%s", name);
+    snprintf(r.shape, sizeof(r.shape), "%dx%d 2-14-7-1", w, h);
+    r.batch = w * h;
+    r.threads = threads;
+    r.bytes = rt.bytes;
+    r.value = efficiency;
+    r.ns = rt.epoch_ms;
+    r.ns.mean *= 1e6;
+    r.ns.stddev *= 1e6;
+    r.ns.min *= 1e6;
+    r.ns.median *= 1e6;
+    r.ns.max *= 1e6;
+    return r;
+}
+
+int main(int argc, char **argv)
+{
+    int size = 128;
+    int epochs = 30;
+    int max_threads = omp_get_num_procs();
+    const char *json_path = NULL;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--size") == 0 && i + 1 < argc) size = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--epochs") == 0 && i + 1 < argc) epochs = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--max-threads") == 0 && i + 1 < argc) max_threads = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--json") == 0 && i + 1 < argc) json_path = argv[++i];
+        else
+        {
+            fprintf(stderr, "Usage: %s [--size N] [--epochs N] [--max-threads N] [--json FILE]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (size < 2) size = 2;
+    if (epochs < 2) epochs = 2;
+    if (max_threads < 1) max_threads = 1;
+    if (max_threads > MAX_THREADS) max_threads = MAX_THREADS;
+
+    int threads[32];
+    int thread_count = 0;
+    for (int t = 1; t < max_threads && thread_count < 31; t *= 2)
+        threads[thread_count++] = t;
+    threads[thread_count++] = max_threads;
+
+    printf("upscaler_fast trainer, {2,14,7,1}, %dx%d image (weak scaling: %d rows per thread), %d epochs after %d warm-up, %d cores\n\n",
+           size, size, size, epochs, WARMUP_EPOCHS, omp_get_num_procs());
+    printf("%3s | %9s %6s %8s %6s | %9s %6s | %7s %7s %7s %8s | %7s %7s %6s\n", "thr", "ms/epoch", "cv", "speedup",
+           "strong", "weak ms", "weak", "compute", "reduce", "serial", "overhead", "GB/s", "triad", "bw");
+
+    nn_bench_result results[64];
+    int result_count = 0;
+    double t1 = 0.0, weak_t1 = 0.0;
+    int pick = 1;
+    for (int i = 0; i < thread_count; i++)
+    {
+        int t = threads[i];
+        run_times strong = train(size, size, t, epochs);
+        run_times weak = t == 1 ? strong : train(size, size * t, t, epochs);
+        if (t == 1)
+        {
+            t1 = strong.epoch;
+            weak_t1 = weak.epoch;
+        }
+        double speedup = t1 / strong.epoch;
+        double strong_eff = speedup / t;
+        double weak_eff = weak_t1 / weak.epoch;
+        double triad = triad_bandwidth(t);
+        double gbs = strong.bytes / strong.epoch * 1e-9;
+        // Overhead is what the parallel region took beyond the average thread's own work.
+        double overhead = strong.region - strong.compute - strong.reduce;
+        if (overhead < 0.0) overhead = 0.0;
+        if (strong_eff >= 0.7) pick = t;
+
+        printf("%3d | %9.3f %5.1f%% %7.2fx %5.0f%% | %9.3f %5.0f%% | %6.1f%% %6.1f%% %6.1f%% %7.1f%% | %7.2f %7.2f %5.1f%%\n",
+               t, strong.epoch * 1e3, 100.0 * strong.epoch_ms.stddev / strong.epoch_ms.mean, speedup, 100.0 * strong_eff,
+               weak.epoch * 1e3, 100.0 * weak_eff, 100.0 * strong.compute / strong.epoch, 100.0 * strong.reduce / strong.epoch,
+               100.0 * strong.serial / strong.epoch, 100.0 * overhead / strong.epoch, gbs, triad, 100.0 * gbs / triad);
+        fflush(stdout);
+
+        results[result_count++] = as_result("strong", size, size, t, strong, strong_eff);
+        results[result_count++] = as_result("weak", size, size * t, t, weak, weak_eff);
+        if (strong.compute_max > 1.2 * strong.compute)
+            printf("    slowest thread computes %.0f%% longer than the average: cores are shared or unevenly fast\n",
+                   100.0 * (strong.compute_max / strong.compute - 1.0));
+    }
+
+    printf("\ncompute/reduce/serial/overhead are shares of the epoch; GB/s is compulsory traffic, bw its share of the triad.\n");
+    printf("Largest thread count with strong-scaling efficiency >= 70%% at %dx%d: %d\n", size, size, pick);
+
+    if (json_path && !nn_bench_write_json(json_path, "scaling", results, result_count))
+    {
+        fprintf(stderr, "Could not write %s\n", json_path);
+        return 1;
+    }
+    return 0;
+}
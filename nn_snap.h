@@ -0,0 +1,153 @@
+#ifndef NN_SNAP_H
+#define NN_SNAP_H
+
+// Published parameter versions for readers on other threads (visualization, checkpoints, validation, serving) while
+// training keeps going.
+//
+// The snapshot holds two copies of the parameter arena, each guarded by its own sequence counter (a seqlock).
+// nn_snap_publish copies the net into the copy that is not the latest one (one memcpy) and flips the latest version to
+// it. It never waits and never takes a lock, so a single training thread can publish as often as it likes. nn_snap_read
+// copies the latest version out. If a publish rewrote that copy while it was being read, the counters tell and the read
+// is retried. A reader therefore always gets one whole version, never a mix of two, and only has to retry when it is
+// slower than two publishes.
+//
+// Each version can carry `extra` bytes of caller data that is published and read together with the parameters
+// (e.g. the frame number, or the training state of a checkpoint).
+//
+//   nn_snap snap;
+//   nn_snap_init(&snap, net, sizeof(int));
+//   // training thread:
+//   nn_snap_publish(&snap, net, &epoch);
+//   // any other thread, into its own net of the same architecture:
+//   if (nn_snap_version(&snap) != seen) seen = nn_snap_read(&snap, copy, &epoch);
+//
+// Only one thread may publish. Any number of threads may read, each into its own net.
+//
+//   #define NN_IMPLEMENTATION
+//   #include "nn.h"
+//   #define NN_SNAP_IMPLEMENTATION
+//   #include "nn_snap.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+
+typedef struct
+{
+    float *params[2];
+    unsigned char *extra[2];
+    uint64_t versions[2]; // version held by each copy
+    _Atomic uint64_t seq[2]; // odd while the copy is being rewritten
+    _Atomic uint64_t version; // number of publishes so far; the latest is in copy version & 1
+    size_t param_count;
+    size_t extra_size;
+} nn_snap;
+
+void nn_snap_init(nn_snap *s, nn net, size_t extra_size);
+void nn_snap_free(nn_snap *s);
+uint64_t nn_snap_publish(nn_snap *s, nn net, const void *extra);
+uint64_t nn_snap_version(nn_snap *s);
+uint64_t nn_snap_read(nn_snap *s, nn dst, void *extra);
+int nn_snap_read_version(nn_snap *s, uint64_t v, nn dst, void *extra);
+
+#endif // NN_SNAP_H
+
+#ifdef NN_SNAP_IMPLEMENTATION
+
+#include <string.h>
+
+void nn_snap_init(nn_snap *s, nn net, size_t extra_size)
+{
+    memset(s, 0, sizeof(*s));
+    s->param_count = net.param_count;
+    s->extra_size = extra_size;
+    for (int b = 0; b < 2; b++)
+    {
+        s->params[b] = NN_MALLOC(sizeof(float) * net.param_count);
+        s->extra[b] = NN_MALLOC(extra_size > 0 ? extra_size : 1);
+        NN_ASSERT(s->params[b] != NULL && s->extra[b] != NULL);
+        atomic_init(&s->seq[b], 0);
+    }
+    atomic_init(&s->version, 0);
+}
+
+void nn_snap_free(nn_snap *s)
+{
+    for (int b = 0; b < 2; b++)
+    {
+        free(s->params[b]);
+        free(s->extra[b]);
+        s->params[b] = NULL;
+        s->extra[b] = NULL;
+    }
+}
+
+// Publishes the current parameters of net (and `extra`, if the snapshot has extra bytes) as a new version and returns
+// its number. The first version is 1. Must only be called from one thread.
+uint64_t nn_snap_publish(nn_snap *s, nn net, const void *extra)
+{
+    NN_ASSERT(net.param_count == s->param_count);
+    uint64_t v = atomic_load_explicit(&s->version, memory_order_relaxed) + 1;
+    int b = (int)(v & 1);
+    uint64_t q = atomic_load_explicit(&s->seq[b], memory_order_relaxed);
+
+    atomic_store_explicit(&s->seq[b], q + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release); // readers that see the new data also see the odd count
+    memcpy(s->params[b], net.params, sizeof(float) * s->param_count);
+    if (s->extra_size > 0)
+        memcpy(s->extra[b], extra, s->extra_size);
+    s->versions[b] = v;
+    atomic_store_explicit(&s->seq[b], q + 2, memory_order_release);
+
+    atomic_store_explicit(&s->version, v, memory_order_release);
+    return v;
+}
+
+// Number of the latest published version, 0 if nothing was published yet. Cheap enough to poll.
+uint64_t nn_snap_version(nn_snap *s)
+{
+    return atomic_load_explicit(&s->version, memory_order_acquire);
+}
+
+// Copies the latest version into dst's parameters (and its extra bytes into `extra`) and returns its number, or returns
+// 0 and leaves dst alone if nothing was published yet. Never blocks the publisher. It retries only if the copy was
+// rewritten during the read, which takes two publishes in that time.
+uint64_t nn_snap_read(nn_snap *s, nn dst, void *extra)
+{
+    NN_ASSERT(dst.param_count == s->param_count);
+    for (;;)
+    {
+        uint64_t v = atomic_load_explicit(&s->version, memory_order_acquire);
+        if (v == 0) return 0;
+        int b = (int)(v & 1);
+        uint64_t q = atomic_load_explicit(&s->seq[b], memory_order_acquire);
+        if (q & 1) continue; // being rewritten: by now a newer version is about to be the latest
+
+        memcpy(dst.params, s->params[b], sizeof(float) * s->param_count);
+        if (s->extra_size > 0)
+            memcpy(extra, s->extra[b], s->extra_size);
+        uint64_t held = s->versions[b];
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&s->seq[b], memory_order_relaxed) == q)
+            return held; // may be newer than v if the copy was already reused, but it is whole
+    }
+}
+
+// Copies exactly version v (a completed publish) into dst and `extra`. A copy keeps its version until two newer ones have
+// been published; returns 0 if v was overwritten by then, leaving dst with unspecified contents.
+int nn_snap_read_version(nn_snap *s, uint64_t v, nn dst, void *extra)
+{
+    NN_ASSERT(dst.param_count == s->param_count);
+    int b = (int)(v & 1);
+    uint64_t q = atomic_load_explicit(&s->seq[b], memory_order_acquire);
+    if (q & 1) return 0; // being rewritten with v + 2
+
+    memcpy(dst.params, s->params[b], sizeof(float) * s->param_count);
+    if (s->extra_size > 0)
+        memcpy(extra, s->extra[b], s->extra_size);
+    uint64_t held = s->versions[b];
+    atomic_thread_fence(memory_order_acquire);
+    return atomic_load_explicit(&s->seq[b], memory_order_relaxed) == q && held == v;
+}
+
+#endif // NN_SNAP_IMPLEMENTATION
@@ -4,8 +4,10 @@
 #include "nn.h"
 #define OLIVEC_IMPLEMENTATION
 #include "olive.c"
-#define STB_IMAGE_WRITE_IMPLEMENTATION
-#include "stb_image_write.h"
+#define NN_DIAGRAM_IMPLEMENTATION
+#include "nn_diagram.h"
+#define NN_IMAGE_IMPLEMENTATION
+#include "nn_image.h"
 
 float xor_data[] = {
     0.0f, 0.0f, 0.0f,
@@ -34,43 +36,43 @@ mat tout = {
 
 uint32_t img_pixels[IMG_X*IMG_Y];
 
+static nn_diagram diagram = {0}; //neuron positions and connection pixels, computed on the first frame
+
 int nn_render(Olivec_Canvas img, nn net, int *arch, int arch_count)
 {
     //ABGR color format
     uint32_t bg_col = 0xFF472D0F;
     uint32_t low_col = 0x00FF00FF;
     uint32_t high_col = 0x0000FF00;
-    olivec_fill(img, bg_col);
-    
-    //calculating neuron draw positions
     int n_rad = 25;
-    int layer_bvpad = 50;
-    int layer_bhpad = 50;
-    int net_width = img.width - layer_bhpad*2;
-    int net_height = img.height - 2*layer_bvpad;
-    int layer_hpad =  net_width/arch_count;
-    int net_x = img.width/2 - net_width/2;
-    int net_y = img.height/2 - net_height/2;
-    for(int l = 0; l<arch_count; l++) //iterating through the layers
+    if(diagram.width != img.width || diagram.height != img.height)
     {
-        int layer_vpad1 = net_height/arch[l];
-        for(int i = 0; i<arch[l]; i++) //iterating through each neuron
+        nn_diagram_free(&diagram);
+        nn_diagram_init(&diagram, img.width, img.height, arch, arch_count, bg_col);
+    }
+
+    for(int l = 0; l+1<arch_count; l++) //connection colors; only the ones that changed get repainted
+    {
+        for(int i = 0; i<arch[l]; i++)
         {
-            int cx1 = net_x + l*layer_hpad + layer_hpad/2;
-            int cy1 = net_y + i*layer_vpad1 + layer_vpad1/2;
-            if(l+1<arch_count)
+            for(int j = 0; j<arch[l+1]; j++)
             {
-                int layer_vpad2 = net_height/arch[l+1];
-                for(int j = 0; j<arch[l+1]; j++) //iterating through all of next layer's neurons
-                {
-                    int cx2 = net_x + (l+1)*layer_hpad + layer_hpad/2;
-                    int cy2 = net_y + j*layer_vpad2 + layer_vpad2/2;
-                    uint32_t alpha = floorf(255*sigmoidf(MAT_AT(net.w[l], j, i)));
-                    uint32_t conn_col = 0xFF000000 | low_col;
-                    olivec_blend_color(&conn_col, (alpha<<(8*3)) | high_col);
-                    olivec_line(img, cx1, cy1, cx2, cy2, conn_col);
-                }
+                uint32_t alpha = floorf(255*sigmoidf(MAT_AT(net.w[l], i, j)));
+                uint32_t conn_col = 0xFF000000 | low_col;
+                olivec_blend_color(&conn_col, (alpha<<(8*3)) | high_col);
+                diagram.edge_colors[nn_diagram_edge(&diagram, l, i, j)] = conn_col;
             }
+        }
+    }
+    nn_diagram_draw(&diagram, img);
+    nn_diagram_restore_neurons(&diagram, img, n_rad);
+
+    for(int l = 0; l<arch_count; l++) //neurons go on top of the connections
+    {
+        for(int i = 0; i<arch[l]; i++)
+        {
+            int cx1 = diagram.neuron_x[diagram.layer_start[l] + i];
+            int cy1 = diagram.neuron_y[diagram.layer_start[l] + i];
             if(l>0) //offset drawing of actual NN since input "neurons" need to be drawn
             {
                 uint32_t s = floorf(255.f*sigmoidf(MAT_AT(net.b[l-1], 0, i)));
@@ -80,13 +82,13 @@ int nn_render(Olivec_Canvas img, nn net, int *arch, int arch_count)
             }
             else
                 olivec_circle(img, cx1, cy1, n_rad, 0xFF808080);
-
         }
-    } 
+    }
 
     uint32_t frame_col = 0xFF642D11;
     uint32_t frame_thick = 10;
     olivec_frame(img, 0, 0, IMG_X-1, IMG_Y-1, frame_thick, frame_col);
+    return 0;
 }
 
 int main(void)
@@ -115,7 +117,7 @@ int main(void)
             nn_render(img, xornet, arch, arch_count);
             char img_op_path[256];
             snprintf(img_op_path, sizeof(img_op_path), "./vizns/xor-%02d.png", frameIndex);
-            if(!stbi_write_png(img_op_path, img.width, img.height, 4, img.pixels, img.stride*sizeof(uint32_t)))
+            if(!nn_png_write(img_op_path, img.width, img.height, 4, img.pixels, img.stride*sizeof(uint32_t)))
                 printf("\nERROR while saving file: %s", img_op_path);
             else
             {
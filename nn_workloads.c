@@ -0,0 +1,366 @@
+// End-to-end benchmark scenarios: the workloads the programs in this repo actually run, shrunk to a few seconds each.
+//
+//   upscale_train    upscaler_fast.c: a 28x28 image, {2,14,7,1}, full-batch epochs split over OpenMP threads
+//   mosquitoes_pass  Mosquitoes/train_upscaler.c: {2,128,64,32,1} trained for a few steps on each of several 56x42 images
+//   render_2048      a 2048x2048 render of a {2,28,14,7,1} net through nn_grid, strip by strip, quantized to bytes
+//   xor_converge     nn_main.c: {2,2,1} on xor until the cost is below 1e-3
+//   adder_converge   adder.c: the 3-bit adder {6,7,4} until the cost is below 5e-2 (about 28000 epochs)
+//
+// Every scenario uses fixed seeds and synthetic stand-in images, so it needs no dataset and produces the same result
+// every run. That result (final cost, mean pixel, epochs to converge) is stored with the timing, so a change that alters
+// the math shows up as well as one that alters the speed. Results are only comparable at the same thread count: the
+// gradient reduction order, and so the exact result, depends on it.
+//
+//to Run:
+//   gcc nn_workloads.c -o nn_workloads -O2 -fopenmp -lm
+//   ./nn_workloads --json base.json                     (record a baseline on this machine)
+//   ./nn_workloads --baseline base.json                 (compare: exits with 1 if anything got slower or changed)
+//   ./nn_workloads --baseline base.json --noise 0.03 --reps 10 --only render_2048 --threads 4
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <omp.h>
+
+#define NN_IMPLEMENTATION
+#include "nn.h"
+
+#define NN_GRID_IMPLEMENTATION
+#include "nn_grid.h"
+
+#define NN_BENCH_IMPLEMENTATION
+#include "nn_bench.h"
+
+#define UPSCALE_SIZE   28
+#define UPSCALE_EPOCHS 1000
+
+#define MOSQ_W      56
+#define MOSQ_H      42
+#define MOSQ_IMAGES 3
+#define MOSQ_STEPS  4
+#define MOSQ_RATE   0.5f
+
+#define RENDER_SIZE 2048
+
+#define CONVERGE_CAP 100000 // epochs; a run that takes longer reports the cap
+
+// Synthetic grayscale stand-in for a training image: soft rings around an off-center point over a diagonal gradient,
+// different for every seed and smooth enough for a small coordinate net to make progress on.
+static void synth_image(uint8_t *px, int w, int h, int seed)
+{
+    float cx = 0.35f + 0.1f * (seed % 3);
+    float cy = 0.4f + 0.1f * (seed % 2);
+    for (int y = 0; y < h; y++)
+        for (int x = 0; x < w; x++)
+        {
+            float fx = (float)x / (w - 1), fy = (float)y / (h - 1);
+            float r = sqrtf((fx - cx) * (fx - cx) + (fy - cy) * (fy - cy));
+            float v = 0.5f + 0.35f * cosf(18.0f * r + seed) * expf(-3.0f * r) + 0.15f * (fx - fy);
+            if (v < 0.0f) v = 0.0f;
+            if (v > 1.0f) v = 1.0f;
+            px[y * w + x] = (uint8_t)(v * 255.0f + 0.5f);
+        }
+}
+
+// Pixel coordinates normalized the way every trainer does, one row per pixel.
+static mat coords(int w, int h)
+{
+    mat tin = mat_alloc(w * h, 2);
+    for (int y = 0; y < h; y++)
+        for (int x = 0; x < w; x++)
+        {
+            MAT_AT(tin, y * w + x, 0) = (float)x / (w - 1);
+            MAT_AT(tin, y * w + x, 1) = (float)y / (h - 1);
+        }
+    return tin;
+}
+
+typedef struct
+{
+    double value; // result of the last run
+} scenario_ctx;
+
+// upscaler_fast.c's train_nn, epoch for epoch: each thread backprops its share of the pixels on its own copy of the net,
+// the per-thread gradients are summed in a critical section, then averaged and applied on one thread.
+static void run_upscale_train(void *arg, long iters)
+{
+    scenario_ctx *c = arg;
+    int arch[] = {2, 14, 7, 1};
+    int arch_count = ARRAY_LEN(arch);
+    uint8_t px[UPSCALE_SIZE * UPSCALE_SIZE];
+    synth_image(px, UPSCALE_SIZE, UPSCALE_SIZE, 5);
+    mat tin = coords(UPSCALE_SIZE, UPSCALE_SIZE);
+    mat_u8 tout = {.rows = tin.rows, .cols = 1, .stride = 1, .data = px};
+
+    for (long it = 0; it < iters; it++)
+    {
+        srand(0);
+        nn net = nn_alloc(arch, arch_count);
+        nn g = nn_alloc(arch, arch_count);
+        nn_rand(net, -1, 1);
+        int num_threads = omp_get_max_threads();
+
+        for (int epoch = 0; epoch < UPSCALE_EPOCHS; epoch++)
+        {
+            nn_init(g, 0.0f);
+            #pragma omp parallel
+            {
+                int tid = omp_get_thread_num();
+                int start = (tid * tin.rows) / num_threads;
+                int end = ((tid + 1) * tin.rows) / num_threads;
+                int sub_rows = end - start;
+
+                nn local_g = nn_alloc(arch, arch_count);
+                nn local_net = nn_alloc(arch, arch_count);
+                memcpy(local_net.params, net.params, sizeof(float) * net.param_count);
+                mat sub_tin = {.rows = sub_rows, .cols = tin.cols, .stride = tin.stride, .data = &MAT_AT(tin, start, 0)};
+                mat_u8 sub_tout = {.rows = sub_rows, .cols = 1, .stride = 1, .data = &MAT_U8_AT(tout, start, 0)};
+                nn_backprop_u8(local_net, local_g, sub_tin, sub_tout);
+
+                #pragma omp critical
+                {
+                    for (size_t i = 0; i < g.param_count; i++)
+                        g.params[i] += local_g.params[i] * (float)sub_rows;
+                }
+                nn_free(local_g);
+                nn_free(local_net);
+            }
+            for (size_t i = 0; i < g.param_count; i++)
+                g.params[i] /= (float)tin.rows;
+            nn_learn(net, g, 1.0f);
+        }
+
+        c->value = nn_cost_u8(net, tin, tout);
+        nn_free(net);
+        nn_free(g);
+    }
+    free(tin.data);
+}
+
+// Mosquitoes/train_upscaler.c: one net carried from image to image, full-batch steps on each.
+static void run_mosquitoes_pass(void *arg, long iters)
+{
+    scenario_ctx *c = arg;
+    int arch[] = {2, 128, 64, 32, 1};
+    mat tin = coords(MOSQ_W, MOSQ_H);
+    mat tout[MOSQ_IMAGES];
+    uint8_t px[MOSQ_W * MOSQ_H];
+    for (int i = 0; i < MOSQ_IMAGES; i++)
+    {
+        synth_image(px, MOSQ_W, MOSQ_H, i);
+        tout[i] = mat_alloc(MOSQ_W * MOSQ_H, 1);
+        for (int p = 0; p < MOSQ_W * MOSQ_H; p++)
+            MAT_AT(tout[i], p, 0) = px[p] / 255.0f;
+    }
+
+    for (long it = 0; it < iters; it++)
+    {
+        srand(0);
+        nn net = nn_alloc(arch, ARRAY_LEN(arch));
+        nn g = nn_alloc(arch, ARRAY_LEN(arch));
+        nn_rand(net, -1, 1);
+        double total_cost = 0.0;
+        for (int i = 0; i < MOSQ_IMAGES; i++)
+        {
+            for (int step = 1; step <= MOSQ_STEPS; step++)
+            {
+                nn_backprop(net, g, tin, tout[i]);
+                nn_learn(net, g, MOSQ_RATE);
+            }
+            total_cost += nn_cost(net, tin, tout[i]);
+        }
+        c->value = total_cost;
+        nn_free(net);
+        nn_free(g);
+    }
+
+    for (int i = 0; i < MOSQ_IMAGES; i++)
+        free(tout[i].data);
+    free(tin.data);
+}
+
+// upscaler_fast.c's final render: strips through nn_grid_eval_rows, clamped and quantized. The PNG encoding is left out,
+// it would measure zlib and the disk.
+static void run_render_2048(void *arg, long iters)
+{
+    scenario_ctx *c = arg;
+    int arch[] = {2, 28, 14, 7, 1};
+    srand(0);
+    nn net = nn_alloc(arch, ARRAY_LEN(arch));
+    nn_rand(net, -1, 1);
+    const int strip = 8 * NN_GRID_TILE_H;
+    float *values = malloc(sizeof(*values) * RENDER_SIZE * strip);
+    uint8_t *pixels = malloc(sizeof(*pixels) * RENDER_SIZE * strip);
+    NN_ASSERT(values != NULL && pixels != NULL);
+
+    for (long it = 0; it < iters; it++)
+    {
+        uint64_t sum = 0;
+        for (int y = 0; y < RENDER_SIZE; y += strip)
+        {
+            int rows = RENDER_SIZE - y < strip ? RENDER_SIZE - y : strip;
+            nn_grid_eval_rows(net, values, RENDER_SIZE, RENDER_SIZE, RENDER_SIZE, NN_VIEW_FULL, y, rows);
+            for (int i = 0; i < RENDER_SIZE * rows; i++)
+            {
+                float v = values[i];
+                if (v < 0.f) v = 0.f;
+                if (v > 1.f) v = 1.f;
+                pixels[i] = v * 255.f;
+                sum += pixels[i];
+            }
+        }
+        c->value = (double)sum / ((double)RENDER_SIZE * RENDER_SIZE);
+    }
+
+    free(values);
+    free(pixels);
+    nn_free(net);
+}
+
+// Epochs of nn_backprop + nn_learn (rate 1) until the cost drops below target, starting from nn_rand(net, 0, 1) after srand(seed).
+static int converge(int *arch, int arch_count, mat tin, mat tout, unsigned seed, float target)
+{
+    srand(seed);
+    nn net = nn_alloc(arch, arch_count);
+    nn g = nn_alloc(arch, arch_count);
+    nn_rand(net, 0, 1);
+    int epoch = 0;
+    while (epoch < CONVERGE_CAP && nn_cost(net, tin, tout) >= target)
+    {
+        nn_backprop(net, g, tin, tout);
+        nn_learn(net, g, 1.0f);
+        epoch++;
+    }
+    nn_free(net);
+    nn_free(g);
+    return epoch;
+}
+
+static void run_xor_converge(void *arg, long iters)
+{
+    scenario_ctx *c = arg;
+    float tin_data[] = {0, 0, 0, 1, 1, 0, 1, 1};
+    float tout_data[] = {0, 1, 1, 0};
+    mat tin = {.rows = 4, .cols = 2, .stride = 2, .data = tin_data};
+    mat tout = {.rows = 4, .cols = 1, .stride = 1, .data = tout_data};
+    int arch[] = {2, 2, 1};
+    for (long it = 0; it < iters; it++)
+        c->value = converge(arch, ARRAY_LEN(arch), tin, tout, 69, 1e-3f);
+}
+
+static void run_adder_converge(void *arg, long iters)
+{
+    scenario_ctx *c = arg;
+    enum { bits = 3, n = 1 << bits };
+    mat tin = mat_alloc(n * n, 2 * bits);
+    mat tout = mat_alloc(n * n, bits + 1);
+    for (int a = 0; a < n; a++)
+        for (int b = 0; b < n; b++)
+        {
+            int row = a * n + b;
+            for (int i = 0; i < bits; i++)
+            {
+                MAT_AT(tin, row, i) = (a >> (bits - 1 - i)) & 1;
+                MAT_AT(tin, row, bits + i) = (b >> (bits - 1 - i)) & 1;
+            }
+            for (int i = 0; i <= bits; i++)
+                MAT_AT(tout, row, i) = ((a + b) >> (bits - i)) & 1;
+        }
+    int arch[] = {2 * bits, 2 * bits + 1, bits + 1};
+    for (long it = 0; it < iters; it++)
+        c->value = converge(arch, ARRAY_LEN(arch), tin, tout, 70, 5e-2f);
+    free(tin.data);
+    free(tout.data);
+}
+
+typedef struct
+{
+    const char *name;
+    const char *shape;
+    nn_bench_fn fn;
+    int parallel; // uses every OpenMP thread; the others run on one
+} scenario;
+
+static const scenario scenarios[] = {
+    {"upscale_train", "28x28 2-14-7-1 1000 epochs", run_upscale_train, 1},
+    {"mosquitoes_pass", "3x56x42 2-128-64-32-1 4 steps", run_mosquitoes_pass, 0},
+    {"render_2048", "2048x2048 2-28-14-7-1", run_render_2048, 1},
+    {"xor_converge", "2-2-1 cost<1e-3", run_xor_converge, 0},
+    {"adder_converge", "6-7-4 cost<5e-2", run_adder_converge, 0},
+};
+
+int main(int argc, char **argv)
+{
+    const char *json_path = NULL;
+    const char *baseline_path = NULL;
+    const char *only = NULL;
+    double noise = 0.05;
+    int reps = 5;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--json") == 0 && i + 1 < argc) json_path = argv[++i];
+        else if (strcmp(argv[i], "--baseline") == 0 && i + 1 < argc) baseline_path = argv[++i];
+        else if (strcmp(argv[i], "--only") == 0 && i + 1 < argc) only = argv[++i];
+        else if (strcmp(argv[i], "--noise") == 0 && i + 1 < argc) noise = atof(argv[++i]);
+        else if (strcmp(argv[i], "--reps") == 0 && i + 1 < argc) reps = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) omp_set_num_threads(atoi(argv[++i]));
+        else
+        {
+            fprintf(stderr, "Usage: %s [--json FILE] [--baseline FILE] [--noise 0.05] [--reps N] [--only NAME] [--threads N]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (reps < 2) reps = 2;
+
+    nn_bench_result *base = NULL;
+    int base_count = 0;
+    if (baseline_path)
+    {
+        base_count = nn_bench_read_json(baseline_path, &base);
+        if (base_count < 0)
+        {
+            fprintf(stderr, "Could not read baseline %s\n", baseline_path);
+            return 1;
+        }
+    }
+
+    printf("End-to-end scenarios, %d threads, %d runs each after a warm-up run\n\n", omp_get_max_threads(), reps);
+    printf("%-16s %-30s %3s %12s %10s %7s  %s\n", "scenario", "shape", "thr", "ms (mean)", "stddev", "cv", "result");
+    nn_bench_result results[ARRAY_LEN(scenarios)];
+    int scenario_count = ARRAY_LEN(scenarios);
+    int count = 0;
+    for (int s = 0; s < scenario_count; s++)
+    {
+        if (only && strcmp(only, scenarios[s].name) != 0) continue;
+        scenario_ctx ctx = {0};
+        nn_bench_result *r = &results[count++];
+        memset(r, 0, sizeof(*r));
+        snprintf(r->name, sizeof(r->name), "%s", scenarios[s].name);
+        snprintf(r->shape, sizeof(r->shape), "%s", scenarios[s].shape);
+        r->threads = scenarios[s].parallel ? omp_get_max_threads() : 1;
+        // min_time 0: the calibration is a single warm-up run
+        r->ns = nn_bench_run(scenarios[s].fn, &ctx, reps, 0.0);
+        r->value = ctx.value;
+        printf("%-16s %-30s %3d %12.3f %10.3f %6.2f%%  %.9g\n", r->name, r->shape, r->threads, r->ns.mean * 1e-6,
+               r->ns.stddev * 1e-6, 100.0 * r->ns.stddev / r->ns.mean, r->value);
+        fflush(stdout);
+    }
+
+    if (json_path && !nn_bench_write_json(json_path, "workloads", results, count))
+    {
+        fprintf(stderr, "Could not write %s\n", json_path);
+        return 1;
+    }
+
+    int regressions = 0;
+    if (baseline_path)
+    {
+        printf("\nAgainst %s (noise threshold %.1f%%):\n", baseline_path, 100.0 * noise);
+        regressions = nn_bench_compare(base, base_count, results, count, noise, stdout);
+        printf(regressions ? "\n%d regression(s)\n" : "\nNo regressions\n", regressions);
+        free(base);
+    }
+    return regressions ? 1 : 0;
+}
@@ -0,0 +1,280 @@
+#ifndef NN_Y4M_H
+#define NN_Y4M_H
+
+// YUV4MPEG2 (.y4m) video sink for visualization canvases: one uncompressed 4:2:0 frame per call, written to a file or piped
+// to stdout for a video encoder or player to consume live, e.g.
+//
+//   ./ImageUpscaler --video - | ffmpeg -i - training.mp4
+//   ./ImageUpscaler --video - | ffplay -
+//
+// Canvases are converted from RGBA bytes (the same layout nn_png_write takes) to BT.601 limited-range YUV, with SSE2 where
+// available; the scalar path produces identical bytes. Converted frames go into a small ring of buffers that a writer thread
+// drains, so the caller only waits for the disk or the pipe when the ring is full.
+//
+// When the stream goes to stdout, the process's own stdout is redirected to stderr so printf output cannot corrupt the video.
+//
+//   #define NN_Y4M_IMPLEMENTATION
+//   #include "nn_y4m.h"
+//
+// Link with -lpthread.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <pthread.h>
+
+#define NN_Y4M_QUEUE 3 // converted frames buffered ahead of the writer thread
+
+typedef struct
+{
+    FILE *fp;
+    int w, h;
+    size_t frame_size; // Y + U + V bytes
+    uint8_t *frames[NN_Y4M_QUEUE];
+    int head; // next frame to write
+    int queued;
+    int quit;
+    int ok;
+    int started; // writer thread running
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+} nn_y4m;
+
+int nn_y4m_open(nn_y4m *v, const char *path, int w, int h, int fps);
+int nn_y4m_write(nn_y4m *v, const uint8_t *rgba, int stride);
+int nn_y4m_close(nn_y4m *v);
+
+void nn_rgba_to_yuv420(const uint8_t *rgba, int stride, int w, int h, uint8_t *y, uint8_t *u, uint8_t *v);
+
+#endif // NN_Y4M_H
+
+#ifdef NN_Y4M_IMPLEMENTATION
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define NN_Y4M_SSE2
+#endif
+
+// BT.601 limited range in 8.8 fixed point. The offsets include +128 for rounding and keep every sum non-negative,
+// so the shifts are the same in C and SIMD.
+#define NN_Y4M_Y(r, g, b) ((66 * (r) + 129 * (g) + 25 * (b) + 4224) >> 8) // + 16*256 + 128
+#define NN_Y4M_U(r, g, b) ((-38 * (r) - 74 * (g) + 112 * (b) + 32896) >> 8) // + 128*256 + 128
+#define NN_Y4M_V(r, g, b) ((112 * (r) - 94 * (g) - 18 * (b) + 32896) >> 8)
+
+static uint8_t nn_y4m__avg(uint8_t a, uint8_t b)
+{
+    return (uint8_t)((a + b + 1) >> 1);
+}
+
+#ifdef NN_Y4M_SSE2
+// Applies (c0*R + c1*G + c2*B + bias) >> 8 to the 4 RGBA pixels in px and returns the 4 results as the low 4 bytes.
+static uint32_t nn_y4m__dot4(__m128i px, __m128i coef, __m128i bias)
+{
+    __m128i zero = _mm_setzero_si128();
+    __m128i lo = _mm_madd_epi16(_mm_unpacklo_epi8(px, zero), coef); // [c0R0+c1G0, c2B0, c0R1+c1G1, c2B1]
+    __m128i hi = _mm_madd_epi16(_mm_unpackhi_epi8(px, zero), coef);
+    __m128 even = _mm_shuffle_ps(_mm_castsi128_ps(lo), _mm_castsi128_ps(hi), _MM_SHUFFLE(2, 0, 2, 0));
+    __m128 odd = _mm_shuffle_ps(_mm_castsi128_ps(lo), _mm_castsi128_ps(hi), _MM_SHUFFLE(3, 1, 3, 1));
+    __m128i sum = _mm_add_epi32(_mm_add_epi32(_mm_castps_si128(even), _mm_castps_si128(odd)), bias);
+    sum = _mm_srli_epi32(sum, 8);
+    sum = _mm_packs_epi32(sum, sum);
+    return (uint32_t)_mm_cvtsi128_si32(_mm_packus_epi16(sum, sum));
+}
+#endif
+
+// Converts a w x h RGBA image to planar 4:2:0: y is w*h, u and v are ((w+1)/2)*((h+1)/2).
+// Chroma is taken from each 2x2 block averaged as avg(avg(top-left, bottom-left), avg(top-right, bottom-right)) with rounding
+// averages, the operation SSE2 has for bytes; odd edges repeat the last row/column.
+void nn_rgba_to_yuv420(const uint8_t *rgba, int stride, int w, int h, uint8_t *y, uint8_t *u, uint8_t *v)
+{
+    int cw = (w + 1) / 2, ch = (h + 1) / 2;
+#pragma omp parallel for schedule(static)
+    for (int row = 0; row < h; row++)
+    {
+        const uint8_t *src = rgba + (size_t)row * stride;
+        uint8_t *dst = y + (size_t)row * w;
+        int x = 0;
+#ifdef NN_Y4M_SSE2
+        const __m128i cy = _mm_setr_epi16(66, 129, 25, 0, 66, 129, 25, 0);
+        const __m128i by = _mm_set1_epi32(4224);
+        for (; x + 4 <= w; x += 4)
+        {
+            uint32_t q = nn_y4m__dot4(_mm_loadu_si128((const __m128i *)(src + 4 * x)), cy, by);
+            memcpy(dst + x, &q, 4);
+        }
+#endif
+        for (; x < w; x++)
+        {
+            const uint8_t *p = src + 4 * x;
+            dst[x] = (uint8_t)NN_Y4M_Y(p[0], p[1], p[2]);
+        }
+    }
+
+#pragma omp parallel for schedule(static)
+    for (int cy_row = 0; cy_row < ch; cy_row++)
+    {
+        const uint8_t *r0 = rgba + (size_t)(2 * cy_row) * stride;
+        const uint8_t *r1 = 2 * cy_row + 1 < h ? r0 + stride : r0;
+        uint8_t *du = u + (size_t)cy_row * cw, *dv = v + (size_t)cy_row * cw;
+        int cx = 0;
+#ifdef NN_Y4M_SSE2
+        const __m128i cu = _mm_setr_epi16(-38, -74, 112, 0, -38, -74, 112, 0);
+        const __m128i cv = _mm_setr_epi16(112, -94, -18, 0, 112, -94, -18, 0);
+        const __m128i bc = _mm_set1_epi32(32896);
+        for (; 2 * cx + 8 <= w; cx += 4)
+        {
+            // 8 pixels from each row -> 4 averaged pixels in lanes 0..3
+            __m128i a = _mm_avg_epu8(_mm_loadu_si128((const __m128i *)(r0 + 8 * cx)), _mm_loadu_si128((const __m128i *)(r1 + 8 * cx)));
+            __m128i b = _mm_avg_epu8(_mm_loadu_si128((const __m128i *)(r0 + 8 * cx + 16)), _mm_loadu_si128((const __m128i *)(r1 + 8 * cx + 16)));
+            a = _mm_avg_epu8(a, _mm_srli_si128(a, 4));
+            b = _mm_avg_epu8(b, _mm_srli_si128(b, 4));
+            __m128i px = _mm_unpacklo_epi64(_mm_shuffle_epi32(a, _MM_SHUFFLE(3, 1, 2, 0)), _mm_shuffle_epi32(b, _MM_SHUFFLE(3, 1, 2, 0)));
+            uint32_t qu = nn_y4m__dot4(px, cu, bc), qv = nn_y4m__dot4(px, cv, bc);
+            memcpy(du + cx, &qu, 4);
+            memcpy(dv + cx, &qv, 4);
+        }
+#endif
+        for (; cx < cw; cx++)
+        {
+            int x0 = 2 * cx, x1 = 2 * cx + 1 < w ? 2 * cx + 1 : 2 * cx;
+            uint8_t c[3];
+            for (int k = 0; k < 3; k++)
+                c[k] = nn_y4m__avg(nn_y4m__avg(r0[4 * x0 + k], r1[4 * x0 + k]), nn_y4m__avg(r0[4 * x1 + k], r1[4 * x1 + k]));
+            du[cx] = (uint8_t)NN_Y4M_U(c[0], c[1], c[2]);
+            dv[cx] = (uint8_t)NN_Y4M_V(c[0], c[1], c[2]);
+        }
+    }
+}
+
+static void *nn_y4m__thread(void *arg)
+{
+    nn_y4m *v = arg;
+    pthread_mutex_lock(&v->lock);
+    for (;;)
+    {
+        while (v->queued == 0 && !v->quit)
+            pthread_cond_wait(&v->cond, &v->lock);
+        if (v->queued == 0) break;
+        uint8_t *frame = v->frames[v->head];
+        pthread_mutex_unlock(&v->lock);
+
+        // The frame at head is not reused by nn_y4m_write until queued drops below, so it is written without the lock.
+        int ok = fwrite("FRAME\n", 1, 6, v->fp) == 6 && fwrite(frame, 1, v->frame_size, v->fp) == v->frame_size && fflush(v->fp) == 0;
+
+        pthread_mutex_lock(&v->lock);
+        if (!ok) v->ok = 0;
+        v->head = (v->head + 1) % NN_Y4M_QUEUE;
+        v->queued--;
+        pthread_cond_broadcast(&v->cond);
+    }
+    pthread_mutex_unlock(&v->lock);
+    return NULL;
+}
+
+// Moves the real stdout out of the way (fd 1 then points at stderr) and returns a stream on it for the video.
+static FILE *nn_y4m__take_stdout(void)
+{
+    fflush(stdout);
+#ifdef _WIN32
+    int fd = _dup(1);
+    if (fd < 0 || _dup2(2, 1) != 0) return NULL;
+    _setmode(fd, _O_BINARY);
+    return _fdopen(fd, "wb");
+#else
+    int fd = dup(1);
+    if (fd < 0 || dup2(2, 1) < 0) return NULL;
+    return fdopen(fd, "wb");
+#endif
+}
+
+// Starts a w x h stream at fps frames per second. path "-" writes to stdout.
+int nn_y4m_open(nn_y4m *v, const char *path, int w, int h, int fps)
+{
+    memset(v, 0, sizeof(*v));
+    v->w = w;
+    v->h = h;
+    v->frame_size = (size_t)w * h + 2 * (size_t)((w + 1) / 2) * ((h + 1) / 2);
+    v->fp = strcmp(path, "-") == 0 ? nn_y4m__take_stdout() : fopen(path, "wb");
+    if (!v->fp)
+    {
+        fprintf(stderr, "Could not open video output %s\n", path);
+        return 0;
+    }
+    for (int i = 0; i < NN_Y4M_QUEUE; i++)
+    {
+        v->frames[i] = malloc(v->frame_size);
+        if (!v->frames[i])
+        {
+            nn_y4m_close(v);
+            return 0;
+        }
+    }
+    v->ok = fprintf(v->fp, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n", w, h, fps) > 0 && fflush(v->fp) == 0;
+    pthread_mutex_init(&v->lock, NULL);
+    pthread_cond_init(&v->cond, NULL);
+    v->started = pthread_create(&v->thread, NULL, nn_y4m__thread, v) == 0;
+    if (!v->started)
+    {
+        pthread_mutex_destroy(&v->lock);
+        pthread_cond_destroy(&v->cond);
+        v->ok = 0;
+    }
+    return v->ok;
+}
+
+// Converts and queues one frame (RGBA bytes, rows `stride` bytes apart). Waits only while all buffers are still queued.
+// Returns 0 once a write has failed (e.g. the reading end of the pipe went away).
+int nn_y4m_write(nn_y4m *v, const uint8_t *rgba, int stride)
+{
+    if (!v->started || !v->ok) return 0;
+    pthread_mutex_lock(&v->lock);
+    while (v->queued == NN_Y4M_QUEUE && v->ok)
+        pthread_cond_wait(&v->cond, &v->lock);
+    int slot = (v->head + v->queued) % NN_Y4M_QUEUE;
+    int ok = v->ok;
+    pthread_mutex_unlock(&v->lock);
+    if (!ok) return 0;
+
+    // Only this thread fills slots, and the writer does not touch a slot until it is queued.
+    uint8_t *y = v->frames[slot], *u = y + (size_t)v->w * v->h, *cr = u + (size_t)((v->w + 1) / 2) * ((v->h + 1) / 2);
+    nn_rgba_to_yuv420(rgba, stride, v->w, v->h, y, u, cr);
+
+    pthread_mutex_lock(&v->lock);
+    v->queued++;
+    pthread_cond_broadcast(&v->cond);
+    pthread_mutex_unlock(&v->lock);
+    return 1;
+}
+
+// Writes out the queued frames and closes the stream. Returns 1 if every frame was written.
+int nn_y4m_close(nn_y4m *v)
+{
+    if (v->started)
+    {
+        pthread_mutex_lock(&v->lock);
+        v->quit = 1;
+        pthread_cond_broadcast(&v->cond);
+        pthread_mutex_unlock(&v->lock);
+        pthread_join(v->thread, NULL);
+        pthread_mutex_destroy(&v->lock);
+        pthread_cond_destroy(&v->cond);
+    }
+    int ok = v->ok;
+    if (v->fp && fclose(v->fp) != 0) ok = 0;
+    for (int i = 0; i < NN_Y4M_QUEUE; i++)
+        free(v->frames[i]);
+    memset(v, 0, sizeof(*v));
+    return ok;
+}
+
+#endif // NN_Y4M_IMPLEMENTATION
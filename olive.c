@@ -436,6 +436,75 @@ OLIVECDEF void olivec_sprite_copy(Olivec_Canvas oc, int x, int y, int w, int h,
 OLIVECDEF void olivec_sprite_copy_bilinear(Olivec_Canvas oc, int x, int y, int w, int h, Olivec_Canvas sprite);
 OLIVECDEF uint32_t olivec_pixel_bilinear(Olivec_Canvas sprite, int nx, int ny, int w, int h);
 
+// Span primitives the shapes above are built on. They give exactly the same pixels as the per-pixel loops
+// (olivec_blend_color() on every pixel), using SSE2 where available.
+OLIVECDEF void olivec_fill_span(uint32_t *pixels, size_t count, uint32_t color);
+OLIVECDEF void olivec_blend_span(uint32_t *pixels, size_t count, uint32_t color);
+OLIVECDEF void olivec_blend_pixels(uint32_t *dst, const uint32_t *src, size_t count);
+
+// Tile-binned drawing. Record primitives into a batch, then olivec_batch_draw() sorts them into
+// OLIVEC_TILE_SIZE square tiles of the canvas and rasterizes the tiles in parallel (OpenMP, when compiled
+// with -fopenmp). Every tile replays its primitives in recording order, clipped to the tile, so the result is
+// pixel-identical to calling the olivec_* functions directly in the same order.
+//
+// Olivec_Batch batch = {0};
+// olivec_batch_fill(&batch, BACKGROUND);
+// olivec_batch_line(&batch, x1, y1, x2, y2, color);
+// olivec_batch_draw(oc, &batch);   // draws and empties the batch, keeping its memory for the next frame
+// olivec_batch_free(&batch);
+//
+// Text and sprite pixels are read at draw time, so they have to stay valid until olivec_batch_draw() returns.
+#ifndef OLIVEC_TILE_SIZE
+#define OLIVEC_TILE_SIZE 64
+#endif
+
+typedef enum {
+    OLIVEC_CMD_FILL,
+    OLIVEC_CMD_RECT,
+    OLIVEC_CMD_FRAME,
+    OLIVEC_CMD_CIRCLE,
+    OLIVEC_CMD_LINE,
+    OLIVEC_CMD_TEXT,
+    OLIVEC_CMD_SPRITE_BLEND,
+    OLIVEC_CMD_SPRITE_COPY,
+} Olivec_Cmd_Kind;
+
+typedef struct {
+    Olivec_Cmd_Kind kind;
+    // Pixels the primitive may touch, inclusive. Used for binning only.
+    int bx1, by1, bx2, by2;
+    // Arguments as passed to the olivec_* function: x, y, w, h for rects and sprites, cx, cy, r for circles,
+    // x1, y1, x2, y2 for lines.
+    int a, b, c, d;
+    size_t size; // frame thickness or glyph size
+    uint32_t color;
+    const char *text;
+    Olivec_Font font;
+    Olivec_Canvas sprite;
+} Olivec_Cmd;
+
+typedef struct {
+    Olivec_Cmd *cmds;
+    size_t count;
+    size_t capacity;
+    // Command indices grouped by tile; the commands of tile t are bins[tile_start[t]..tile_start[t + 1]).
+    uint32_t *bins;
+    size_t bins_capacity;
+    size_t *tile_start;
+    size_t tiles_capacity;
+} Olivec_Batch;
+
+OLIVECDEF void olivec_batch_fill(Olivec_Batch *batch, uint32_t color);
+OLIVECDEF void olivec_batch_rect(Olivec_Batch *batch, int x, int y, int w, int h, uint32_t color);
+OLIVECDEF void olivec_batch_frame(Olivec_Batch *batch, int x, int y, int w, int h, size_t thiccness, uint32_t color);
+OLIVECDEF void olivec_batch_circle(Olivec_Batch *batch, int cx, int cy, int r, uint32_t color);
+OLIVECDEF void olivec_batch_line(Olivec_Batch *batch, int x1, int y1, int x2, int y2, uint32_t color);
+OLIVECDEF void olivec_batch_text(Olivec_Batch *batch, const char *text, int x, int y, Olivec_Font font, size_t size, uint32_t color);
+OLIVECDEF void olivec_batch_sprite_blend(Olivec_Batch *batch, int x, int y, int w, int h, Olivec_Canvas sprite);
+OLIVECDEF void olivec_batch_sprite_copy(Olivec_Batch *batch, int x, int y, int w, int h, Olivec_Canvas sprite);
+OLIVECDEF void olivec_batch_draw(Olivec_Canvas oc, Olivec_Batch *batch);
+OLIVECDEF void olivec_batch_free(Olivec_Batch *batch);
+
 typedef struct {
     // Safe ranges to iterate over.
     int x1, x2;
@@ -466,6 +535,19 @@ OLIVECDEF bool olivec_normalize_rect(int x, int y, int w, int h,
 
 #ifdef OLIVEC_IMPLEMENTATION
 
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define OLIVEC_SSE2 1
+#endif
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 OLIVECDEF Olivec_Canvas olivec_canvas(uint32_t *pixels, size_t width, size_t height, size_t stride)
 {
     Olivec_Canvas oc = {
@@ -551,12 +633,87 @@ OLIVECDEF void olivec_blend_color(uint32_t *c1, uint32_t c2)
     *c1 = OLIVEC_RGBA(r1, g1, b1, a1);
 }
 
+#ifdef OLIVEC_SSE2
+// olivec_blend_color() on two pixels widened to 16 bits per channel. The division by 255 is done exactly
+// as (x + 1 + (x >> 8)) >> 8, which matches x/255 for every x up to 255*255.
+static inline __m128i olivec__blend2_sse2(__m128i c1, __m128i c2)
+{
+    __m128i a2 = _mm_shufflehi_epi16(_mm_shufflelo_epi16(c2, 0xFF), 0xFF);
+    __m128i x = _mm_add_epi16(_mm_mullo_epi16(c1, _mm_sub_epi16(_mm_set1_epi16(255), a2)), _mm_mullo_epi16(c2, a2));
+    return _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(x, _mm_set1_epi16(1)), _mm_srli_epi16(x, 8)), 8);
+}
+
+// olivec_blend_color() on four pixels, keeping the alpha of c1.
+static inline __m128i olivec__blend4_sse2(__m128i c1, __m128i c2)
+{
+    __m128i zero = _mm_setzero_si128();
+    __m128i lo = olivec__blend2_sse2(_mm_unpacklo_epi8(c1, zero), _mm_unpacklo_epi8(c2, zero));
+    __m128i hi = olivec__blend2_sse2(_mm_unpackhi_epi8(c1, zero), _mm_unpackhi_epi8(c2, zero));
+    __m128i alpha = _mm_set1_epi32((int) 0xFF000000);
+    return _mm_or_si128(_mm_and_si128(c1, alpha), _mm_andnot_si128(alpha, _mm_packus_epi16(lo, hi)));
+}
+#endif
+
+OLIVECDEF void olivec_fill_span(uint32_t *pixels, size_t count, uint32_t color)
+{
+    size_t i = 0;
+#ifdef OLIVEC_SSE2
+    __m128i c = _mm_set1_epi32((int) color);
+    for (; i + 4 <= count; i += 4) _mm_storeu_si128((__m128i *) &pixels[i], c);
+#endif
+    for (; i < count; ++i) pixels[i] = color;
+}
+
+OLIVECDEF void olivec_blend_span(uint32_t *pixels, size_t count, uint32_t color)
+{
+    uint32_t a = OLIVEC_ALPHA(color);
+    // Blending with alpha 0 leaves every channel as it is, alpha 255 replaces the color channels.
+    if (a == 0) return;
+    size_t i = 0;
+    if (a == 255) {
+        uint32_t rgb = color & 0x00FFFFFF;
+#ifdef OLIVEC_SSE2
+        __m128i alpha = _mm_set1_epi32((int) 0xFF000000);
+        __m128i c = _mm_set1_epi32((int) rgb);
+        for (; i + 4 <= count; i += 4) {
+            __m128i p = _mm_loadu_si128((__m128i *) &pixels[i]);
+            _mm_storeu_si128((__m128i *) &pixels[i], _mm_or_si128(_mm_and_si128(p, alpha), c));
+        }
+#endif
+        for (; i < count; ++i) pixels[i] = (pixels[i] & 0xFF000000) | rgb;
+        return;
+    }
+#ifdef OLIVEC_SSE2
+    __m128i c = _mm_set1_epi32((int) color);
+    for (; i + 4 <= count; i += 4) {
+        __m128i p = _mm_loadu_si128((__m128i *) &pixels[i]);
+        _mm_storeu_si128((__m128i *) &pixels[i], olivec__blend4_sse2(p, c));
+    }
+#endif
+    for (; i < count; ++i) olivec_blend_color(&pixels[i], color);
+}
+
+OLIVECDEF void olivec_blend_pixels(uint32_t *dst, const uint32_t *src, size_t count)
+{
+    size_t i = 0;
+#ifdef OLIVEC_SSE2
+    for (; i + 4 <= count; i += 4) {
+        __m128i p = _mm_loadu_si128((__m128i *) &dst[i]);
+        __m128i c = _mm_loadu_si128((const __m128i *) &src[i]);
+        _mm_storeu_si128((__m128i *) &dst[i], olivec__blend4_sse2(p, c));
+    }
+#endif
+    for (; i < count; ++i) olivec_blend_color(&dst[i], src[i]);
+}
+
 OLIVECDEF void olivec_fill(Olivec_Canvas oc, uint32_t color)
 {
+    if (oc.stride == oc.width) {
+        olivec_fill_span(oc.pixels, oc.width*oc.height, color);
+        return;
+    }
     for (size_t y = 0; y < oc.height; ++y) {
-        for (size_t x = 0; x < oc.width; ++x) {
-            OLIVEC_PIXEL(oc, x, y) = color;
-        }
+        olivec_fill_span(&OLIVEC_PIXEL(oc, 0, y), oc.width, color);
     }
 }
 
@@ -564,10 +721,8 @@ OLIVECDEF void olivec_rect(Olivec_Canvas oc, int x, int y, int w, int h, uint32_
 {
     Olivec_Normalized_Rect nr = {0};
     if (!olivec_normalize_rect(x, y, w, h, oc.width, oc.height, &nr)) return;
-    for (int x = nr.x1; x <= nr.x2; ++x) {
-        for (int y = nr.y1; y <= nr.y2; ++y) {
-            olivec_blend_color(&OLIVEC_PIXEL(oc, x, y), color);
-        }
+    for (int y = nr.y1; y <= nr.y2; ++y) {
+        olivec_blend_span(&OLIVEC_PIXEL(oc, nr.x1, y), nr.x2 - nr.x1 + 1, color);
     }
 }
 
@@ -609,29 +764,54 @@ OLIVECDEF void olivec_ellipse(Olivec_Canvas oc, int cx, int cy, int rx, int ry,
     }
 }
 
+// Number of the OLIVEC_AA_RES x OLIVEC_AA_RES samples of pixel (x, y) that are inside the circle.
+static inline int olivec__circle_samples(int x, int y, int cx, int cy, int r)
+{
+    int count = 0;
+    for (int sox = 0; sox < OLIVEC_AA_RES; ++sox) {
+        for (int soy = 0; soy < OLIVEC_AA_RES; ++soy) {
+            // TODO: switch to 64 bits to make the overflow less likely
+            // Also research the probability of overflow
+            int res1 = (OLIVEC_AA_RES + 1);
+            int dx = (x*res1*2 + 2 + sox*2 - res1*cx*2 - res1);
+            int dy = (y*res1*2 + 2 + soy*2 - res1*cy*2 - res1);
+            if (dx*dx + dy*dy <= res1*res1*r*r*2*2) count += 1;
+        }
+    }
+    return count;
+}
+
+static inline void olivec__circle_blend(uint32_t *pixel, uint32_t color, int count)
+{
+    uint32_t alpha = ((color&0xFF000000)>>(3*8))*count/OLIVEC_AA_RES/OLIVEC_AA_RES;
+    uint32_t updated_color = (color&0x00FFFFFF)|(alpha<<(3*8));
+    olivec_blend_color(pixel, updated_color);
+}
+
 OLIVECDEF void olivec_circle(Olivec_Canvas oc, int cx, int cy, int r, uint32_t color)
 {
     Olivec_Normalized_Rect nr = {0};
     int r1 = r + OLIVEC_SIGN(int, r);
     if (!olivec_normalize_rect(cx - r1, cy - r1, 2*r1, 2*r1, oc.width, oc.height, &nr)) return;
 
+    // The pixels with every sample inside form a single run on each row since the circle is convex, so only
+    // the antialiased edges are sampled pixel by pixel and the run between them is blended as one span.
     for (int y = nr.y1; y <= nr.y2; ++y) {
-        for (int x = nr.x1; x <= nr.x2; ++x) {
-            int count = 0;
-            for (int sox = 0; sox < OLIVEC_AA_RES; ++sox) {
-                for (int soy = 0; soy < OLIVEC_AA_RES; ++soy) {
-                    // TODO: switch to 64 bits to make the overflow less likely
-                    // Also research the probability of overflow
-                    int res1 = (OLIVEC_AA_RES + 1);
-                    int dx = (x*res1*2 + 2 + sox*2 - res1*cx*2 - res1);
-                    int dy = (y*res1*2 + 2 + soy*2 - res1*cy*2 - res1);
-                    if (dx*dx + dy*dy <= res1*res1*r*r*2*2) count += 1;
-                }
-            }
-            uint32_t alpha = ((color&0xFF000000)>>(3*8))*count/OLIVEC_AA_RES/OLIVEC_AA_RES;
-            uint32_t updated_color = (color&0x00FFFFFF)|(alpha<<(3*8));
-            olivec_blend_color(&OLIVEC_PIXEL(oc, x, y), updated_color);
+        uint32_t *row = &OLIVEC_PIXEL(oc, 0, y);
+        int x1 = nr.x1;
+        for (; x1 <= nr.x2; ++x1) {
+            int count = olivec__circle_samples(x1, y, cx, cy, r);
+            if (count == OLIVEC_AA_RES*OLIVEC_AA_RES) break;
+            olivec__circle_blend(&row[x1], color, count);
         }
+        if (x1 > nr.x2) continue;
+        int x2 = nr.x2;
+        for (; x2 > x1; --x2) {
+            int count = olivec__circle_samples(x2, y, cx, cy, r);
+            if (count == OLIVEC_AA_RES*OLIVEC_AA_RES) break;
+            olivec__circle_blend(&row[x2], color, count);
+        }
+        olivec_blend_span(&row[x1], x2 - x1 + 1, color);
     }
 }
 
@@ -640,6 +820,60 @@ OLIVECDEF bool olivec_in_bounds(Olivec_Canvas oc, int x, int y)
     return 0 <= x && x < (int) oc.width && 0 <= y && y < (int) oc.height;
 }
 
+// First step t in [lo, hi] where s*(dv*t/du + v1) >= k, or hi + 1 if there is none (s is the sign of dv, t >= 0).
+// With the division truncating towards zero that is |dv|*t/du >= k - s*v1 rounded down, so t is a ceiling
+// division away.
+static inline int olivec__line_search(int lo, int hi, int du, int dv, int v1, int s, int k)
+{
+    long long m = (long long) k - (long long) s*v1;
+    if (m <= 0) return lo;
+    if (dv == 0) return hi + 1;
+    long long adv = OLIVEC_ABS(int, dv);
+    long long t = (m*du + adv - 1)/adv;
+    if (t < lo) return lo;
+    if (t > hi) return hi + 1;
+    return (int) t;
+}
+
+// Blends color along a line stepping over the major axis u from u1 to u1 + du (du > 0, |dv| <= du). The
+// minor coordinate is v = dv*(u - u1)/du + v1 exactly like in the plain loop, but it is tracked with an
+// incremental remainder, and the steps that stay inside the canvas are found up front instead of checking
+// every pixel.
+static inline void olivec__line_walk(uint32_t *pixels, size_t ustride, size_t vstride, size_t ulimit, size_t vlimit,
+                                     int u1, int v1, int du, int dv, uint32_t color)
+{
+    uint32_t alpha = OLIVEC_ALPHA(color);
+    if (alpha == 0) return;
+
+    int t1 = u1 < 0 ? -u1 : 0;
+    int t2 = du;
+    if (u1 + t2 >= (int) ulimit) t2 = (int) ulimit - 1 - u1;
+    if (t1 > t2) return;
+    int s = dv >= 0 ? 1 : -1;
+    t1 = olivec__line_search(t1, t2, du, dv, v1, s, s > 0 ? 0 : 1 - (int) vlimit);
+    t2 = olivec__line_search(t1, t2, du, dv, v1, s, s > 0 ? (int) vlimit : 1) - 1;
+    if (t1 > t2) return;
+
+    int v = dv*t1/du + v1;
+    int rem = dv*t1%du;
+    uint32_t *p = &pixels[(size_t) (u1 + t1)*ustride + (size_t) v*vstride];
+    uint32_t rgb = color & 0x00FFFFFF;
+    for (int t = t1; t <= t2; ++t) {
+        if (alpha == 255) *p = (*p & 0xFF000000) | rgb;
+        else olivec_blend_color(p, color);
+        if (t == t2) break;
+        p += ustride;
+        rem += dv;
+        if (rem >= du) {
+            rem -= du;
+            p += vstride;
+        } else if (rem <= -du) {
+            rem += du;
+            p -= vstride;
+        }
+    }
+}
+
 // TODO: AA for line
 OLIVECDEF void olivec_line(Olivec_Canvas oc, int x1, int y1, int x2, int y2, uint32_t color)
 {
@@ -659,27 +893,13 @@ OLIVECDEF void olivec_line(Olivec_Canvas oc, int x1, int y1, int x2, int y2, uin
             OLIVEC_SWAP(int, x1, x2);
             OLIVEC_SWAP(int, y1, y2);
         }
-
-        for (int x = x1; x <= x2; ++x) {
-            int y = dy*(x - x1)/dx + y1;
-            // TODO: move boundary checks out side of the loops in olivec_draw_line
-            if (olivec_in_bounds(oc, x, y)) {
-                olivec_blend_color(&OLIVEC_PIXEL(oc, x, y), color);
-            }
-        }
+        olivec__line_walk(oc.pixels, 1, oc.stride, oc.width, oc.height, x1, y1, x2 - x1, y2 - y1, color);
     } else {
         if (y1 > y2) {
             OLIVEC_SWAP(int, x1, x2);
             OLIVEC_SWAP(int, y1, y2);
         }
-
-        for (int y = y1; y <= y2; ++y) {
-            int x = dx*(y - y1)/dy + x1;
-            // TODO: move boundary checks out side of the loops in olivec_draw_line
-            if (olivec_in_bounds(oc, x, y)) {
-                olivec_blend_color(&OLIVEC_PIXEL(oc, x, y), color);
-            }
-        }
+        olivec__line_walk(oc.pixels, oc.stride, 1, oc.height, oc.width, y1, x1, y2 - y1, x2 - x1, color);
     }
 }
 
@@ -888,7 +1108,10 @@ OLIVECDEF void olivec_triangle(Olivec_Canvas oc, int x1, int y1, int x2, int y2,
     }
 }
 
-OLIVECDEF void olivec_text(Olivec_Canvas oc, const char *text, int tx, int ty, Olivec_Font font, size_t glyph_size, uint32_t color)
+// olivec_text() drawing only the part inside `clip`, a subcanvas of oc at (ox, oy). Glyph pixels are still
+// culled by their origin against the whole of oc, so a tile gets exactly its share of the text.
+static inline void olivec__text_clipped(Olivec_Canvas oc, Olivec_Canvas clip, int ox, int oy,
+                                        const char *text, int tx, int ty, Olivec_Font font, size_t glyph_size, uint32_t color)
 {
     for (size_t i = 0; *text; ++i, ++text) {
         int gx = tx + i*font.width*glyph_size;
@@ -900,7 +1123,7 @@ OLIVECDEF void olivec_text(Olivec_Canvas oc, const char *text, int tx, int ty, O
                 int py = gy + dy*glyph_size;
                 if (0 <= px && px < (int) oc.width && 0 <= py && py < (int) oc.height) {
                     if (glyph[dy*font.width + dx]) {
-                        olivec_rect(oc, px, py, glyph_size, glyph_size, color);
+                        olivec_rect(clip, px - ox, py - oy, glyph_size, glyph_size, color);
                     }
                 }
             }
@@ -908,6 +1131,11 @@ OLIVECDEF void olivec_text(Olivec_Canvas oc, const char *text, int tx, int ty, O
     }
 }
 
+OLIVECDEF void olivec_text(Olivec_Canvas oc, const char *text, int tx, int ty, Olivec_Font font, size_t glyph_size, uint32_t color)
+{
+    olivec__text_clipped(oc, oc, 0, 0, text, tx, ty, font, glyph_size, color);
+}
+
 OLIVECDEF void olivec_sprite_blend(Olivec_Canvas oc, int x, int y, int w, int h, Olivec_Canvas sprite)
 {
     if (sprite.width == 0) return;
@@ -921,10 +1149,23 @@ OLIVECDEF void olivec_sprite_blend(Olivec_Canvas oc, int x, int y, int w, int h,
     int ya = nr.oy1;
     if (h < 0) ya = nr.oy2;
     for (int y = nr.y1; y <= nr.y2; ++y) {
-        for (int x = nr.x1; x <= nr.x2; ++x) {
-            size_t nx = (x - xa)*((int) sprite.width)/w;
-            size_t ny = (y - ya)*((int) sprite.height)/h;
-            olivec_blend_color(&OLIVEC_PIXEL(oc, x, y), OLIVEC_PIXEL(sprite, nx, ny));
+        size_t ny = (y - ya)*((int) sprite.height)/h;
+        uint32_t *dst = &OLIVEC_PIXEL(oc, 0, y);
+        const uint32_t *src = &OLIVEC_PIXEL(sprite, 0, ny);
+        if (w == (int) sprite.width) {
+            olivec_blend_pixels(&dst[nr.x1], &src[nr.x1 - xa], nr.x2 - nr.x1 + 1);
+            continue;
+        }
+        // Scaled: gather a chunk of the row, then blend it as a span
+        uint32_t chunk[64];
+        for (int x = nr.x1; x <= nr.x2; x += 64) {
+            int n = nr.x2 - x + 1;
+            if (n > 64) n = 64;
+            for (int i = 0; i < n; ++i) {
+                size_t nx = (x + i - xa)*((int) sprite.width)/w;
+                chunk[i] = src[nx];
+            }
+            olivec_blend_pixels(&dst[x], chunk, n);
         }
     }
 }
@@ -944,10 +1185,16 @@ OLIVECDEF void olivec_sprite_copy(Olivec_Canvas oc, int x, int y, int w, int h,
     int ya = nr.oy1;
     if (h < 0) ya = nr.oy2;
     for (int y = nr.y1; y <= nr.y2; ++y) {
+        size_t ny = (y - ya)*((int) sprite.height)/h;
+        uint32_t *dst = &OLIVEC_PIXEL(oc, 0, y);
+        const uint32_t *src = &OLIVEC_PIXEL(sprite, 0, ny);
+        if (w == (int) sprite.width) {
+            memmove(&dst[nr.x1], &src[nr.x1 - xa], sizeof(uint32_t)*(nr.x2 - nr.x1 + 1));
+            continue;
+        }
         for (int x = nr.x1; x <= nr.x2; ++x) {
             size_t nx = (x - xa)*((int) sprite.width)/w;
-            size_t ny = (y - ya)*((int) sprite.height)/h;
-            OLIVEC_PIXEL(oc, x, y) = OLIVEC_PIXEL(sprite, nx, ny);
+            dst[x] = src[nx];
         }
     }
 }
@@ -1012,10 +1259,287 @@ OLIVECDEF void olivec_sprite_copy_bilinear(Olivec_Canvas oc, int x, int y, int w
     }
 }
 
+static inline Olivec_Cmd *olivec__batch_push(Olivec_Batch *batch, Olivec_Cmd_Kind kind, int bx1, int by1, int bx2, int by2)
+{
+    if (batch->count == batch->capacity) {
+        size_t capacity = batch->capacity ? batch->capacity*2 : 256;
+        Olivec_Cmd *cmds = realloc(batch->cmds, sizeof(Olivec_Cmd)*capacity);
+        if (cmds == NULL) return NULL;
+        batch->cmds = cmds;
+        batch->capacity = capacity;
+    }
+    Olivec_Cmd *cmd = &batch->cmds[batch->count++];
+    memset(cmd, 0, sizeof(*cmd));
+    cmd->kind = kind;
+    cmd->bx1 = bx1;
+    cmd->by1 = by1;
+    cmd->bx2 = bx2;
+    cmd->by2 = by2;
+    return cmd;
+}
+
+// Bounding box of the rect olivec_normalize_rect() would draw, before clipping.
+static inline Olivec_Cmd *olivec__batch_push_rect(Olivec_Batch *batch, Olivec_Cmd_Kind kind, int x, int y, int w, int h)
+{
+    if (w == 0 || h == 0) return NULL;
+    int x2 = x + OLIVEC_SIGN(int, w)*(OLIVEC_ABS(int, w) - 1);
+    int y2 = y + OLIVEC_SIGN(int, h)*(OLIVEC_ABS(int, h) - 1);
+    Olivec_Cmd *cmd = olivec__batch_push(batch, kind, x < x2 ? x : x2, y < y2 ? y : y2, x < x2 ? x2 : x, y < y2 ? y2 : y);
+    if (cmd == NULL) return NULL;
+    cmd->a = x;
+    cmd->b = y;
+    cmd->c = w;
+    cmd->d = h;
+    return cmd;
+}
+
+OLIVECDEF void olivec_batch_fill(Olivec_Batch *batch, uint32_t color)
+{
+    Olivec_Cmd *cmd = olivec__batch_push(batch, OLIVEC_CMD_FILL, 0, 0, INT_MAX, INT_MAX);
+    if (cmd) cmd->color = color;
+}
+
+OLIVECDEF void olivec_batch_rect(Olivec_Batch *batch, int x, int y, int w, int h, uint32_t color)
+{
+    Olivec_Cmd *cmd = olivec__batch_push_rect(batch, OLIVEC_CMD_RECT, x, y, w, h);
+    if (cmd) cmd->color = color;
+}
+
+OLIVECDEF void olivec_batch_frame(Olivec_Batch *batch, int x, int y, int w, int h, size_t t, uint32_t color)
+{
+    if (t == 0) return;
+    Olivec_Cmd *cmd = olivec__batch_push_rect(batch, OLIVEC_CMD_FRAME, x, y, w ? w : 1, h ? h : 1);
+    if (cmd == NULL) return;
+    // The sides are centered on the outline, grow the box by the whole thickness to be safe
+    cmd->bx1 -= (int) t;
+    cmd->by1 -= (int) t;
+    cmd->bx2 += (int) t;
+    cmd->by2 += (int) t;
+    cmd->c = w;
+    cmd->d = h;
+    cmd->size = t;
+    cmd->color = color;
+}
+
+OLIVECDEF void olivec_batch_circle(Olivec_Batch *batch, int cx, int cy, int r, uint32_t color)
+{
+    int r1 = OLIVEC_ABS(int, r) + 1;
+    Olivec_Cmd *cmd = olivec__batch_push(batch, OLIVEC_CMD_CIRCLE, cx - r1, cy - r1, cx + r1, cy + r1);
+    if (cmd == NULL) return;
+    cmd->a = cx;
+    cmd->b = cy;
+    cmd->c = r;
+    cmd->color = color;
+}
+
+OLIVECDEF void olivec_batch_line(Olivec_Batch *batch, int x1, int y1, int x2, int y2, uint32_t color)
+{
+    Olivec_Cmd *cmd = olivec__batch_push(batch, OLIVEC_CMD_LINE,
+                                         x1 < x2 ? x1 : x2, y1 < y2 ? y1 : y2, x1 < x2 ? x2 : x1, y1 < y2 ? y2 : y1);
+    if (cmd == NULL) return;
+    cmd->a = x1;
+    cmd->b = y1;
+    cmd->c = x2;
+    cmd->d = y2;
+    cmd->color = color;
+}
+
+OLIVECDEF void olivec_batch_text(Olivec_Batch *batch, const char *text, int x, int y, Olivec_Font font, size_t size, uint32_t color)
+{
+    size_t len = strlen(text);
+    if (len == 0 || size == 0) return;
+    Olivec_Cmd *cmd = olivec__batch_push(batch, OLIVEC_CMD_TEXT, x, y,
+                                         x + (int) (len*font.width*size), y + (int) (font.height*size));
+    if (cmd == NULL) return;
+    cmd->a = x;
+    cmd->b = y;
+    cmd->size = size;
+    cmd->color = color;
+    cmd->text = text;
+    cmd->font = font;
+}
+
+OLIVECDEF void olivec_batch_sprite_blend(Olivec_Batch *batch, int x, int y, int w, int h, Olivec_Canvas sprite)
+{
+    if (sprite.width == 0 || sprite.height == 0) return;
+    Olivec_Cmd *cmd = olivec__batch_push_rect(batch, OLIVEC_CMD_SPRITE_BLEND, x, y, w, h);
+    if (cmd) cmd->sprite = sprite;
+}
+
+OLIVECDEF void olivec_batch_sprite_copy(Olivec_Batch *batch, int x, int y, int w, int h, Olivec_Canvas sprite)
+{
+    if (sprite.width == 0 || sprite.height == 0) return;
+    Olivec_Cmd *cmd = olivec__batch_push_rect(batch, OLIVEC_CMD_SPRITE_COPY, x, y, w, h);
+    if (cmd) cmd->sprite = sprite;
+}
+
+// Replays one command on the tile at (tx, ty). All primitives only depend on pixel positions relative to their
+// own coordinates, so shifting the coordinates into the tile's subcanvas draws exactly the tile's pixels.
+static inline void olivec__cmd_draw(Olivec_Canvas oc, Olivec_Canvas tile, int tx, int ty, const Olivec_Cmd *cmd)
+{
+    switch (cmd->kind) {
+    case OLIVEC_CMD_FILL:
+        olivec_fill(tile, cmd->color);
+        break;
+    case OLIVEC_CMD_RECT:
+        olivec_rect(tile, cmd->a - tx, cmd->b - ty, cmd->c, cmd->d, cmd->color);
+        break;
+    case OLIVEC_CMD_FRAME:
+        olivec_frame(tile, cmd->a - tx, cmd->b - ty, cmd->c, cmd->d, cmd->size, cmd->color);
+        break;
+    case OLIVEC_CMD_CIRCLE:
+        olivec_circle(tile, cmd->a - tx, cmd->b - ty, cmd->c, cmd->color);
+        break;
+    case OLIVEC_CMD_LINE:
+        olivec_line(tile, cmd->a - tx, cmd->b - ty, cmd->c - tx, cmd->d - ty, cmd->color);
+        break;
+    case OLIVEC_CMD_TEXT:
+        olivec__text_clipped(oc, tile, tx, ty, cmd->text, cmd->a, cmd->b, cmd->font, cmd->size, cmd->color);
+        break;
+    case OLIVEC_CMD_SPRITE_BLEND:
+        olivec_sprite_blend(tile, cmd->a - tx, cmd->b - ty, cmd->c, cmd->d, cmd->sprite);
+        break;
+    case OLIVEC_CMD_SPRITE_COPY:
+        olivec_sprite_copy(tile, cmd->a - tx, cmd->b - ty, cmd->c, cmd->d, cmd->sprite);
+        break;
+    }
+}
+
+// Adds command `index` to tile (tx, ty): counts it while bins is NULL, places it otherwise.
+static inline void olivec__bin(size_t *start, uint32_t *bins, int tiles_x, int tx, int ty, uint32_t index)
+{
+    if (bins == NULL) start[(size_t) ty*tiles_x + tx + 1] += 1;
+    else bins[start[(size_t) ty*tiles_x + tx]++] = index;
+}
+
+// Bins a line into the tiles it passes through. Along every strip of tiles across the major axis the minor
+// coordinate stays between its values at the ends of the strip, so only those tiles are visited.
+static inline void olivec__bin_line(const Olivec_Cmd *cmd, Olivec_Canvas oc, int tiles_x, size_t *start, uint32_t *bins, uint32_t index)
+{
+    int x1 = cmd->a, y1 = cmd->b, x2 = cmd->c, y2 = cmd->d;
+    bool x_major = OLIVEC_ABS(int, x2 - x1) > OLIVEC_ABS(int, y2 - y1);
+    int u1 = x_major ? x1 : y1, v1 = x_major ? y1 : x1;
+    int u2 = x_major ? x2 : y2, v2 = x_major ? y2 : x2;
+    if (u1 > u2) {
+        OLIVEC_SWAP(int, u1, u2);
+        OLIVEC_SWAP(int, v1, v2);
+    }
+    int du = u2 - u1, dv = v2 - v1;
+    int ulimit = x_major ? (int) oc.width : (int) oc.height;
+    int vlimit = x_major ? (int) oc.height : (int) oc.width;
+    int ua = u1 < 0 ? 0 : u1;
+    int ub = u2 >= ulimit ? ulimit - 1 : u2;
+    for (int strip = ua/OLIVEC_TILE_SIZE; strip <= ub/OLIVEC_TILE_SIZE && ua <= ub; ++strip) {
+        int s1 = strip*OLIVEC_TILE_SIZE, s2 = s1 + OLIVEC_TILE_SIZE - 1;
+        if (s1 < ua) s1 = ua;
+        if (s2 > ub) s2 = ub;
+        int va = du ? dv*(s1 - u1)/du + v1 : v1;
+        int vb = du ? dv*(s2 - u1)/du + v1 : v1;
+        if (va > vb) OLIVEC_SWAP(int, va, vb);
+        if (vb < 0 || va >= vlimit) continue;
+        if (va < 0) va = 0;
+        if (vb >= vlimit) vb = vlimit - 1;
+        for (int t = va/OLIVEC_TILE_SIZE; t <= vb/OLIVEC_TILE_SIZE; ++t) {
+            if (x_major) olivec__bin(start, bins, tiles_x, strip, t, index);
+            else olivec__bin(start, bins, tiles_x, t, strip, index);
+        }
+    }
+}
+
+// Bins command `index` into every tile it may touch: the tiles of its bounding box clamped to the canvas, or
+// the tiles along the way for lines.
+static inline void olivec__bin_cmd(const Olivec_Cmd *cmd, Olivec_Canvas oc, int tiles_x, size_t *start, uint32_t *bins, uint32_t index)
+{
+    if (cmd->bx2 < 0 || cmd->by2 < 0) return;
+    if (cmd->bx1 >= (int) oc.width || cmd->by1 >= (int) oc.height) return;
+    if (cmd->kind == OLIVEC_CMD_LINE) {
+        olivec__bin_line(cmd, oc, tiles_x, start, bins, index);
+        return;
+    }
+    int tx1 = (cmd->bx1 < 0 ? 0 : cmd->bx1)/OLIVEC_TILE_SIZE;
+    int ty1 = (cmd->by1 < 0 ? 0 : cmd->by1)/OLIVEC_TILE_SIZE;
+    int tx2 = (cmd->bx2 >= (int) oc.width ? (int) oc.width - 1 : cmd->bx2)/OLIVEC_TILE_SIZE;
+    int ty2 = (cmd->by2 >= (int) oc.height ? (int) oc.height - 1 : cmd->by2)/OLIVEC_TILE_SIZE;
+    for (int ty = ty1; ty <= ty2; ++ty) {
+        for (int tx = tx1; tx <= tx2; ++tx) olivec__bin(start, bins, tiles_x, tx, ty, index);
+    }
+}
+
+// Bins the batch and draws the tiles in parallel. False if that is not worth it (a single thread) or there is
+// no memory for the bins.
+static inline bool olivec__batch_draw_tiled(Olivec_Canvas oc, Olivec_Batch *batch)
+{
+#ifdef _OPENMP
+    if (omp_get_max_threads() < 2) return false;
+#else
+    return false;
+#endif
+    int tiles_x = (int) ((oc.width + OLIVEC_TILE_SIZE - 1)/OLIVEC_TILE_SIZE);
+    int tiles_y = (int) ((oc.height + OLIVEC_TILE_SIZE - 1)/OLIVEC_TILE_SIZE);
+    size_t tile_count = (size_t) tiles_x*tiles_y;
+
+    if (batch->tiles_capacity < tile_count + 1) {
+        size_t *tile_start = realloc(batch->tile_start, sizeof(size_t)*(tile_count + 1));
+        if (tile_start == NULL) return false;
+        batch->tile_start = tile_start;
+        batch->tiles_capacity = tile_count + 1;
+    }
+
+    // Count the commands of every tile, turn the counts into offsets, then place the command indices in
+    // recording order.
+    size_t *start = batch->tile_start;
+    memset(start, 0, sizeof(size_t)*(tile_count + 1));
+    for (size_t i = 0; i < batch->count; ++i) {
+        olivec__bin_cmd(&batch->cmds[i], oc, tiles_x, start, NULL, (uint32_t) i);
+    }
+    for (size_t t = 0; t < tile_count; ++t) start[t + 1] += start[t];
+    size_t total = start[tile_count];
+    if (batch->bins_capacity < total) {
+        uint32_t *bins = realloc(batch->bins, sizeof(uint32_t)*total);
+        if (bins == NULL) return false;
+        batch->bins = bins;
+        batch->bins_capacity = total;
+    }
+    for (size_t i = 0; i < batch->count; ++i) {
+        olivec__bin_cmd(&batch->cmds[i], oc, tiles_x, start, batch->bins, (uint32_t) i);
+    }
+    // The placement loop advanced every offset to the start of the next tile
+    for (size_t t = tile_count; t > 0; --t) start[t] = start[t - 1];
+    start[0] = 0;
+
+    // Tiles own disjoint pixels, so they need no synchronization
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (int t = 0; t < (int) tile_count; ++t) {
+        int tx = (t % tiles_x)*OLIVEC_TILE_SIZE;
+        int ty = (t / tiles_x)*OLIVEC_TILE_SIZE;
+        Olivec_Canvas tile = olivec_subcanvas(oc, tx, ty, OLIVEC_TILE_SIZE, OLIVEC_TILE_SIZE);
+        for (size_t i = start[t]; i < start[t + 1]; ++i) {
+            olivec__cmd_draw(oc, tile, tx, ty, &batch->cmds[batch->bins[i]]);
+        }
+    }
+    return true;
+}
+
+OLIVECDEF void olivec_batch_draw(Olivec_Canvas oc, Olivec_Batch *batch)
+{
+    if (oc.width > 0 && oc.height > 0 && !olivec__batch_draw_tiled(oc, batch)) {
+        // Replay everything on the whole canvas in one go
+        for (size_t i = 0; i < batch->count; ++i) olivec__cmd_draw(oc, oc, 0, 0, &batch->cmds[i]);
+    }
+    batch->count = 0;
+}
+
+OLIVECDEF void olivec_batch_free(Olivec_Batch *batch)
+{
+    free(batch->cmds);
+    free(batch->bins);
+    free(batch->tile_start);
+    memset(batch, 0, sizeof(*batch));
+}
+
 #endif // OLIVEC_IMPLEMENTATION
 
 // TODO: Benchmarking
-// TODO: SIMD implementations
 // TODO: bezier curves
 // TODO: olivec_ring
 // TODO: fuzzer
@@ -3,8 +3,8 @@
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 
-#define STB_IMAGE_WRITE_IMPLEMENTATION
-#include "stb_image_write.h"
+#define NN_IMAGE_IMPLEMENTATION
+#include "nn_image.h"
 
 #define NN_IMPLEMENTATION
 #include "nn.h"
@@ -109,7 +109,7 @@ int main()
         }
     }
     const char *out_path = "./upscaled.png";
-    if (!stbi_write_png(out_path, out_width, out_height, 1, out_pixels, out_width*sizeof(*out_pixels)))
+    if (!nn_png_write(out_path, out_width, out_height, 1, out_pixels, out_width*sizeof(*out_pixels)))
     {    
         fprintf(stderr, "Could not save image %s", out_path);
         return 1;
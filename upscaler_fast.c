@@ -4,16 +4,19 @@
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 
-#define STB_IMAGE_WRITE_IMPLEMENTATION
-#include "stb_image_write.h"
-
 #define NN_IMPLEMENTATION
 #include "nn.h"
 
+#define NN_GRID_IMPLEMENTATION
+#include "nn_grid.h"
+
+#define NN_IMAGE_IMPLEMENTATION
+#include "nn_image.h"
+
 #define pix(x, y) y*img_width + x
 
 float rate = 1;
-void train_nn(nn net, nn g, int n, mat tin, mat tout)
+void train_nn(nn net, nn g, int n, mat tin, mat_u8 tout)
 {
     int arch[] = {2, 14, 7, 1};
     int arch_count = 4;
@@ -52,16 +55,16 @@ void train_nn(nn net, nn g, int n, mat tin, mat tout)
                 .stride = tin.stride,
                 .data = &MAT_AT(tin, start, 0),
             };
-            mat sub_tout = {
+            mat_u8 sub_tout = {
                 .rows = sub_rows,
                 .cols = tout.cols,
                 .stride = tout.stride,
-                .data = &MAT_AT(tout, start, 0),
+                .data = &MAT_U8_AT(tout, start, 0),
             };
 
-            // Important: call nn_backprop once for the chunk.
-            // nn_backprop will zero local_g and then compute average gradients over sub_rows.
-            nn_backprop(local_net, local_g, sub_tin, sub_tout);
+            // Important: call nn_backprop_u8 once for the chunk.
+            // nn_backprop_u8 will zero local_g and then compute average gradients over sub_rows.
+            nn_backprop_u8(local_net, local_g, sub_tin, sub_tout);
 
             // Accumulate (as sums) into shared g
             // local_g currently contains *average* gradients for this thread's chunk,
@@ -79,7 +82,8 @@ void train_nn(nn net, nn g, int n, mat tin, mat tout)
                             MAT_AT(g.b[l], r, c) += MAT_AT(local_g.b[l], r, c) * (float)sub_rows;
                 }
             }
-            // note: we intentionally don't free local_g/local_net (nn.h has no free)
+            nn_free(local_g);
+            nn_free(local_net);
         } // end parallel
 
         // Now g contains sums over all samples; convert to average by dividing by total rows
@@ -98,7 +102,7 @@ void train_nn(nn net, nn g, int n, mat tin, mat tout)
         nn_learn(net, g, 1.0f);
 
         if (epoch % (n / 10) == 0)
-            printf("\ncost = %f", nn_cost(net, tin, tout));
+            printf("\ncost = %f", nn_cost_u8(net, tin, tout));
     }
 }
 
@@ -122,7 +126,7 @@ int main()
     }
     printf("\nImage: %s\nSize: %d*%d, %d bits\n", img_path, img_width, img_height, img_comp*8);
 
-    mat trd = mat_alloc(img_width*img_height, 3); //training data
+    mat tin = mat_alloc(img_width*img_height, 2); //training inputs; the targets stay as the image's own bytes
 
     for(int y = 0; y<img_height; y++)
     {
@@ -133,30 +137,18 @@ int main()
             uint8_t px = img_pixels[pix(x,y)];
             if(px) printf("%3u ", px); else printf("    ");
 
-            MAT_AT(trd, i, 0) = (float) x/(img_width-1);
-            MAT_AT(trd, i, 1) = (float) y/(img_height-1);
-            MAT_AT(trd, i, 2) = img_pixels[pix(x, y)]/255.f;
-            // MAT_AT(tin, i, 0) = (float) x/(img_width-1);
-            // MAT_AT(tin, i, 1) = (float) y/(img_height-1);
-            // MAT_AT(tout, i, 0) = img_pixels[pix(x, y)]/255.f;
+            MAT_AT(tin, i, 0) = (float) x/(img_width-1);
+            MAT_AT(tin, i, 1) = (float) y/(img_height-1);
         }
         printf("\n");
     }
-    //MAT_PRINT(trd);
     
 
-    mat tin = {
-        .rows = trd.rows,
-        .cols = 2,
-        .stride = trd.stride,
-        .data = &MAT_AT(trd, 0, 0),
-    };
-
-    mat tout = {
-        .rows = trd.rows,
+    mat_u8 tout = {
+        .rows = tin.rows,
         .cols = 1,
-        .stride = trd.stride,
-        .data = &MAT_AT(trd, 0, tin.cols),
+        .stride = 1,
+        .data = img_pixels,
     };
 
 
@@ -167,7 +159,7 @@ int main()
     nn g = nn_alloc(arch, ARRAY_LEN(arch));
     nn_rand(net, -1, 1);
 
-    printf("\ncost = %f", nn_cost(net, tin, tout));
+    printf("\ncost = %f", nn_cost_u8(net, tin, tout));
 
     int train_count = 100000;
     train_nn(net, g, train_count, tin, tout);
@@ -175,20 +167,41 @@ int main()
 
     int out_width = 2048;
     int out_height = 2048;
-    uint8_t *out_pixels = malloc(sizeof(*out_pixels)*out_height*out_width);
-    for(int y = 0; y<out_height; y++)
+    const char *out_path = "./upscaled.png";
+
+    // Render and write in strips so memory stays at one strip regardless of output size
+    const int strip = 8 * NN_GRID_TILE_H;
+    nn_image_writer img;
+    float *out_values = malloc(sizeof(*out_values)*out_width*strip);
+    uint8_t *out_pixels = malloc(sizeof(*out_pixels)*out_width*strip);
+    if (!out_values || !out_pixels || !nn_image_open(&img, out_path, out_width, out_height, 1, NN_IMAGE_LEVEL_DEFAULT))
     {
-        for(int x = 0; x<out_width; x++)
+        fprintf(stderr, "Could not save image %s", out_path);
+        return 1;
+    }
+    for(int y = 0; y<out_height; y += strip)
+    {
+        int rows = out_height - y < strip ? out_height - y : strip;
+        nn_grid_eval_rows(net, out_values, out_width, out_height, out_width, NN_VIEW_FULL, y, rows);
+        for(int i = 0; i<out_width*rows; i++)
         {
-            MAT_AT(NN_INPUT_MAT(net), 0, 0) = (float) x/(out_width - 1);
-            MAT_AT(NN_INPUT_MAT(net), 0, 1) = (float) y/(out_height - 1);
-            nn_forward(net);
-            uint8_t px = MAT_AT(NN_OUTPUT_MAT(net), 0, 0)*255.f;
-            out_pixels[y * out_width + x] = px;
+            float v = out_values[i];
+            if (v < 0.f) v = 0.f;
+            if (v > 1.f) v = 1.f;
+            out_pixels[i] = v*255.f;
+        }
+        if (!nn_image_write_rows(&img, out_pixels, rows, out_width))
+        {
+            free(out_values);
+            free(out_pixels);
+            nn_image_close(&img);
+            fprintf(stderr, "Could not save image %s", out_path);
+            return 1;
         }
     }
-    const char *out_path = "./upscaled.png";
-    if (!stbi_write_png(out_path, out_width, out_height, 1, out_pixels, out_width*sizeof(*out_pixels)))
+    free(out_values);
+    free(out_pixels);
+    if (!nn_image_close(&img))
     {    
         fprintf(stderr, "Could not save image %s", out_path);
         return 1;
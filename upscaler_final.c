@@ -14,15 +14,27 @@
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 
-#define STB_IMAGE_WRITE_IMPLEMENTATION
-#include "stb_image_write.h"
+#define NN_IMAGE_IMPLEMENTATION
+#include "nn_image.h"
 
 #define NN_IMPLEMENTATION
 #include "nn.h"
 
+#define NN_GRID_IMPLEMENTATION
+#include "nn_grid.h"
+
+#define NN_SNAP_IMPLEMENTATION
+#include "nn_snap.h"
+
+#define NN_FRAMES_IMPLEMENTATION
+#include "nn_frames.h"
+
 #define OLIVEC_IMPLEMENTATION
 #include "olive.c"
 
+#define NN_DIAGRAM_IMPLEMENTATION
+#include "nn_diagram.h"
+
 #ifndef M_PI
 #define M_PI 3.14159265358979323846
 #endif
@@ -53,57 +65,58 @@ static inline uint32_t red_green_color_from_float(float w)
     return col;
 }
 
+// Only used from the frame thread: cached diagram connections, and the neurons of the frame being drawn.
+static nn_diagram diagram = {0};
+static Olivec_Batch render_batch = {0};
+
 // Render the network to the Olivec canvas similar to upscaler_test.nn_render
 // But use red<->green color mapping for weights and preview pixels.
 // preview is grayscale bytes[ pw * ph ]
 int nn_render_rg(Olivec_Canvas img, nn net, int *arch, int arch_count, uint8_t *preview, int pw, int ph)
 {
-    uint32_t bg_col = 0xFF1A1A1A;
-    olivec_fill(img, bg_col);
-
+    if (diagram.width != img.width || diagram.height != img.height)
+    {
+        nn_diagram_free(&diagram);
+        nn_diagram_init(&diagram, img.width, img.height, arch, arch_count, 0xFF1A1A1A);
+    }
     int n_rad = 18;
-    int layer_bvpad = 50;
-    int layer_bhpad = 50;
-    int net_width = img.width - layer_bhpad * 2;
-    int net_height = img.height - 2 * layer_bvpad;
-    int layer_hpad = net_width / arch_count;
-    int net_x = img.width / 2 - net_width / 2;
-    int net_y = img.height / 2 - net_height / 2;
 
-    for (int l = 0; l < arch_count; l++)
+    for (int l = 0; l + 1 < arch_count; l++)
     {
-        int layer_vpad1 = net_height / arch[l];
         for (int i = 0; i < arch[l]; i++)
         {
-            int cx1 = net_x + l * layer_hpad + layer_hpad / 2;
-            int cy1 = net_y + i * layer_vpad1 + layer_vpad1 / 2;
-            if (l + 1 < arch_count)
+            for (int j = 0; j < arch[l + 1]; j++)
             {
-                int layer_vpad2 = net_height / arch[l + 1];
-                for (int j = 0; j < arch[l + 1]; j++)
-                {
-                    int cx2 = net_x + (l + 1) * layer_hpad + layer_hpad / 2;
-                    int cy2 = net_y + j * layer_vpad2 + layer_vpad2 / 2;
-                    // sample weight w from net.w[l] at [j, i] (note matrices are stored as rows = input neurons, cols = output neurons)
-                    float w = MAT_AT(net.w[l], j, i);
-                    uint32_t col = red_green_color_from_float(w);
-                    olivec_line(img, cx1, cy1, cx2, cy2, col);
-                }
+                // matrices are stored as rows = input neurons, cols = output neurons
+                float w = MAT_AT(net.w[l], i, j);
+                diagram.edge_colors[nn_diagram_edge(&diagram, l, i, j)] = red_green_color_from_float(w);
             }
+        }
+    }
+    nn_diagram_draw(&diagram, img);
+
+    // Neurons and the preview blend with the connections under them, which may have just been repainted
+    nn_diagram_restore_neurons(&diagram, img, n_rad);
+    if (preview)
+        nn_diagram_restore(&diagram, img, img.width - pw - 20, img.height - ph - 20, pw, ph);
+
+    for (int l = 0; l < arch_count; l++)
+    {
+        for (int i = 0; i < arch[l]; i++)
+        {
+            int n = diagram.layer_start[l] + i;
+            uint32_t col = 0xFF808080;
             if (l > 0)
             {
-                // draw neuron circle; bias affects intensity (use sigmoid of bias -> grayscale)
+                // bias affects intensity (use sigmoid of bias -> grayscale)
                 float b = MAT_AT(net.b[l - 1], 0, i);
                 uint8_t val = (uint8_t)(255.0f / (1.0f + expf(-b))); // 0..255
-                uint32_t col = 0xFF000000 | (val << 16) | (val << 8) | val;
-                olivec_circle(img, cx1, cy1, n_rad, col);
-            }
-            else
-            {
-                olivec_circle(img, cx1, cy1, n_rad, 0xFF808080);
+                col = 0xFF000000 | (val << 16) | (val << 8) | val;
             }
+            olivec_batch_circle(&render_batch, diagram.neuron_x[n], diagram.neuron_y[n], n_rad, col);
         }
     }
+    olivec_batch_draw(img, &render_batch);
 
     // Overlay current image preview bottom-right corner (but colorized red->green)
     if (preview)
@@ -132,6 +145,43 @@ int nn_render_rg(Olivec_Canvas img, nn net, int *arch, int arch_count, uint8_t *
     return 0;
 }
 
+// Visualization state, allocated once and only used on the frame thread
+#define PREVIEW_W 128
+#define PREVIEW_H 128
+
+typedef struct
+{
+    int *arch;
+    int arch_count;
+    float values[PREVIEW_W * PREVIEW_H];
+    uint8_t preview[PREVIEW_W * PREVIEW_H];
+} viz_frame_ctx;
+
+// Renders one visualization frame from a parameter snapshot (runs on the frame thread)
+static void render_frame(nn snap, int frame, void *user)
+{
+    viz_frame_ctx *ctx = user;
+    nn_grid_eval(snap, ctx->values, PREVIEW_W, PREVIEW_H, PREVIEW_W);
+    for (int i = 0; i < PREVIEW_W * PREVIEW_H; i++)
+    {
+        float outv = ctx->values[i];
+        // clamp to [0,1]
+        if (outv < 0.0f) outv = 0.0f;
+        if (outv > 1.0f) outv = 1.0f;
+        ctx->preview[i] = (uint8_t)(outv * 255.0f);
+    }
+
+    Olivec_Canvas img = olivec_canvas(img_pixels_canvas, IMG_X, IMG_Y, IMG_X);
+    nn_render_rg(img, snap, ctx->arch, ctx->arch_count, ctx->preview, PREVIEW_W, PREVIEW_H);
+
+    char img_op_path[256];
+    snprintf(img_op_path, sizeof(img_op_path), "./vizns/upscaler-%04d.png", frame);
+    if (!nn_png_write(img_op_path, img.width, img.height, 4, img.pixels, img.stride * sizeof(uint32_t)))
+        printf("\nERROR while saving file: %s", img_op_path);
+    else
+        printf("\nSaved visualization frame: %s", img_op_path);
+}
+
 // Multithreaded training: adapted from upscaler_fast.c but calling visualization periodically.
 // net : shared network updated at epoch end using averaged gradients in g
 // n : epochs
@@ -147,6 +197,16 @@ void train_nn_mt_vis(nn net, nn g, int n, mat tin, mat tout, int arch[], int arc
     // Make sure viz output directory exists (POSIX). If system() fails it's ok — best-effort.
     system("mkdir -p vizns");
 
+    // Frames are rendered on a background thread from parameter snapshots; training never waits for them
+    static viz_frame_ctx viz;
+    viz.arch = arch;
+    viz.arch_count = arch_count;
+    nn_frames frames;
+    int frames_ok = nn_frames_start(&frames, net, render_frame, &viz);
+    int frame_index = 0;
+    if (!frames_ok)
+        fprintf(stderr, "\nCould not start frame thread, continuing without visualization\n");
+
     for (int epoch = 0; epoch < n; epoch++)
     {
         // Zero global gradient accumulator before each epoch
@@ -202,7 +262,8 @@ void train_nn_mt_vis(nn net, nn g, int n, mat tin, mat tout, int arch[], int arc
                             MAT_AT(g.b[l], r, c) += MAT_AT(local_g.b[l], r, c) * (float)sub_rows;
                 }
             }
-            // intentional: no frees (consistent with nn.h allocation style)
+            nn_free(local_g);
+            nn_free(local_net);
         } // end parallel
 
         // Now convert g sums to averages
@@ -225,45 +286,18 @@ void train_nn_mt_vis(nn net, nn g, int n, mat tin, mat tout, int arch[], int arc
             printf("\n[epoch %d/%d] cost = %f", epoch, n, nn_cost(net, tin, tout));
         }
 
-        // Save visualization periodically
-        if (save_every_epochs > 0 && (epoch % save_every_epochs == 0))
+        // Queue a visualization frame periodically (dropped if the frame thread is still busy)
+        if (frames_ok && save_every_epochs > 0 && (epoch % save_every_epochs == 0))
         {
-            int pw = 128, ph = 128;
-            uint8_t *preview = malloc(pw * ph);
-            if (!preview) {
-                fprintf(stderr, "\nPreview alloc failed\n");
-            } else {
-                for (int y = 0; y < ph; y++)
-                {
-                    for (int x = 0; x < pw; x++)
-                    {
-                        MAT_AT(NN_INPUT_MAT(net), 0, 0) = (float)x / (pw - 1);
-                        MAT_AT(NN_INPUT_MAT(net), 0, 1) = (float)y / (ph - 1);
-                        nn_forward(net);
-                        float outv = MAT_AT(NN_OUTPUT_MAT(net), 0, 0);
-                        // clamp to [0,1]
-                        if (outv < 0.0f) outv = 0.0f;
-                        if (outv > 1.0f) outv = 1.0f;
-                        preview[y * pw + x] = (uint8_t)(outv * 255.0f);
-                    }
-                }
-
-                Olivec_Canvas img = olivec_canvas(img_pixels_canvas, IMG_X, IMG_Y, IMG_X);
-                nn_render_rg(img, net, arch, arch_count, preview, pw, ph);
-
-                char img_op_path[256];
-                static int frameIndex = 0;
-                snprintf(img_op_path, sizeof(img_op_path), "./vizns/upscaler-%04d.png", frameIndex);
-                if (!stbi_write_png(img_op_path, img.width, img.height, 4, img.pixels, img.stride * sizeof(uint32_t)))
-                    printf("\nERROR while saving file: %s", img_op_path);
-                else
-                    printf("\nSaved visualization frame: %s", img_op_path);
-                free(preview);
-                frameIndex++;
-            }
+            if (!nn_frames_submit(&frames, net, frame_index))
+                printf("\nVisualization busy, frame %d replaced an unrendered one", frame_index);
+            frame_index++;
         }
     } // end epochs
 
+    if (frames_ok)
+        nn_frames_stop(&frames);
+
     // final cost
     printf("\nFinal cost = %f\n", nn_cost(net, tin, tout));
 }
@@ -317,7 +351,9 @@ int main()
 
     int train_count = 20000; // epochs
     int save_every_epochs = (train_count / 10 > 0) ? (train_count / 10) : 1; // produce ~10 visualization frames
+    nn_png_compression_level = NN_IMAGE_LEVEL_FAST; // visualization frames favour speed over size
     train_nn_mt_vis(net, g, train_count, tin, tout, arch, arch_count, save_every_epochs);
+    nn_png_compression_level = NN_IMAGE_LEVEL_DEFAULT;
 
     // After training, produce the final upscaled image
     int out_width = 512, out_height = 512;
@@ -341,7 +377,7 @@ int main()
     }
 
     const char *out_path = "./upscaled.png";
-    if (!stbi_write_png(out_path, out_width, out_height, 1, out_pixels, out_width))
+    if (!nn_png_write(out_path, out_width, out_height, 1, out_pixels, out_width))
     {
         fprintf(stderr, "\nCould not save image %s", out_path);
         return 1;
@@ -7,8 +7,8 @@
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 
-#define STB_IMAGE_WRITE_IMPLEMENTATION
-#include "stb_image_write.h"
+#define NN_IMAGE_IMPLEMENTATION
+#include "nn_image.h"
 
 #define NN_IMPLEMENTATION
 #include "nn.h"
@@ -16,6 +16,9 @@
 #define OLIVEC_IMPLEMENTATION
 #include "olive.c"
 
+#define NN_DIAGRAM_IMPLEMENTATION
+#include "nn_diagram.h"
+
 #define IMG_X 1024
 #define IMG_Y 768
 
@@ -32,50 +35,53 @@ static inline uint32_t weight_color(float w)
         return 0xFF000000 | (intensity << 16); // red
 }
 
+// Diagram layout and connection pixels, rasterized on the first frame; the neurons of a frame are batched.
+static nn_diagram diagram = {0};
+static Olivec_Batch render_batch = {0};
+
 int nn_render(Olivec_Canvas img, nn net, int *arch, int arch_count, uint8_t *preview, int pw, int ph)
 {
-    uint32_t bg_col = 0xFF1A1A1A;
-    olivec_fill(img, bg_col);
-
+    if (diagram.width != img.width || diagram.height != img.height)
+    {
+        nn_diagram_free(&diagram);
+        nn_diagram_init(&diagram, img.width, img.height, arch, arch_count, 0xFF1A1A1A);
+    }
     int n_rad = 18;
-    int layer_bvpad = 50;
-    int layer_bhpad = 50;
-    int net_width = img.width - layer_bhpad * 2;
-    int net_height = img.height - 2 * layer_bvpad;
-    int layer_hpad = net_width / arch_count;
-    int net_x = img.width / 2 - net_width / 2;
-    int net_y = img.height / 2 - net_height / 2;
 
-    for (int l = 0; l < arch_count; l++)
+    for (int l = 0; l + 1 < arch_count; l++)
     {
-        int layer_vpad1 = net_height / arch[l];
         for (int i = 0; i < arch[l]; i++)
         {
-            int cx1 = net_x + l * layer_hpad + layer_hpad / 2;
-            int cy1 = net_y + i * layer_vpad1 + layer_vpad1 / 2;
-            if (l + 1 < arch_count)
+            for (int j = 0; j < arch[l + 1]; j++)
             {
-                int layer_vpad2 = net_height / arch[l + 1];
-                for (int j = 0; j < arch[l + 1]; j++)
-                {
-                    int cx2 = net_x + (l + 1) * layer_hpad + layer_hpad / 2;
-                    int cy2 = net_y + j * layer_vpad2 + layer_vpad2 / 2;
-                    float w = MAT_AT(net.w[l], j, i);
-                    uint32_t col = weight_color(w);
-                    olivec_line(img, cx1, cy1, cx2, cy2, col);
-                }
+                float w = MAT_AT(net.w[l], i, j);
+                diagram.edge_colors[nn_diagram_edge(&diagram, l, i, j)] = weight_color(w);
             }
+        }
+    }
+    nn_diagram_draw(&diagram, img);
+
+    // Neurons and the preview blend with the connections under them, which may have just been repainted
+    nn_diagram_restore_neurons(&diagram, img, n_rad);
+    if (preview)
+        nn_diagram_restore(&diagram, img, img.width - pw - 20, img.height - ph - 20, pw, ph);
+
+    for (int l = 0; l < arch_count; l++)
+    {
+        for (int i = 0; i < arch[l]; i++)
+        {
+            int n = diagram.layer_start[l] + i;
+            uint32_t col = 0xFF808080;
             if (l > 0)
             {
                 float b = MAT_AT(net.b[l - 1], 0, i);
                 uint8_t val = (uint8_t)(255.0f / (1.0f + expf(-b)));
-                uint32_t col = 0xFF000000 | (val << 8) | (val << 16);
-                olivec_circle(img, cx1, cy1, n_rad, col);
+                col = 0xFF000000 | (val << 8) | (val << 16);
             }
-            else
-                olivec_circle(img, cx1, cy1, n_rad, 0xFF808080);
+            olivec_batch_circle(&render_batch, diagram.neuron_x[n], diagram.neuron_y[n], n_rad, col);
         }
     }
+    olivec_batch_draw(img, &render_batch);
 
     // Overlay current image preview bottom-right corner
     if (preview)
@@ -131,7 +137,7 @@ void train_nn(nn net, nn g, int n, mat tin, mat tout, int arch[], int arch_count
             char img_op_path[256];
             static int frameIndex = 0;
             snprintf(img_op_path, sizeof(img_op_path), "./vizns/upscaler-%03d.png", frameIndex);
-            if (!stbi_write_png(img_op_path, img.width, img.height, 4, img.pixels, img.stride * sizeof(uint32_t)))
+            if (!nn_png_write(img_op_path, img.width, img.height, 4, img.pixels, img.stride * sizeof(uint32_t)))
                 printf("\nERROR while saving file: %s", img_op_path);
             else
                 printf("\nSaved visualization frame: %s", img_op_path);
@@ -199,7 +205,7 @@ int main()
     }
 
     const char *out_path = "./upscaled.png";
-    if (!stbi_write_png(out_path, out_width, out_height, 1, out_pixels, out_width))
+    if (!nn_png_write(out_path, out_width, out_height, 1, out_pixels, out_width))
     {
         fprintf(stderr, "\nCould not save image %s", out_path);
         return 1;
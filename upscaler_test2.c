@@ -13,15 +13,27 @@
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
-#define STB_IMAGE_WRITE_IMPLEMENTATION
-#include "stb_image_write.h"
+#define NN_IMAGE_IMPLEMENTATION
+#include "nn_image.h"
 
 #define NN_IMPLEMENTATION
 #include "nn.h"
 
+#define NN_GRID_IMPLEMENTATION
+#include "nn_grid.h"
+
+#define NN_SNAP_IMPLEMENTATION
+#include "nn_snap.h"
+
+#define NN_FRAMES_IMPLEMENTATION
+#include "nn_frames.h"
+
 #define OLIVEC_IMPLEMENTATION
 #include "olive.c"
 
+#define NN_DIAGRAM_IMPLEMENTATION
+#include "nn_diagram.h"
+
 #define IMG_X 1024
 #define IMG_Y 768
 static uint32_t img_pixels_canvas[IMG_X * IMG_Y];
@@ -48,12 +60,16 @@ static inline uint32_t weight_to_rgcolor(float w)
 }
 
 // Improved legend: larger box, bigger font scale, one line per label, no wrapping.
+#define LEGEND_W 340
+#define LEGEND_H 200
+#define LEGEND_MARGIN 14
+
 static void draw_legend(Olivec_Canvas img)
 {
     // Larger legend to avoid wrapping
-    const int legend_w = 340;
-    const int legend_h = 200;
-    const int margin = 14;
+    const int legend_w = LEGEND_W;
+    const int legend_h = LEGEND_H;
+    const int margin = LEGEND_MARGIN;
     const int lx = img.width - legend_w - margin;
     const int ly = margin;
 
@@ -109,43 +125,41 @@ static void draw_legend(Olivec_Canvas img)
     // Done. The bigger legend avoids wrapping.
 }
 
+// Cached layout and connection pixels of the diagram, and the neurons and preview of the current frame.
+static nn_diagram diagram = {0};
+static Olivec_Batch render_batch = {0};
+
 int nn_render(Olivec_Canvas img, nn net, int *arch, int arch_count,
               uint32_t *preview_sprite, int pw, int ph)
 {
-    olivec_fill(img, ARGB(0xFF, 26, 26, 26)); // dark background
-
-    int layer_bvpad = 50;
-    int layer_bhpad = 50;
-    int net_width = img.width - layer_bhpad * 2;
-    int net_height = img.height - 2 * layer_bvpad;
-    int layer_hpad = net_width / arch_count;
-    int net_x = img.width / 2 - net_width / 2;
-    int net_y = img.height / 2 - net_height / 2;
+    if (diagram.width != img.width || diagram.height != img.height) {
+        nn_diagram_free(&diagram);
+        nn_diagram_init(&diagram, img.width, img.height, arch, arch_count, ARGB(0xFF, 26, 26, 26)); // dark background
+    }
     int neuron_radius = 18;
 
-    for (int l = 0; l < arch_count; ++l) {
-        int layer_vpad = net_height / arch[l];
+    for (int l = 0; l + 1 < arch_count; ++l) {
         for (int i = 0; i < arch[l]; ++i) {
-            int cx = net_x + l * layer_hpad + layer_hpad / 2;
-            int cy = net_y + i * layer_vpad + layer_vpad / 2;
-            if (l + 1 < arch_count) {
-                int next_vpad = net_height / arch[l + 1];
-                for (int j = 0; j < arch[l + 1]; ++j) {
-                    int cx2 = net_x + (l + 1) * layer_hpad + layer_hpad / 2;
-                    int cy2 = net_y + j * next_vpad + next_vpad / 2;
-                    float w = MAT_AT(net.w[l], j, i);
-                    uint32_t col = weight_to_rgcolor(w);
-                    olivec_line(img, cx, cy, cx2, cy2, col);
-                }
+            for (int j = 0; j < arch[l + 1]; ++j) {
+                float w = MAT_AT(net.w[l], i, j);
+                diagram.edge_colors[nn_diagram_edge(&diagram, l, i, j)] = weight_to_rgcolor(w);
             }
+        }
+    }
+    nn_diagram_draw(&diagram, img);
+    nn_diagram_restore_neurons(&diagram, img, neuron_radius);
+    nn_diagram_restore(&diagram, img, img.width - LEGEND_W - LEGEND_MARGIN - 5, LEGEND_MARGIN - 5, LEGEND_W + 10, LEGEND_H + 10);
+
+    for (int l = 0; l < arch_count; ++l) {
+        for (int i = 0; i < arch[l]; ++i) {
+            int n = diagram.layer_start[l] + i;
+            uint32_t col = ARGB(0xFF, 128, 128, 128);
             if (l > 0) {
                 float b = MAT_AT(net.b[l - 1], 0, i);
                 uint8_t v = (uint8_t)(255.0f / (1.0f + expf(-b)));
-                uint32_t col = ARGB(0xFF, v, v, v);
-                olivec_circle(img, cx, cy, neuron_radius, col);
-            } else {
-                olivec_circle(img, cx, cy, neuron_radius, ARGB(0xFF, 128, 128, 128));
+                col = ARGB(0xFF, v, v, v);
             }
+            olivec_batch_circle(&render_batch, diagram.neuron_x[n], diagram.neuron_y[n], neuron_radius, col);
         }
     }
 
@@ -155,16 +169,57 @@ int nn_render(Olivec_Canvas img, nn net, int *arch, int arch_count,
         int margin = 24;
         int px = img.width - pw - margin;
         int py = img.height - ph - margin;
-        olivec_sprite_copy(img, px, py, pw, ph, sprite);
-        olivec_frame(img, px, py, pw, ph, 2, ARGB(0xFF, 255, 255, 255));
+        olivec_batch_sprite_copy(&render_batch, px, py, pw, ph, sprite);
+        olivec_batch_frame(&render_batch, px, py, pw, ph, 2, ARGB(0xFF, 255, 255, 255));
     }
+    olivec_batch_draw(img, &render_batch);
 
     draw_legend(img);
     olivec_frame(img, 0, 0, img.width - 1, img.height - 1, 8, ARGB(0xFF, 255, 255, 255));
     return 0;
 }
 
-// training + visualization (same logic as before)
+// Frame thread state: the preview is evaluated from the snapshot by the tiled batch evaluator, then the frame is drawn and saved.
+#define PREVIEW_W 128
+#define PREVIEW_H 128
+
+typedef struct {
+    int *arch;
+    int arch_count;
+    float values[PREVIEW_W * PREVIEW_H];
+    uint32_t sprite[PREVIEW_W * PREVIEW_H];
+} viz_frame_ctx;
+
+// Every preview pixel is a forward pass of the snapshot. nn_frames keeps the frame thread's OpenMP regions on one thread so
+// PNG encoding does not take cores from training; the evaluation is short, so it gets all of them and the count goes back
+// to 1 for the rest of the frame.
+static void render_preview(viz_frame_ctx *ctx, nn snap)
+{
+    omp_set_num_threads(omp_get_num_procs());
+    nn_grid_eval(snap, ctx->values, PREVIEW_W, PREVIEW_H, PREVIEW_W);
+    omp_set_num_threads(1);
+    for (int i = 0; i < PREVIEW_W * PREVIEW_H; ++i)
+        ctx->sprite[i] = t_to_rgcolor(ctx->values[i]);
+}
+
+static void render_frame(nn snap, int frame, void *user)
+{
+    viz_frame_ctx *ctx = user;
+    render_preview(ctx, snap);
+
+    Olivec_Canvas canvas = olivec_canvas(img_pixels_canvas, IMG_X, IMG_Y, IMG_X);
+    nn_render(canvas, snap, ctx->arch, ctx->arch_count, ctx->sprite, PREVIEW_W, PREVIEW_H);
+
+    char fname[256];
+    snprintf(fname, sizeof(fname), "./vizns/upscaler-%04d.png", frame);
+    if (!nn_png_write(fname, IMG_X, IMG_Y, 4, canvas.pixels, canvas.stride * sizeof(uint32_t))) {
+        fprintf(stderr, "Failed to write %s\n", fname);
+    } else {
+        printf("Saved visualization frame: %s\n", fname);
+    }
+}
+
+// training + visualization; frames are handed to the frame thread as parameter snapshots, so training never waits for them
 float rate = 1.0f;
 void train_nn_mt_vis(nn net, nn g, int epochs, mat tin, mat tout,
                      int arch[], int arch_count, int frame_count)
@@ -177,6 +232,13 @@ void train_nn_mt_vis(nn net, nn g, int epochs, mat tin, mat tout,
     int save_every = epochs / frame_count;
     if (save_every <= 0) save_every = 1;
 
+    static viz_frame_ctx viz;
+    viz.arch = arch;
+    viz.arch_count = arch_count;
+    nn_frames frames;
+    int frames_ok = nn_frames_start(&frames, net, render_frame, &viz);
+    if (!frames_ok) fprintf(stderr, "Could not start frame thread, continuing without visualization\n");
+
     int frame_index = 0;
     for (int epoch = 0; epoch < epochs; ++epoch) {
         nn_init(g, 0.0f);
@@ -213,6 +275,8 @@ void train_nn_mt_vis(nn net, nn g, int epochs, mat tin, mat tout,
                             MAT_AT(g.b[l], r, c) += MAT_AT(local_g.b[l], r, c) * (float)sub_rows;
                 }
             }
+            nn_free(local_g);
+            nn_free(local_net);
         } // end parallel
 
         for (int l = 0; l < g.count; ++l) {
@@ -230,39 +294,13 @@ void train_nn_mt_vis(nn net, nn g, int epochs, mat tin, mat tout,
             printf("[epoch %d/%d] cost = %f\n", epoch, epochs, nn_cost(net, tin, tout));
         }
 
-        if ((epoch % save_every == 0) && frame_index < frame_count) {
-            const int pw = 128, ph = 128;
-            uint32_t *sprite_pixels = malloc(sizeof(uint32_t) * pw * ph);
-            if (!sprite_pixels) {
-                fprintf(stderr, "Preview sprite malloc failed\n");
-            } else {
-                for (int y = 0; y < ph; ++y) {
-                    for (int x = 0; x < pw; ++x) {
-                        MAT_AT(NN_INPUT_MAT(net), 0, 0) = (float)x / (pw - 1);
-                        MAT_AT(NN_INPUT_MAT(net), 0, 1) = (float)y / (ph - 1);
-                        nn_forward(net);
-                        float v = MAT_AT(NN_OUTPUT_MAT(net), 0, 0);
-                        if (v < 0.0f) v = 0.0f;
-                        if (v > 1.0f) v = 1.0f;
-                        sprite_pixels[y * pw + x] = t_to_rgcolor(v);
-                    }
-                }
-
-                Olivec_Canvas canvas = olivec_canvas(img_pixels_canvas, IMG_X, IMG_Y, IMG_X);
-                nn_render(canvas, net, arch, arch_count, sprite_pixels, pw, ph);
-
-                char fname[256];
-                snprintf(fname, sizeof(fname), "./vizns/upscaler-%04d.png", frame_index);
-                if (!stbi_write_png(fname, IMG_X, IMG_Y, 4, canvas.pixels, canvas.stride * sizeof(uint32_t))) {
-                    fprintf(stderr, "Failed to write %s\n", fname);
-                } else {
-                    printf("Saved visualization frame: %s\n", fname);
-                }
-                free(sprite_pixels);
-                frame_index++;
-            }
+        if (frames_ok && (epoch % save_every == 0) && frame_index < frame_count) {
+            if (!nn_frames_submit(&frames, net, frame_index))
+                printf("Visualization busy, frame %d replaced an unrendered one\n", frame_index);
+            frame_index++;
         }
     } // epochs
+    if (frames_ok) nn_frames_stop(&frames);
 
     printf("Final cost = %f\n", nn_cost(net, tin, tout));
     printf("Generating GIF vizns/training.gif (requires ImageMagick)...\n");
@@ -329,7 +367,7 @@ int main(void)
         }
     }
 
-    if (!stbi_write_png("./upscaled.png", out_w, out_h, 1, out_pixels, out_w)) {
+    if (!nn_png_write("./upscaled.png", out_w, out_h, 1, out_pixels, out_w)) {
         fprintf(stderr, "Could not save upscaled.png\n");
     } else {
         printf("Saved upscaled.png\n");